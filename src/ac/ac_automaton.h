@@ -1,86 +1,128 @@
 #pragma once
 
-#include <list>
 #include <vector>
+#include <queue>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
 
 #include "kmers_ac.h"
+#include "../parallel.h"
 
 constexpr int INVALID_STATE = -1;
-struct ACState {
-    // List of k-mers whose prefix this state is.
-    std::list<size_t> supporters;
-    // Indexes of the states longer by the corresponding nucleotide.
-    int forwardEdges[4] =  {INVALID_STATE, INVALID_STATE, INVALID_STATE, INVALID_STATE};
+
+/// Throw std::length_error unless the given number of states fits the 32-bit state IDs.
+inline void CheckACStateCount(size_t stateCount) {
+    if (stateCount > size_t(INT32_MAX)) throw std::length_error("the Aho-Corasick automaton has more than 2^31 - 1 states");
+}
+
+/// Aho-Corasick automaton with the states stored in flat arrays.
+///
+/// Constructed with a single thread, the states are numbered in the order in which they are first reached by the k-mers.
+/// The supporters of all the states are stored in a single array, in which those of state s are at
+/// positions supporterOffsets[s] to supporterOffsets[s + 1], so a state takes 32 bytes and the supporters 4(k+1) bytes per k-mer.
+/// Constructed with more threads, the states are numbered in the BFS order instead,
+/// which gives the same automaton up to the numbering with the same reversed BFS order of the states.
+struct CompactACAutomaton {
+    // Indexes of the states longer by the corresponding nucleotide, 4 per state.
+    std::vector<int32_t> forwardEdges;
     // Where to go if searching failed.
-    int backwardEdge = 0;
+    std::vector<int32_t> backwardEdges;
     // Length of the corresponding string.
-    int depth = 0;
-    // Index of the state in the automaton's *states* list.
-    int id = 0;
-};
-
-struct ACAutomaton {
-    std::vector<ACState> states;
+    std::vector<int32_t> depths;
+    // Start of the supporters of each state in supporters and the total number of the supporters at the end.
+    std::vector<uint64_t> supporterOffsets;
+    // Indexes of the k-mers whose prefix the given state is, grouped by the states.
+    std::vector<uint32_t> supporters;
     // Indices of the states where i-th k-mer ends.
     std::vector<int> endStateIndices;
     // Reversed BFS order.
     std::vector<int> reversedOrdering;
 
+    /// Return the number of the states.
+    size_t Size() const {
+        return depths.size();
+    }
+
+    /// Return the first supporter of the given state.
+    const uint32_t *SupportersBegin(int state) const {
+        return supporters.data() + supporterOffsets[state];
+    }
+
+    /// Return the end of the supporters of the given state.
+    const uint32_t *SupportersEnd(int state) const {
+        return supporters.data() + supporterOffsets[state + 1];
+    }
+
     /// Append a new state and return its ID.
     int AddState(const int depth) {
-        ACState newState;
-        newState.depth = depth;
-        newState.id = (int)states.size();
-        states.push_back(newState);
-        return (int)states.size() - 1;
+        CheckACStateCount(depths.size() + 1);
+        forwardEdges.insert(forwardEdges.end(), 4, INVALID_STATE);
+        backwardEdges.push_back(0);
+        depths.push_back(depth);
+        return int(depths.size()) - 1;
     }
 
     /// Generate the trie from the given k-mers and set *endStateIndices*.
-    void ConstructTrie(const std::vector<KMer> &kMers) {
-        endStateIndices = std::vector<int>(kMers.size());
-        // Initialize the root.
+    /// The supporters are counted when the k-mers are inserted and then filled by walking the trie with each k-mer once more.
+    void ConstructTrie(const PackedKMers &kMers) {
+        size_t n = kMers.Size();
+        int k = kMers.k;
+        endStateIndices = std::vector<int>(n);
+        std::vector<uint64_t> counts;
         AddState(0);
-        for (size_t i = 0; i < kMers.size(); ++i) states[0].supporters.push_back(i);
-        for (size_t i = 0; i < kMers.size(); ++i) {
+        counts.push_back(n);
+        for (size_t i = 0; i < n; ++i) {
             int state = 0;
-            for (char c : kMers[i].value) {
-                int index = NucleotideToInt(c);
+            for (int j = 0; j < k; ++j) {
+                int index = kMers.Nucleotide(i, j);
                 // If the next state does not yet exist, create it.
-                if (states[state].forwardEdges[index] == INVALID_STATE) {
-                    int newState =  AddState(states[state].depth + 1);
-                    states[state].forwardEdges[index] = newState;
+                if (forwardEdges[4 * state + index] == INVALID_STATE) {
+                    int newState = AddState(depths[state] + 1);
+                    forwardEdges[4 * state + index] = newState;
+                    counts.push_back(0);
                 }
-                state = states[state].forwardEdges[index];
-                states[state].supporters.push_back(i);
+                state = forwardEdges[4 * state + index];
+                ++counts[state];
             }
             endStateIndices[i] = state;
         }
 
-        // Create a forward edge from the root to itself so that the AC Step always finds a valid forward edge.
-        for (int & forwardEdge : states[0].forwardEdges) {
-            if (forwardEdge == INVALID_STATE) {
-                forwardEdge = 0;
+        supporterOffsets = std::vector<uint64_t>(Size() + 1, 0);
+        for (size_t s = 0; s < Size(); ++s) supporterOffsets[s + 1] = supporterOffsets[s] + counts[s];
+        supporters = std::vector<uint32_t>(supporterOffsets.back());
+        // Reuse the counts as the positions at which the next supporters are written.
+        std::copy(supporterOffsets.begin(), supporterOffsets.end() - 1, counts.begin());
+        for (size_t i = 0; i < n; ++i) {
+            int state = 0;
+            supporters[counts[state]++] = uint32_t(i);
+            for (int j = 0; j < k; ++j) {
+                state = forwardEdges[4 * state + kMers.Nucleotide(i, j)];
+                supporters[counts[state]++] = uint32_t(i);
             }
         }
+
+        // Create a forward edge from the root to itself so that the AC Step always finds a valid forward edge.
+        for (int i = 0; i < 4; ++i) {
+            if (forwardEdges[i] == INVALID_STATE) forwardEdges[i] = 0;
+        }
     }
 
     /// Do one step of the AC algorithm from the given state with a nucleotide with a given index.
-    int Step (int state, const int index) {
-        while (states[state].forwardEdges[index] == INVALID_STATE) {
-            state = states[state].backwardEdge;
+    int Step(int state, const int index) const {
+        while (forwardEdges[4 * state + index] == INVALID_STATE) {
+            state = backwardEdges[state];
         }
-        return states[state].forwardEdges[index];
+        return forwardEdges[4 * state + index];
     }
 
     /// Construct the fail edges for the trie that already had been created.
     /// Also construct the reversed BFS ordering.
-    void ConstructBackwardEdges () {
-        reversedOrdering = std::vector<int> (states.size(), 0);
+    void ConstructBackwardEdges() {
+        reversedOrdering = std::vector<int>(Size(), 0);
         std::queue<int> q;
-        for (int & forwardEdge : states[0].forwardEdges) {
-            if (forwardEdge != 0) {
-                q.push(forwardEdge);
-            }
+        for (int i = 0; i < 4; ++i) {
+            if (forwardEdges[i] != 0) q.push(forwardEdges[i]);
         }
         size_t orderingIndex = reversedOrdering.size() - size_t(2);
         while (!q.empty()) {
@@ -88,17 +130,130 @@ struct ACAutomaton {
             reversedOrdering[orderingIndex--] = state;
             q.pop();
             for (int i = 0; i < 4; ++i) {
-                int nextState = states[state].forwardEdges[i];
+                int nextState = forwardEdges[4 * state + i];
                 if (nextState != INVALID_STATE && nextState != 0) {
-                    states[nextState].backwardEdge = Step(states[state].backwardEdge, i);
+                    backwardEdges[nextState] = Step(backwardEdges[state], i);
                     q.push(nextState);
                 }
             }
         }
     }
 
-    /// Construct the Aho-Corasick automaton.
-    void Construct (const std::vector<KMer> &kMers) {
+    /// Generate the trie from the k-mers sorted with the given number of threads and set *endStateIndices*.
+    /// The states of depth d are the distinct d-prefixes of the sorted k-mers, so each level is built in parallel
+    /// from the previous one and the states are numbered in the BFS order.
+    /// The supporters of a state are the k-mers at a range of the sorted positions, which is the same at each depth,
+    /// so the supporters of depth d start at d n and are merged from those of the children from the deepest level up.
+    void ConstructTrieSorted(const PackedKMers &kMers, int threads) {
+        size_t n = kMers.Size();
+        int k = kMers.k;
+        std::vector<uint32_t> order = kMers.SortedOrder(threads);
+        // lcp[i] is the length of the common prefix of the i-th sorted k-mer and the previous one.
+        std::vector<int32_t> lcp(n, 0);
+        ParallelFor(1, n, threads, [&](size_t from, size_t to, int) {
+            for (size_t i = from; i < to; ++i) lcp[i] = kMers.CommonPrefixLength(order[i - 1], order[i]);
+        });
+        // The i-th sorted k-mer starts a new state at each depth greater than lcp[i].
+        size_t stateCount = 1;
+        for (size_t i = 0; i < n; ++i) stateCount += k - lcp[i];
+        CheckACStateCount(stateCount);
+        forwardEdges = std::vector<int32_t>(4 * stateCount, INVALID_STATE);
+        backwardEdges = std::vector<int32_t>(stateCount, 0);
+        depths = std::vector<int32_t>(stateCount, 0);
+        supporterOffsets = std::vector<uint64_t>(stateCount + 1, 0);
+        supporterOffsets[stateCount] = uint64_t(k + 1) * n;
+
+        // node[i] is the state at the current depth which is the prefix of the i-th sorted k-mer.
+        std::vector<int32_t> node(n, 0);
+        // The first state of each depth.
+        std::vector<size_t> levelBegins = {0, 1};
+        std::vector<size_t> created(threads);
+        for (int d = 0; d < k; ++d) {
+            std::fill(created.begin(), created.end(), 0);
+            ParallelFor(0, n, threads, [&](size_t from, size_t to, int thread) {
+                for (size_t i = from; i < to; ++i) created[thread] += lcp[i] <= d;
+            });
+            // The states are numbered in the order of the sorted positions at which they start.
+            size_t nextState = levelBegins.back();
+            for (auto &threadCreated : created) {
+                size_t count = threadCreated;
+                threadCreated = nextState;
+                nextState += count;
+            }
+            levelBegins.push_back(nextState);
+            ParallelFor(0, n, threads, [&](size_t from, size_t to, int thread) {
+                // The first position of the chunk may continue the last state started before the chunk.
+                int32_t state = int32_t(created[thread]) - 1;
+                for (size_t i = from; i < to; ++i) {
+                    if (lcp[i] <= d) {
+                        state = int32_t(created[thread]++);
+                        forwardEdges[4 * node[i] + kMers.Nucleotide(order[i], d)] = state;
+                        depths[state] = d + 1;
+                        supporterOffsets[state] = uint64_t(d + 1) * n + i;
+                    }
+                    node[i] = state;
+                }
+            });
+        }
+        endStateIndices = std::vector<int>(n);
+        ParallelFor(0, n, threads, [&](size_t from, size_t to, int) {
+            for (size_t i = from; i < to; ++i) endStateIndices[order[i]] = node[i];
+        });
+
+        supporters = std::vector<uint32_t>(supporterOffsets.back());
+        // The equal k-mers are ordered by their indices, so the supporters of the deepest states are already in the index order.
+        std::copy(order.begin(), order.end(), supporters.begin() + uint64_t(k) * n);
+        for (int d = k - 1; d >= 0; --d) {
+            ParallelFor(levelBegins[d], levelBegins[d + 1], threads, [&](size_t from, size_t to, int) {
+                for (size_t s = from; s < to; ++s) {
+                    uint32_t *begin = supporters.data() + supporterOffsets[s];
+                    uint32_t *end = supporters.data() + supporterOffsets[s + 1];
+                    std::copy(begin + n, end + n, begin);
+                    // The children are at consecutive ranges of the positions, each sorted by the indices.
+                    for (int c = 0; c < 4; ++c) {
+                        int child = forwardEdges[4 * s + c];
+                        if (child == INVALID_STATE) continue;
+                        uint32_t *middle = supporters.data() + supporterOffsets[child] - n;
+                        if (middle != begin) std::inplace_merge(begin, middle, middle + (supporterOffsets[child + 1] - supporterOffsets[child]));
+                    }
+                }
+            });
+        }
+
+        // Create a forward edge from the root to itself so that the AC Step always finds a valid forward edge.
+        for (int i = 0; i < 4; ++i) {
+            if (forwardEdges[i] == INVALID_STATE) forwardEdges[i] = 0;
+        }
+    }
+
+    /// Construct the fail edges for the trie with the states numbered in the BFS order and the reversed BFS ordering.
+    /// The fail edges of each depth depend only on the shallower states, so each level is computed in parallel.
+    void ConstructBackwardEdgesByLevels(int threads) {
+        reversedOrdering = std::vector<int>(Size());
+        for (size_t i = 0; i < Size(); ++i) reversedOrdering[i] = int(Size() - 1 - i);
+        // The fail edges of the states of depth 1 lead to the root.
+        for (size_t begin = 1, end; begin < Size(); begin = end) {
+            end = std::upper_bound(depths.begin() + begin, depths.end(), depths[begin]) - depths.begin();
+            ParallelFor(begin, end, threads, [&](size_t from, size_t to, int) {
+                for (size_t s = from; s < to; ++s) {
+                    for (int c = 0; c < 4; ++c) {
+                        int nextState = forwardEdges[4 * s + c];
+                        if (nextState != INVALID_STATE) backwardEdges[nextState] = Step(backwardEdges[s], c);
+                    }
+                }
+            });
+        }
+    }
+
+    /// Construct the Aho-Corasick automaton with the given number of threads.
+    /// Throw std::length_error if the k-mers or the states do not fit the 32-bit indices.
+    void Construct(const PackedKMers &kMers, int threads = 1) {
+        if (kMers.Size() > size_t(UINT32_MAX)) throw std::length_error("the Aho-Corasick automaton supports at most 2^32 - 1 k-mers");
+        if (threads > 1) {
+            ConstructTrieSorted(kMers, threads);
+            ConstructBackwardEdgesByLevels(threads);
+            return;
+        }
         ConstructTrie(kMers);
         ConstructBackwardEdges();
     }
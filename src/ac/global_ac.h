@@ -9,9 +9,11 @@
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <functional>
 
 #include "kmers_ac.h"
 #include "ac_automaton.h"
+#include "suffix_array.h"
 
 
 /// Represents oriented edge in the overlap graph.
@@ -26,23 +28,26 @@ struct OverlapEdge {
 
 
 /// Greedily find the approximate overlapPath path with longest overlaps using the AC automaton.
-std::vector<OverlapEdge> OverlapHamiltonianPathAC (const std::vector<KMer> &kMers, bool complements) {
-    size_t n = kMers.size() / (1 + complements);
-    ACAutomaton automaton;
-    automaton.Construct(kMers);
-    std::vector<bool> forbidden(kMers.size(), false);
-    std::vector<bool> prefixForbidden(kMers.size(), false);
-    std::vector<std::list<size_t>> incidentKMers(automaton.states.size());
+/// The automaton is constructed with the given number of threads, which does not change the result.
+std::vector<OverlapEdge> OverlapHamiltonianPathAC (const PackedKMers &packedKMers, bool complements, int threads = 1) {
+    size_t kMerCount = packedKMers.Size();
+    size_t n = kMerCount / (1 + complements);
+    CompactACAutomaton automaton;
+    automaton.Construct(packedKMers, threads);
+    std::vector<bool> forbidden(kMerCount, false);
+    std::vector<bool> prefixForbidden(kMerCount, false);
+    std::vector<std::list<size_t>> incidentKMers(automaton.Size());
     std::vector<OverlapEdge> hamiltonianPath;
-    std::vector<size_t> first(kMers.size());
-    std::vector<size_t> last(kMers.size());
-    for (size_t i = 0; i < kMers.size(); ++i) {
+    std::vector<size_t> first(kMerCount);
+    std::vector<size_t> last(kMerCount);
+    for (size_t i = 0; i < kMerCount; ++i) {
         first[i] = last[i] = i;
-        incidentKMers[automaton.states[automaton.endStateIndices[i]].backwardEdge].push_back(i);
+        incidentKMers[automaton.backwardEdges[automaton.endStateIndices[i]]].push_back(i);
     }
     for (int s : automaton.reversedOrdering) {
         if (incidentKMers[s].empty()) continue;
-        for (size_t j : automaton.states[s].supporters) {
+        for (const uint32_t *supporter = automaton.SupportersBegin(s); supporter != automaton.SupportersEnd(s); ++supporter) {
+            size_t j = *supporter;
             if (incidentKMers[s].empty()) continue;
             if (forbidden[j]) continue;
             auto i = incidentKMers[s].begin();
@@ -57,9 +62,9 @@ std::vector<OverlapEdge> OverlapHamiltonianPathAC (const std::vector<KMer> &kMer
                 continue;
             }
             std::vector<std::pair<size_t,size_t>> new_edges ({{*i, j}});
-            if (complements) new_edges.emplace_back((j + n) % kMers.size(), (*i + n) % kMers.size());
+            if (complements) new_edges.emplace_back((j + n) % kMerCount, (*i + n) % kMerCount);
             for (auto [x, y] : new_edges) {
-                hamiltonianPath.push_back(OverlapEdge{x, y, automaton.states[s].depth});
+                hamiltonianPath.push_back(OverlapEdge{x, y, automaton.depths[s]});
                 forbidden[y] = true;
                 first[last[y]] = first[x];
                 last[first[x]] = last[y];
@@ -67,11 +72,164 @@ std::vector<OverlapEdge> OverlapHamiltonianPathAC (const std::vector<KMer> &kMer
             }
             incidentKMers[s].erase(i);
         }
-        incidentKMers[automaton.states[s].backwardEdge].splice(incidentKMers[automaton.states[s].backwardEdge].end(), incidentKMers[s]);
+        incidentKMers[automaton.backwardEdges[s]].splice(incidentKMers[automaton.backwardEdges[s]].end(), incidentKMers[s]);
+    }
+    return hamiltonianPath;
+}
+
+/// Greedily find the approximate overlapPath path with longest overlaps using the AC automaton.
+std::vector<OverlapEdge> OverlapHamiltonianPathAC (const std::vector<KMer> &kMers, bool complements) {
+    return OverlapHamiltonianPathAC(PackKMers(kMers, kMers.empty() ? 0 : (int)kMers[0].length()), complements);
+}
+
+/// Greedily find the approximate overlapPath path with longest overlaps as in OverlapHamiltonianPathAC,
+/// but with the suffix array of the k-mers separated by a character smaller than the nucleotides instead of the automaton.
+/// The suffixes of the k-mers with a prefix x of length d form an interval of the suffix array in which the k-mers
+/// with the suffix x are the first ones, so the intervals of the LCP array play the role of the states of depth d.
+/// The states with both a suffix and a prefix of a k-mer are processed in the same order as in the automaton
+/// and the suffixes and prefixes of each state are matched in the same order as in the automaton, so the result is the same.
+/// The memory is O(n k) bytes with a smaller constant than the automaton and the LCP array is computed by the given number of threads.
+template <typename index_t>
+std::vector<OverlapEdge> OverlapHamiltonianPathSAIndexed (const PackedKMers &packedKMers, bool complements, int threads) {
+    size_t kMerCount = packedKMers.Size();
+    size_t n = kMerCount / (1 + complements);
+    int k = packedKMers.k;
+    size_t width = k + 1;
+    // The k-mers are followed by separators 1 and the text ends by 0.
+    std::vector<uint8_t> text(kMerCount * width + 1, 1);
+    ParallelFor(0, kMerCount, threads, [&](size_t from, size_t to, int) {
+        for (size_t i = from; i < to; ++i) for (int j = 0; j < k; ++j) text[i * width + j] = uint8_t(2 + packedKMers.Nucleotide(i, j));
+    });
+    text.back() = 0;
+    std::vector<index_t> sa = SuffixArray<index_t>(text, 6);
+    // The length of the suffix of a k-mer starting at the given position, which is 0 for the separators.
+    auto suffixLength = [&](size_t position) { return position + 1 == text.size() ? 0 : int(k - position % width); };
+
+    // The ranks of the prefixes, i.e., of the whole k-mers.
+    std::vector<index_t> prefixRanks;
+    prefixRanks.reserve(kMerCount);
+    for (size_t r = 0; r < sa.size(); ++r) if (suffixLength(sa[r]) == k) prefixRanks.push_back(index_t(r));
+
+    // The intervals of the suffix array with the k-mers whose suffix of length d is a prefix of another k-mer, by d.
+    std::vector<std::vector<std::pair<index_t, index_t>>> states(k);
+    {
+        std::vector<index_t> plcp = PermutedCommonPrefixArray(text, sa, threads);
+        std::vector<std::pair<int, index_t>> stack{{0, 0}};
+        for (size_t r = 1; r <= sa.size(); ++r) {
+            int lcp = r < sa.size() ? int(plcp[sa[r]]) : 0;
+            index_t left = index_t(r - 1);
+            while (lcp < stack.back().first) {
+                auto [d, begin] = stack.back();
+                stack.pop_back();
+                left = begin;
+                if (d >= k || suffixLength(sa[begin]) != d) continue;
+                auto prefix = std::lower_bound(prefixRanks.begin(), prefixRanks.end(), begin);
+                if (prefix != prefixRanks.end() && *prefix < r) states[d].emplace_back(begin, index_t(r - 1));
+            }
+            if (lcp > stack.back().first) stack.emplace_back(lcp, left);
+        }
+    }
+
+    std::vector<bool> forbidden(kMerCount, false);
+    std::vector<bool> prefixForbidden(kMerCount, false);
+    std::vector<OverlapEdge> hamiltonianPath;
+    std::vector<size_t> first(kMerCount);
+    std::vector<size_t> last(kMerCount);
+    for (size_t i = 0; i < kMerCount; ++i) first[i] = last[i] = i;
+    // The automaton passes the unmatched k-mers of a state to the end of the list of its fail state,
+    // which is the next state with the k-mers among its suffixes. So the k-mers of a state are ordered first those
+    // for which it is the first state by their indices, then by the number of the state which passed them (1-based in the processing order)
+    // and their position in its list.
+    std::vector<index_t> listState(kMerCount, 0), listPosition(kMerCount, 0);
+    index_t processedStates = 0;
+    auto listOrder = [&](size_t i, size_t j) {
+        if (listState[i] != listState[j]) return listState[i] < listState[j];
+        return listState[i] ? listPosition[i] < listPosition[j] : i < j;
+    };
+    std::list<size_t> incidentKMers;
+    // The available prefixes of the current state as a heap, so that they are matched in the order of their indices
+    // as the supporters of the automaton, but only as many of them are ordered as are matched.
+    std::vector<size_t> supporters;
+    auto match = [&](int d) {
+        std::make_heap(supporters.begin(), supporters.end(), std::greater<size_t>());
+        while (!supporters.empty() && !incidentKMers.empty()) {
+            std::pop_heap(supporters.begin(), supporters.end(), std::greater<size_t>());
+            size_t j = supporters.back();
+            supporters.pop_back();
+            if (forbidden[j]) continue;
+            auto i = incidentKMers.begin();
+            // If the path forms a cycle, or is between k-mer and its reverse complement, skip this path.
+            while (i != incidentKMers.end() && (first[*i]%n == j%n || first[*i]%n == last[j]%n|| prefixForbidden[*i])) {
+                auto new_i = i;
+                new_i++;
+                if (prefixForbidden[*i]) incidentKMers.erase(i);
+                i = new_i;
+            }
+            if (i == incidentKMers.end()) {
+                continue;
+            }
+            std::vector<std::pair<size_t,size_t>> new_edges ({{*i, j}});
+            if (complements) new_edges.emplace_back((j + n) % kMerCount, (*i + n) % kMerCount);
+            for (auto [x, y] : new_edges) {
+                hamiltonianPath.push_back(OverlapEdge{x, y, d});
+                forbidden[y] = true;
+                first[last[y]] = first[x];
+                last[first[x]] = last[y];
+                prefixForbidden[x] = true;
+            }
+            incidentKMers.erase(i);
+        }
+        ++processedStates;
+        index_t position = 0;
+        for (size_t i : incidentKMers) {
+            listState[i] = processedStates;
+            listPosition[i] = position++;
+        }
+    };
+    std::vector<size_t> suffixes;
+    for (int d = k - 1; d > 0; --d) {
+        for (auto state = states[d].rbegin(); state != states[d].rend(); ++state) {
+            auto [begin, end] = *state;
+            suffixes.clear();
+            for (size_t r = begin; r <= end && suffixLength(sa[r]) == d; ++r) {
+                if (!prefixForbidden[sa[r] / width]) suffixes.push_back(sa[r] / width);
+            }
+            if (suffixes.empty()) continue;
+            std::sort(suffixes.begin(), suffixes.end(), listOrder);
+            incidentKMers.assign(suffixes.begin(), suffixes.end());
+            supporters.clear();
+            for (auto prefix = std::lower_bound(prefixRanks.begin(), prefixRanks.end(), begin); prefix != prefixRanks.end() && *prefix <= end; ++prefix) {
+                if (!forbidden[sa[*prefix] / width]) supporters.push_back(sa[*prefix] / width);
+            }
+            match(d);
+        }
+        std::vector<std::pair<index_t, index_t>>().swap(states[d]);
     }
+    // Join the remaining paths with no overlap as the root of the automaton.
+    suffixes.clear();
+    for (size_t i = 0; i < kMerCount; ++i) if (!prefixForbidden[i]) suffixes.push_back(i);
+    std::sort(suffixes.begin(), suffixes.end(), listOrder);
+    incidentKMers.assign(suffixes.begin(), suffixes.end());
+    supporters.clear();
+    for (size_t j = 0; j < kMerCount; ++j) if (!forbidden[j]) supporters.push_back(j);
+    match(0);
     return hamiltonianPath;
 }
 
+/// Greedily find the approximate overlapPath path with longest overlaps using the suffix array as in OverlapHamiltonianPathSAIndexed.
+/// The positions in the suffix array are stored in 32 bits whenever they fit.
+std::vector<OverlapEdge> OverlapHamiltonianPathSA (const PackedKMers &packedKMers, bool complements, int threads = 1) {
+    if (packedKMers.Size() * (packedKMers.k + 1) + 1 < UINT32_MAX) {
+        return OverlapHamiltonianPathSAIndexed<uint32_t>(packedKMers, complements, threads);
+    }
+    return OverlapHamiltonianPathSAIndexed<uint64_t>(packedKMers, complements, threads);
+}
+
+/// Greedily find the approximate overlapPath path with longest overlaps using the suffix array.
+std::vector<OverlapEdge> OverlapHamiltonianPathSA (const std::vector<KMer> &kMers, bool complements) {
+    return OverlapHamiltonianPathSA(PackKMers(kMers, kMers.empty() ? 0 : (int)kMers[0].length()), complements);
+}
+
 
 /// Return the suffix of the given kMer without the first *overlap* chars.
 std::string Suffix(const KMer &kMer, const int overlap) {
@@ -79,10 +237,16 @@ std::string Suffix(const KMer &kMer, const int overlap) {
 }
 
 
+/// Print the j-th to (end-1)-th nucleotides of the i-th k-mer in lower case.
+void WriteUnmaskedNucleotides(const PackedKMers &kMers, size_t i, int j, int end, std::ostream& of) {
+    for (; j < end; ++j) of << (char)std::tolower(letters[kMers.Nucleotide(i, j)]);
+}
+
 /// Construct the superstring and the path from the given overlapPath path in the overlap graph.
-void SuperstringFromPath(const std::vector<OverlapEdge> &hamiltonianPath, const std::vector<KMer> &kMers, std::ostream& of, const int k) {
-    std::vector<OverlapEdge> edgeFrom (kMers.size(), OverlapEdge{size_t(-1),size_t(-1), -1});
-    std::vector<bool> isStart(kMers.size(), false);
+void SuperstringFromPath(const std::vector<OverlapEdge> &hamiltonianPath, const PackedKMers &kMers, std::ostream& of, const int k) {
+    size_t kMerCount = kMers.Size();
+    std::vector<OverlapEdge> edgeFrom (kMerCount, OverlapEdge{size_t(-1),size_t(-1), -1});
+    std::vector<bool> isStart(kMerCount, false);
     for (auto edge : hamiltonianPath) {
         isStart[edge.firstIndex] = true;
         edgeFrom[edge.firstIndex] = edge;
@@ -93,46 +257,54 @@ void SuperstringFromPath(const std::vector<OverlapEdge> &hamiltonianPath, const
 
     // Find the vertex in the overlap graph with in-degree 0.
     size_t start = 0;
-    for (; start < kMers.size() && !isStart[start]; ++start);
+    for (; start < kMerCount && !isStart[start]; ++start);
     // Handle the edge case of only one k-mer.
-    start %= kMers.size();
+    start %= kMerCount;
 
     // Print the first character.
-    of << kMers[start].value[0];
+    of << letters[kMers.Nucleotide(start, 0)];
 
     // Move from the first k-mer to the last which has no successor.
     while(edgeFrom[start].secondIndex != size_t(-1)) {
         int overlapLength = edgeFrom[start].overlapLength;
-        if (overlapLength != k - 1) {
-            std::string unmaskedNucleotides = kMers[start].value.substr(1, k - 1 - overlapLength);
-            std::transform(unmaskedNucleotides.begin(), unmaskedNucleotides.end(), unmaskedNucleotides.begin(), tolower);
-            of << unmaskedNucleotides;
-        }
-        of << kMers[edgeFrom[start].secondIndex].value[0];
+        if (overlapLength != k - 1) WriteUnmaskedNucleotides(kMers, start, 1, k - overlapLength, of);
+        of << letters[kMers.Nucleotide(edgeFrom[start].secondIndex, 0)];
         start = edgeFrom[start].secondIndex;
     }
 
     // Print the trailing k-1 characters.
-    std::string unmaskedNucleotides = kMers[start].value.substr(1);
-    std::transform(unmaskedNucleotides.begin(), unmaskedNucleotides.end(), unmaskedNucleotides.begin(), tolower);
-    of << unmaskedNucleotides;
+    WriteUnmaskedNucleotides(kMers, start, 1, k, of);
+}
+
+/// Construct the superstring and the path from the given overlapPath path in the overlap graph.
+void SuperstringFromPath(const std::vector<OverlapEdge> &hamiltonianPath, const std::vector<KMer> &kMers, std::ostream& of, const int k) {
+    SuperstringFromPath(hamiltonianPath, PackKMers(kMers, k), of, k);
 }
 
 /// Get the approximated shortest superstring of the given k-mers using the global greedy algorithm with Aho-Corasick automaton.
 /// This runs in O(n k), where n is the number of k-mers.
 /// If complements are provided, it is expected that kMers do not contain both k-mer and its reverse complement.
-void GlobalAC(std::vector<KMer> kMers, std::ostream& of, bool complements) {
-	if (kMers.empty()) {
+/// If suffixArray is set, the overlaps are found by the suffix array instead of the automaton, which needs less memory for large k.
+void GlobalAC(PackedKMers kMers, std::ostream& of, bool complements, int threads = 1, bool suffixArray = false) {
+	if (!kMers.Size()) {
 		throw std::invalid_argument("input cannot be empty");
 	}
     // Add complementary k-mers.
-    size_t n = kMers.size();
-    kMers.resize(n * (1 + complements));
-    if (complements) for (size_t i = 0; i < n; ++i) {
-        kMers[i + n] = ReverseComplement(kMers[i]);
+    size_t n = kMers.Size();
+    if (complements) {
+        kMers.words.reserve(2 * kMers.words.size());
+        for (size_t i = 0; i < n; ++i) kMers.AddReverseComplement(i);
     }
 
-	const int k = (int)kMers[0].length();
-    auto hamiltonianPath = OverlapHamiltonianPathAC(kMers, complements);
-    SuperstringFromPath(hamiltonianPath, kMers, of, k);
+    auto hamiltonianPath = suffixArray ? OverlapHamiltonianPathSA(kMers, complements, threads)
+                                       : OverlapHamiltonianPathAC(kMers, complements, threads);
+    SuperstringFromPath(hamiltonianPath, kMers, of, kMers.k);
+}
+
+/// Get the approximated shortest superstring of the given k-mers using the global greedy algorithm with Aho-Corasick automaton.
+void GlobalAC(const std::vector<KMer> &kMers, std::ostream& of, bool complements) {
+	if (kMers.empty()) {
+		throw std::invalid_argument("input cannot be empty");
+	}
+    GlobalAC(PackKMers(kMers, (int)kMers[0].length()), of, complements);
 }
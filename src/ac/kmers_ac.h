@@ -1,7 +1,11 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
 #include "../kmers.h"
+#include "../radix_sort.h"
 
 struct KMer {
     std::string value;
@@ -53,3 +57,112 @@ kmer64_t KMerToNumber(const KMer &kMer) {
     return ret;
 }
 
+
+/// K-mers of arbitrary length packed by 2 bits per nucleotide into 64-bit words.
+/// The first nucleotide is in the highest bits of the first word, so that the packed k-mers compare as their strings.
+struct PackedKMers {
+    int k = 0;
+    // Number of words of each k-mer.
+    size_t wordsPerKMer = 0;
+    std::vector<uint64_t> words;
+
+    PackedKMers() = default;
+    explicit PackedKMers(int k) : k(k), wordsPerKMer((k + 31) / 32) {}
+
+    /// Return the number of the k-mers.
+    size_t Size() const {
+        return wordsPerKMer ? words.size() / wordsPerKMer : 0;
+    }
+
+    /// Return the index of the j-th nucleotide of the i-th k-mer.
+    int Nucleotide(size_t i, int j) const {
+        return int((words[i * wordsPerKMer + (j >> 5)] >> (62 - ((j & 31) << 1))) & 3);
+    }
+
+    /// Append the given k-mer of length k.
+    void Add(const KMer &kMer) {
+        words.resize(words.size() + wordsPerKMer, 0);
+        uint64_t *packed = &words[words.size() - wordsPerKMer];
+        for (int j = 0; j < k; ++j) packed[j >> 5] |= uint64_t(NucleotideToInt(kMer.value[j])) << (62 - ((j & 31) << 1));
+    }
+
+    /// Return the first word of the i-th k-mer.
+    const uint64_t *Words(size_t i) const {
+        return words.data() + i * wordsPerKMer;
+    }
+
+    /// Append the reverse complement of the i-th k-mer.
+    void AddReverseComplement(size_t i) {
+        words.resize(words.size() + wordsPerKMer, 0);
+        uint64_t *packed = &words[words.size() - wordsPerKMer];
+        for (int j = 0; j < k; ++j) packed[j >> 5] |= uint64_t(3 ^ Nucleotide(i, k - 1 - j)) << (62 - ((j & 31) << 1));
+    }
+
+    /// Return the length of the longest common prefix of the i-th and j-th k-mer.
+    int CommonPrefixLength(size_t i, size_t j) const {
+        for (size_t w = 0; w < wordsPerKMer; ++w) {
+            uint64_t difference = Words(i)[w] ^ Words(j)[w];
+            if (difference) return std::min(k, int(32 * w) + __builtin_clzll(difference) / 2);
+        }
+        return k;
+    }
+
+    /// Return the indices of the k-mers in the order of the k-mers, with the equal k-mers ordered by their indices.
+    /// The words are radix-sorted from the last one, so that the sorts by the earlier words keep the order by the later ones.
+    std::vector<uint32_t> SortedOrder(int threads) const {
+        std::vector<uint32_t> order(Size());
+        std::iota(order.begin(), order.end(), 0);
+        std::vector<std::pair<uint64_t, uint32_t>> pairs(Size());
+        for (size_t w = wordsPerKMer; w-- > 0;) {
+            // Only the highest bits of the last word are used.
+            int bits = 2 * std::min(32, k - 32 * int(w));
+            ParallelFor(0, Size(), threads, [&](size_t from, size_t to, int) {
+                for (size_t i = from; i < to; ++i) pairs[i] = {Words(order[i])[w] >> (64 - bits), order[i]};
+            });
+            RadixSortPairs(pairs, bits, threads);
+            ParallelFor(0, Size(), threads, [&](size_t from, size_t to, int) {
+                for (size_t i = from; i < to; ++i) order[i] = pairs[i].second;
+            });
+        }
+        return order;
+    }
+
+    /// Sort the k-mers and remove the duplicates.
+    /// K-mers of a single word are radix-sorted in place, the longer ones through an array of their indices.
+    void SortAndDeduplicate() {
+        if (wordsPerKMer == 1) {
+            RadixSortKMers(words, 32, 1);
+            words.erase(std::unique(words.begin(), words.end()), words.end());
+            return;
+        }
+        std::vector<size_t> order(Size());
+        std::iota(order.begin(), order.end(), 0);
+        auto less = [this](size_t x, size_t y) {
+            return std::lexicographical_compare(Words(x), Words(x) + wordsPerKMer, Words(y), Words(y) + wordsPerKMer);
+        };
+        std::sort(order.begin(), order.end(), less);
+        std::vector<uint64_t> sorted;
+        sorted.reserve(words.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (i && !less(order[i - 1], order[i])) continue;
+            sorted.insert(sorted.end(), Words(order[i]), Words(order[i]) + wordsPerKMer);
+        }
+        words = std::move(sorted);
+    }
+
+    /// Return the i-th k-mer.
+    KMer Get(size_t i) const {
+        KMer kMer;
+        kMer.value.resize(k);
+        for (int j = 0; j < k; ++j) kMer.value[j] = letters[Nucleotide(i, j)];
+        return kMer;
+    }
+};
+
+/// Pack the given k-mers of length k.
+PackedKMers PackKMers(const std::vector<KMer> &kMers, int k) {
+    PackedKMers packed(k);
+    packed.words.reserve(kMers.size() * packed.wordsPerKMer);
+    for (auto &kMer : kMers) packed.Add(kMer);
+    return packed;
+}
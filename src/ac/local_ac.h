@@ -32,92 +32,136 @@ size_t ExtensionAC(std::vector<bool> &forbidden, std::list<size_t> &incidentKMer
     return -1;
 }
 
+/// Find the index of the first extending k-mer among supporters[front] to supporters[end - 1] which is not forbidden.
+/// Mark this k-mer forbidden and move front past it and the forbidden k-mers before it.
+/// If complements is true, it is expected that index i and i + size/2 in forbidden represent complementary k-mers.
+/// Return -1 if only forbidden k-mers were found.
+size_t ExtensionAC(std::vector<bool> &forbidden, const std::vector<uint32_t> &supporters, uint64_t &front, uint64_t end, bool complements) {
+    size_t n = forbidden.size() / (1 + complements);
+    for (; front < end; ++front) {
+        size_t kMer = supporters[front];
+        if (forbidden[kMer]) continue;
+        forbidden[kMer] = true;
+        // Mark complementary k-mer as used (if complements is set to false, this is k-mer itself).
+        forbidden[(kMer + n) % forbidden.size()] = true;
+        ++front;
+        return kMer;
+    }
+    return -1;
+}
+
 /// Get the approximated shortest superstring of the given k-mers using the local greedy algorithm with Aho-Corasick automaton.
 ///
 /// This runs in O(n k), where n is the number of k-mers.
+/// Besides the automaton, it keeps only the d_max suffix states of each k-mer, the k-mers incident to these states
+/// and the prefix states of the leftmost k-mer of the current simplitig.
 /// If complements are provided, it is expected that kMers do not contain both k-mer and its reverse complement.
-void LocalAC(std::vector<KMer> kMers, std::ostream& of, int k, int d_max, bool complements) {
+/// The automaton is constructed with the given number of threads, which does not change the result.
+void LocalAC(PackedKMers kMers, std::ostream& of, int k, int d_max, bool complements, int threads = 1) {
     // Add complementary k-mers.
-    size_t n = kMers.size();
-    kMers.resize(n * (1 + complements));
-    if (complements) for (size_t i = 0; i < n; ++i) {
-        kMers[i + n] = ReverseComplement(kMers[i]);
+    size_t n = kMers.Size();
+    if (complements) {
+        kMers.words.reserve(2 * kMers.words.size());
+        for (size_t i = 0; i < n; ++i) kMers.AddReverseComplement(i);
     }
 
-    ACAutomaton a;
-    a.Construct(kMers);
+    CompactACAutomaton a;
+    a.Construct(kMers, threads);
+    // Position of the first supporter of each state which may not be forbidden yet.
+    std::vector<uint64_t> supporterFronts(a.supporterOffsets.begin(), a.supporterOffsets.end() - 1);
 
-    // suffixes[i][j] is the state in the AC automaton given by the suffix of kMers[i] of size j (or -1 is none).
-    std::vector<std::vector<int>> suffixes(kMers.size(), std::vector<int> (k + 1, -1));
-    // suffixes[i][j] is the state in the AC automaton given by the prefix of kMers[i] of size j.
-    std::vector<std::vector<int>> prefixes(kMers.size(), std::vector<int>(k + 1, 0));
-    // For each state the list of k-mers which have the given state as a suffix.
-    std::vector<std::list<size_t>> incidentKMers(a.states.size());
-    // true if the given k-mer has already been used.
-    std::vector<bool> forbidden(kMers.size(), false);
-
-    for (size_t i = 0; i < kMers.size(); ++i) {
-        for(int j = 0; j < k; ++j) {
-            prefixes[i][j + 1] = a.states[prefixes[i][j]].forwardEdges[NucleotideToInt(kMers[i].value[j])];
+    // Only the proper suffixes and prefixes of length at least k - d_max are ever extended.
+    d_max = std::min(d_max, k);
+    int minDepth = k - d_max;
+    // suffixes[i * d_max + d - 1] is the state in the AC automaton given by the suffix of kMers[i] of size k - d (or -1 if none).
+    std::vector<int32_t> suffixes(kMers.Size() * d_max, -1);
+    // For each state, the k-mers which have the given state as a suffix are at positions incidentOffsets[s] to incidentOffsets[s + 1].
+    std::vector<uint64_t> incidentOffsets(a.Size() + 1, 0);
+    for (size_t i = 0; i < kMers.Size(); ++i) {
+        for (int s = a.backwardEdges[a.endStateIndices[i]]; a.depths[s] >= minDepth; s = a.backwardEdges[s]) {
+            suffixes[i * d_max + k - a.depths[s] - 1] = s;
+            ++incidentOffsets[s + 1];
+            if (s == 0) break;
         }
-        for (int s = a.endStateIndices[i]; ; s = a.states[s].backwardEdge) {
-            suffixes[i][a.states[s].depth] = s;
-            incidentKMers[s].push_back(i);
+    }
+    for (size_t s = 0; s < a.Size(); ++s) incidentOffsets[s + 1] += incidentOffsets[s];
+    std::vector<uint32_t> incidentKMers(incidentOffsets.back());
+    // Position of the first incident k-mer of each state which may not be forbidden yet.
+    std::vector<uint64_t> incidentFronts(incidentOffsets.begin(), incidentOffsets.end() - 1);
+    for (size_t i = 0; i < kMers.Size(); ++i) {
+        for (int s = a.backwardEdges[a.endStateIndices[i]]; a.depths[s] >= minDepth; s = a.backwardEdges[s]) {
+            incidentKMers[incidentFronts[s]++] = uint32_t(i);
             if (s == 0) break;
         }
     }
+    std::copy(incidentOffsets.begin(), incidentOffsets.end() - 1, incidentFronts.begin());
+    // prefixes[j] is the state in the AC automaton given by the prefix of the leftmost k-mer of size j.
+    // It is computed by walking the trie whenever the leftmost k-mer changes.
+    std::vector<int32_t> prefixes(k + 1, 0);
+    auto walkPrefixes = [&](size_t kMer) {
+        for (int j = 0; j < k; ++j) prefixes[j + 1] = a.forwardEdges[4 * prefixes[j] + kMers.Nucleotide(kMer, j)];
+    };
+    // true if the given k-mer has already been used.
+    std::vector<bool> forbidden(kMers.Size(), false);
 
     size_t firstUnused = 0;
     for(;;) {
         // Find the first unused k-mer.
         while(forbidden[firstUnused]) {
             ++firstUnused;
-            if (firstUnused == kMers.size()) {
+            if (firstUnused == kMers.Size()) {
                 firstUnused = size_t(-1);
                 break;
             }
         }
         if (firstUnused == size_t(-1)) break;
-        std::list<char> simplitig = {kMers[firstUnused].value[0]};
+        std::list<char> simplitig = {letters[kMers.Nucleotide(firstUnused, 0)]};
         // Maintain the left and right most k-mer of the generalized simplitig.
         size_t firstKMer = firstUnused;
         size_t lastKMer = firstUnused;
+        walkPrefixes(firstKMer);
         forbidden[firstUnused] = true;
         // Forbid the complementary k-mer.
         forbidden[(firstUnused + n) % forbidden.size()] = true;
         int d_l = 1, d_r = 1;
         while (d_l <= d_max || d_r <= d_max) {
             if (d_r <= d_l) {
-                int state = suffixes[lastKMer][k - d_r];
+                int state = suffixes[lastKMer * d_max + d_r - 1];
                 size_t ext = -1;
-                if (state != -1) ext = ExtensionAC(forbidden, a.states[state].supporters, complements);
+                if (state != -1) ext = ExtensionAC(forbidden, a.supporters, supporterFronts[state], a.supporterOffsets[state + 1], complements);
                 if (ext == size_t(-1)) {
                     // No right extension found.
                     ++d_r;
                 } else {
                     // Extend the generalized simplitig to the right.
-                    for (int i = 1; i < d_r; ++i) simplitig.emplace_back((char)std::tolower(kMers[lastKMer].value[i]));
-                    simplitig.emplace_back(kMers[lastKMer].value[d_r]);
+                    for (int i = 1; i < d_r; ++i) simplitig.emplace_back((char)std::tolower(letters[kMers.Nucleotide(lastKMer, i)]));
+                    simplitig.emplace_back(letters[kMers.Nucleotide(lastKMer, d_r)]);
                     lastKMer = ext;
                     d_r = 1;
                 }
             } else {
-                int state = prefixes[firstKMer][k - d_l];
-                size_t ext = ExtensionAC(forbidden, incidentKMers[state], complements);
+                int state = prefixes[k - d_l];
+                size_t ext = ExtensionAC(forbidden, incidentKMers, incidentFronts[state], incidentOffsets[state + 1], complements);
                 if (ext == size_t(-1)) {
                     // No left extension found.
                     ++d_l;
                 } else {
                     // Extend the simplitig to the left.
-                    for (int i = d_l - 1; i > 0; --i) simplitig.emplace_front((char)std::tolower(kMers[ext].value[i]));
-                    simplitig.emplace_front(kMers[ext].value[0]);
+                    for (int i = d_l - 1; i > 0; --i) simplitig.emplace_front((char)std::tolower(letters[kMers.Nucleotide(ext, i)]));
+                    simplitig.emplace_front(letters[kMers.Nucleotide(ext, 0)]);
                     firstKMer = ext;
+                    walkPrefixes(firstKMer);
                     d_l = 1;
                 }
             }
         }
-        for (int i = 1; i < k; ++i) simplitig.emplace_back((char)std::tolower(kMers[lastKMer].value[i]));
+        for (int i = 1; i < k; ++i) simplitig.emplace_back((char)std::tolower(letters[kMers.Nucleotide(lastKMer, i)]));
         of << std::string(simplitig.begin(), simplitig.end());
     }
 }
 
+
+/// Get the approximated shortest superstring of the given k-mers using the local greedy algorithm with Aho-Corasick automaton.
+void LocalAC(const std::vector<KMer> &kMers, std::ostream& of, int k, int d_max, bool complements) {
+    LocalAC(PackKMers(kMers, k), of, k, d_max, complements);
+}
@@ -77,3 +77,77 @@ std::vector<KMer> ConstructKMers(std::vector<FastaRecord> &data, int k, bool com
     }
     return result;
 }
+
+
+/// Minimum number of the packed k-mers collected before their duplicates are removed.
+constexpr size_t PACKED_KMERS_DEDUPLICATION_SIZE = size_t(1) << 20;
+
+/// Collects the k-mers of arbitrary length from the sequences, packed by 2 bits per nucleotide.
+/// The duplicates are removed whenever the number of the collected k-mers doubles, so they take at most twice the memory of the distinct ones.
+struct PackedKMersCollector {
+    PackedKMers kMers;
+    bool complements;
+    // The current k-mer and its reverse complement.
+    std::vector<uint64_t> forward, reverseComplement;
+    // Number of the k-mers at which the duplicates are removed next.
+    size_t deduplicationSize = PACKED_KMERS_DEDUPLICATION_SIZE;
+
+    PackedKMersCollector(int k, bool complements)
+            : kMers(k), complements(complements), forward(kMers.wordsPerKMer, 0), reverseComplement(kMers.wordsPerKMer, 0) {}
+
+    /// Append the k-mers of the given sequence.
+    /// If complements is true, append the canonical k-mers, i.e., the smaller of the k-mer and its reverse complement.
+    void Add(size_t sequence_length, const char *sequence) {
+        int k = kMers.k;
+        size_t words = kMers.wordsPerKMer;
+        int lastShift = 62 - (((k - 1) & 31) << 1);
+        // Keep only the nucleotides up to the k-th one in the last word.
+        uint64_t lastMask = ~uint64_t(0) << lastShift;
+        int currentLength = 0;
+        for (size_t i = 0; i < sequence_length; ++i) {
+            auto data = nucleotideToInt[(uint8_t)sequence[i]];
+            if (data >= 4) {
+                // Restart if "N"-like nucleotide.
+                currentLength = 0;
+                continue;
+            }
+            for (size_t w = 0; w < words; ++w) {
+                forward[w] = (forward[w] << 2) | (w + 1 < words ? forward[w + 1] >> 62 : 0);
+            }
+            forward[words - 1] |= uint64_t(data) << lastShift;
+            for (size_t w = words; w-- > 0;) {
+                reverseComplement[w] = (reverseComplement[w] >> 2) | (w ? reverseComplement[w - 1] << 62 : 0);
+            }
+            reverseComplement[0] |= uint64_t(3 ^ data) << 62;
+            reverseComplement[words - 1] &= lastMask;
+            if (++currentLength < k) continue;
+            const auto &canonical = (!complements || forward <= reverseComplement) ? forward : reverseComplement;
+            kMers.words.insert(kMers.words.end(), canonical.begin(), canonical.end());
+            if (kMers.Size() >= deduplicationSize) {
+                kMers.SortAndDeduplicate();
+                deduplicationSize = std::max(deduplicationSize, 2 * kMers.Size());
+            }
+        }
+    }
+
+    /// Return the sorted distinct k-mers.
+    PackedKMers Finish() {
+        kMers.SortAndDeduplicate();
+        return std::move(kMers);
+    }
+};
+
+/// Load the k-mers of arbitrary length from a fasta file (or stdin if path is "-"), packed by 2 bits per nucleotide.
+/// The records are streamed through kseq and the returned k-mers are sorted and distinct.
+/// If complements is true, keep the canonical k-mers.
+PackedKMers ReadPackedKMers(std::string &path, int k, bool complements) {
+    PackedKMersCollector collector(k, complements);
+    gzFile fp = OpenFile(path);
+    kseq_t *seq = kseq_init(fp);
+    while (kseq_read(seq) >= 0) {
+        collector.Add(seq->seq.l, seq->seq.s);
+    }
+    kseq_destroy(seq);
+    gzclose(fp);
+    return collector.Finish();
+}
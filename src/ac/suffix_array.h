@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "../parallel.h"
+
+/// Compute the suffix array of the given text by the induced sorting (SA-IS) of Nong, Zhang and Chan.
+/// The characters are smaller than the alphabet size and the last one has to be a unique smallest character.
+/// The sorted LMS substrings are named and, unless the names are unique, their suffix array is computed recursively
+/// in the second half of the given array, so no memory is allocated besides the types and the buckets.
+template <typename index_t, typename char_t>
+void InducedSuffixArray(const char_t *text, index_t *sa, size_t n, size_t alphabet) {
+    const index_t EMPTY = ~index_t(0);
+    if (n == 1) {
+        sa[0] = 0;
+        return;
+    }
+    // Whether the suffix is smaller than the following one (S-type), or larger (L-type).
+    std::vector<bool> smaller(n, false);
+    smaller[n - 1] = true;
+    for (size_t i = n - 1; i-- > 0;) smaller[i] = text[i] < text[i + 1] || (text[i] == text[i + 1] && smaller[i + 1]);
+    auto isLMS = [&](size_t i) { return i > 0 && smaller[i] && !smaller[i - 1]; };
+
+    std::vector<index_t> counts(alphabet, 0), bucket(alphabet);
+    for (size_t i = 0; i < n; ++i) ++counts[text[i]];
+    auto bucketStarts = [&]() {
+        index_t sum = 0;
+        for (size_t c = 0; c < alphabet; ++c) bucket[c] = sum, sum += counts[c];
+    };
+    auto bucketEnds = [&]() {
+        index_t sum = 0;
+        for (size_t c = 0; c < alphabet; ++c) sum += counts[c], bucket[c] = sum;
+    };
+    auto induce = [&]() {
+        bucketStarts();
+        for (size_t i = 0; i < n; ++i) {
+            if (sa[i] == EMPTY || sa[i] == 0 || smaller[sa[i] - 1]) continue;
+            sa[bucket[text[sa[i] - 1]]++] = sa[i] - 1;
+        }
+        bucketEnds();
+        for (size_t i = n; i-- > 0;) {
+            if (sa[i] == EMPTY || sa[i] == 0 || !smaller[sa[i] - 1]) continue;
+            sa[--bucket[text[sa[i] - 1]]] = sa[i] - 1;
+        }
+    };
+
+    // Sort the LMS substrings.
+    std::fill(sa, sa + n, EMPTY);
+    bucketEnds();
+    for (size_t i = 1; i < n; ++i) if (isLMS(i)) sa[--bucket[text[i]]] = index_t(i);
+    induce();
+
+    // Name the sorted LMS substrings; as they are at least two apart, the names fit into the second half.
+    size_t lmsCount = 0;
+    for (size_t i = 0; i < n; ++i) if (sa[i] != EMPTY && isLMS(sa[i])) sa[lmsCount++] = sa[i];
+    std::fill(sa + lmsCount, sa + n, EMPTY);
+    index_t names = 0;
+    size_t previous = n;
+    for (size_t i = 0; i < lmsCount; ++i) {
+        size_t position = sa[i];
+        bool different = previous == n;
+        for (size_t d = 0; !different; ++d) {
+            if (text[position + d] != text[previous + d] || smaller[position + d] != smaller[previous + d]) different = true;
+            else if (d > 0 && (isLMS(position + d) || isLMS(previous + d))) break;
+        }
+        if (different) ++names, previous = position;
+        sa[lmsCount + position / 2] = names - 1;
+    }
+    for (size_t i = n, j = n; i-- > lmsCount;) if (sa[i] != EMPTY) sa[--j] = sa[i];
+
+    // Sort the LMS suffixes by their names.
+    index_t *reduced = sa + n - lmsCount;
+    if (names < lmsCount) InducedSuffixArray<index_t>(reduced, sa, lmsCount, names);
+    else for (size_t i = 0; i < lmsCount; ++i) sa[reduced[i]] = index_t(i);
+
+    // Induce the order of all the suffixes from the sorted LMS suffixes.
+    for (size_t i = 1, j = 0; i < n; ++i) if (isLMS(i)) reduced[j++] = index_t(i);
+    for (size_t i = 0; i < lmsCount; ++i) sa[i] = reduced[sa[i]];
+    std::fill(sa + lmsCount, sa + n, EMPTY);
+    bucketEnds();
+    for (size_t i = lmsCount; i-- > 0;) {
+        index_t position = sa[i];
+        sa[i] = EMPTY;
+        sa[--bucket[text[position]]] = position;
+    }
+    induce();
+}
+
+/// Return the suffix array of the given text whose last character is a unique smallest one.
+template <typename index_t>
+std::vector<index_t> SuffixArray(const std::vector<uint8_t> &text, size_t alphabet) {
+    std::vector<index_t> sa(text.size());
+    if (!text.empty()) InducedSuffixArray<index_t>(text.data(), sa.data(), text.size(), alphabet);
+    return sa;
+}
+
+/// Return the lengths of the longest common prefixes of the suffixes with their predecessors in the suffix array,
+/// indexed by the positions of the suffixes in the text (the permuted LCP array).
+/// The prefixes end before the first character smaller than 2, so that they do not span the separators.
+/// The array is computed by the Φ algorithm of Kärkkäinen, Manzini and Puglisi in place of the predecessors;
+/// the text is split among the threads, each of which starts from a zero length.
+template <typename index_t>
+std::vector<index_t> PermutedCommonPrefixArray(const std::vector<uint8_t> &text, const std::vector<index_t> &sa, int threads) {
+    const index_t EMPTY = ~index_t(0);
+    size_t n = sa.size();
+    std::vector<index_t> plcp(n);
+    ParallelFor(0, n, threads, [&](size_t from, size_t to, int) {
+        for (size_t r = from; r < to; ++r) plcp[sa[r]] = r ? sa[r - 1] : EMPTY;
+    });
+    ParallelFor(0, n, threads, [&](size_t from, size_t to, int) {
+        size_t h = 0;
+        for (size_t p = from; p < to; ++p) {
+            if (plcp[p] == EMPTY) {
+                plcp[p] = 0;
+                h = 0;
+                continue;
+            }
+            size_t previous = plcp[p];
+            while (text[p + h] > 1 && text[p + h] == text[previous + h]) ++h;
+            plcp[p] = index_t(h);
+            if (h) --h;
+        }
+    });
+    return plcp;
+}
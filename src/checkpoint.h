@@ -0,0 +1,542 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "simplitigs.h"
+#include "parser.h"
+
+/// The stages of the computation of the global greedy after which a checkpoint is saved, in the order they are reached.
+enum CheckpointStage : uint32_t {
+    CHECKPOINT_NONE = 0,
+    // The collected k-mers.
+    CHECKPOINT_KMERS = 1,
+    // The simplitigs which are the nodes of the overlap phase.
+    CHECKPOINT_SIMPLITIGS = 2,
+    // The vector of k-mers which are the nodes of the overlap phase.
+    CHECKPOINT_KMER_VECTOR = 3,
+    // The state of the overlap phase after an overlap length.
+    CHECKPOINT_OVERLAP = 4,
+    // Not a checkpoint but the finished overlap path with its nodes saved for rendering.
+    CHECKPOINT_PATH = 5,
+};
+
+constexpr char CHECKPOINT_MAGIC[8] = {'K', 'M', 'C', 'C', 'K', 'P', 'T', '\0'};
+constexpr uint32_t CHECKPOINT_VERSION = 4;
+constexpr size_t CHECKPOINT_MAX_SECTIONS = 5;
+
+/// Header of a checkpoint file, which is followed by the sections, each padded to a multiple of 8 bytes.
+/// The sections are raw arrays, so the file can be mapped to memory and read in place.
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stage;
+    // Hash of the input and the parameters of the computation.
+    uint64_t fingerprint;
+    // Identifier of the run, so that the state of the overlap phase is used only with the nodes it was computed on.
+    uint64_t run;
+    // Number of the stored k-mers, simplitigs or nodes of the overlap phase.
+    uint64_t count;
+    // The next overlap length to be processed; -1 if the overlap phase is finished.
+    int64_t level;
+    uint32_t indexBytes;
+    uint32_t sectionCount;
+    // The parameters of the saved path, which does not depend on the input.
+    int32_t k;
+    uint8_t complements;
+    uint8_t kMerNodes;
+    uint8_t cycleCover;
+    // Size of an overlap length in the state of the overlap phase and in the path, which depends on k.
+    uint8_t overlapBytes;
+    uint64_t sectionBytes[CHECKPOINT_MAX_SECTIONS];
+};
+
+/// Return the header of a file of the given stage with the given sizes of the sections.
+inline CheckpointHeader NewCheckpointHeader(CheckpointStage stage, uint64_t fingerprint, uint64_t run, uint64_t count,
+                                            const std::vector<uint64_t> &sectionBytes) {
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.version = CHECKPOINT_VERSION;
+    header.stage = stage;
+    header.fingerprint = fingerprint;
+    header.run = run;
+    header.count = count;
+    header.level = -1;
+    header.sectionCount = sectionBytes.size();
+    for (size_t s = 0; s < sectionBytes.size(); ++s) header.sectionBytes[s] = sectionBytes[s];
+    return header;
+}
+
+/// Return the number of bytes of a section including the padding.
+inline uint64_t PaddedSectionBytes(uint64_t bytes) {
+    return (bytes + 7) / 8 * 8;
+}
+
+/// Write the data of a section followed by its padding; return whether it succeeded.
+inline bool WriteCheckpointSection(FILE *file, const void *data, uint64_t bytes) {
+    static const char padding[8] = {};
+    if (bytes && fwrite(data, 1, bytes, file) != bytes) return false;
+    uint64_t paddingBytes = PaddedSectionBytes(bytes) - bytes;
+    return !paddingBytes || fwrite(padding, 1, paddingBytes, file) == paddingBytes;
+}
+
+/// Write the checkpoint file with the given header, whose sections are written by writeSections.
+/// The file is first written under a temporary name and then renamed, so a checkpoint file is always complete.
+/// Return whether it succeeded.
+template <typename sections_writer_t>
+bool WriteCheckpointFile(const std::string &path, const CheckpointHeader &header, sections_writer_t writeSections) {
+    std::string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && writeSections(file);
+    ok = fflush(file) == 0 && ok;
+    ok = fsync(fileno(file)) == 0 && ok;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(temporary.c_str(), path.c_str()) == 0;
+    if (!ok) remove(temporary.c_str());
+    return ok;
+}
+
+/// A read-only checkpoint file mapped to memory.
+class MappedCheckpoint {
+public:
+    MappedCheckpoint() = default;
+    MappedCheckpoint(const MappedCheckpoint&) = delete;
+    MappedCheckpoint& operator=(const MappedCheckpoint&) = delete;
+    ~MappedCheckpoint() { Unmap(); }
+
+    /// Map the file and check that it is a complete checkpoint with the given fingerprint; return whether it is.
+    bool Map(const std::string &path, uint64_t fingerprint) {
+        Unmap();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat status;
+        if (fstat(fd, &status) == 0 && size_t(status.st_size) >= sizeof(CheckpointHeader)) {
+            size = status.st_size;
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : (const char *)mapped;
+        }
+        close(fd);
+        if (data == nullptr || !Valid(fingerprint)) {
+            Unmap();
+            return false;
+        }
+        return true;
+    }
+
+    bool Mapped() const { return data != nullptr; }
+    const CheckpointHeader &Header() const { return *(const CheckpointHeader *)data; }
+
+    /// Return the number of elements of type T in the given section.
+    template <typename T>
+    size_t SectionSize(size_t section) const {
+        return Header().sectionBytes[section] / sizeof(T);
+    }
+
+    /// Return the pointer to the given section interpreted as an array of T.
+    template <typename T>
+    const T *Section(size_t section) const {
+        uint64_t offset = sizeof(CheckpointHeader);
+        for (size_t s = 0; s < section; ++s) offset += PaddedSectionBytes(Header().sectionBytes[s]);
+        return (const T *)(data + offset);
+    }
+
+    /// Return a copy of the given section interpreted as an array of T.
+    template <typename T>
+    std::vector<T> LoadSection(size_t section) const {
+        return std::vector<T>(Section<T>(section), Section<T>(section) + SectionSize<T>(section));
+    }
+
+    void Unmap() {
+        if (data != nullptr) munmap((void *)data, size);
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+
+    bool Valid(uint64_t fingerprint) const {
+        const CheckpointHeader &header = Header();
+        if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) || header.version != CHECKPOINT_VERSION
+                || header.fingerprint != fingerprint || header.sectionCount > CHECKPOINT_MAX_SECTIONS) {
+            return false;
+        }
+        uint64_t expected = sizeof(CheckpointHeader);
+        for (size_t s = 0; s < header.sectionCount; ++s) expected += PaddedSectionBytes(header.sectionBytes[s]);
+        return expected == size;
+    }
+};
+
+/// Return the sizes of the two sections storing the simplitigs as their lengths and all their bits packed into 64-bit words.
+inline std::vector<uint64_t> SimplitigsSectionBytes(const std::vector<simplitig_t> &simplitigs) {
+    uint64_t bits = 0;
+    for (auto &simplitig : simplitigs) bits += simplitig.size();
+    return {simplitigs.size() * sizeof(uint64_t), (bits + 63) / 64 * sizeof(uint64_t)};
+}
+
+/// Write the two sections of the simplitigs as described by SimplitigsSectionBytes; return whether it succeeded.
+inline bool WriteSimplitigsSections(FILE *file, const std::vector<simplitig_t> &simplitigs) {
+    std::vector<uint64_t> words(simplitigs.size());
+    for (size_t i = 0; i < simplitigs.size(); ++i) words[i] = simplitigs[i].size();
+    if (!WriteCheckpointSection(file, words.data(), words.size() * sizeof(uint64_t))) return false;
+    words.clear();
+    words.reserve(1 << 16);
+    uint64_t word = 0, bit = 0;
+    for (auto &simplitig : simplitigs) for (bool b : simplitig) {
+        word |= uint64_t(b) << (bit++ % 64);
+        if (bit % 64 == 0) {
+            words.push_back(word);
+            word = 0;
+            if (words.size() == words.capacity()) {
+                if (fwrite(words.data(), sizeof(uint64_t), words.size(), file) != words.size()) return false;
+                words.clear();
+            }
+        }
+    }
+    if (bit % 64) words.push_back(word);
+    return WriteCheckpointSection(file, words.data(), words.size() * sizeof(uint64_t));
+}
+
+/// Return the simplitigs stored in the two sections of the file starting with the given one.
+inline std::vector<simplitig_t> LoadSimplitigsSections(const MappedCheckpoint &file, size_t section) {
+    const uint64_t *lengths = file.Section<uint64_t>(section);
+    const uint64_t *words = file.Section<uint64_t>(section + 1);
+    std::vector<simplitig_t> simplitigs(file.SectionSize<uint64_t>(section));
+    uint64_t bit = 0;
+    for (size_t i = 0; i < simplitigs.size(); ++i) {
+        simplitigs[i].resize(lengths[i]);
+        for (uint64_t j = 0; j < lengths[i]; ++j, ++bit) simplitigs[i][j] = (words[bit / 64] >> (bit % 64)) & 1;
+    }
+    return simplitigs;
+}
+
+/// The sections of a path file.
+enum PathFileSection : size_t {
+    PATH_EDGES = 0,
+    PATH_OVERLAPS = 1,
+    PATH_DATASET = 2,
+    // The nodes take one section if they are k-mers and two if they are simplitigs.
+    PATH_NODES = 3,
+};
+
+/// Save the overlap path, or the cycle cover, with its nodes to the given file; the nodes are written by writeNodes.
+/// Return whether it succeeded.
+template <typename length_t, typename nodes_writer_t>
+bool SavePathFile(const std::string &path, const std::string &dataset, int k, bool complements, bool cycleCover,
+                  const std::vector<size_t> &edgeFrom, const std::vector<length_t> &overlaps, bool kMerNodes,
+                  size_t nodeCount, std::vector<uint64_t> nodesBytes, nodes_writer_t writeNodes) {
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "the edges are saved as 64-bit integers");
+    std::vector<uint64_t> sectionBytes = {edgeFrom.size() * sizeof(size_t), overlaps.size() * sizeof(length_t), dataset.size()};
+    sectionBytes.insert(sectionBytes.end(), nodesBytes.begin(), nodesBytes.end());
+    CheckpointHeader header = NewCheckpointHeader(CHECKPOINT_PATH, 0, 0, nodeCount, sectionBytes);
+    header.k = k;
+    header.complements = complements;
+    header.kMerNodes = kMerNodes;
+    header.cycleCover = cycleCover;
+    header.overlapBytes = sizeof(length_t);
+    return WriteCheckpointFile(path, header, [&](FILE *file) {
+        return WriteCheckpointSection(file, edgeFrom.data(), sectionBytes[PATH_EDGES])
+            && WriteCheckpointSection(file, overlaps.data(), sectionBytes[PATH_OVERLAPS])
+            && WriteCheckpointSection(file, dataset.data(), sectionBytes[PATH_DATASET])
+            && writeNodes(file);
+    });
+}
+
+/// Save the overlap path on the simplitigs as described in SavePathFile.
+template <typename length_t>
+bool SavePathFile(const std::string &path, const std::string &dataset, int k, bool complements, bool cycleCover,
+                  const std::vector<size_t> &edgeFrom, const std::vector<length_t> &overlaps,
+                  const std::vector<simplitig_t> &simplitigs) {
+    return SavePathFile(path, dataset, k, complements, cycleCover, edgeFrom, overlaps, false, simplitigs.size(),
+                        SimplitigsSectionBytes(simplitigs), [&](FILE *file) { return WriteSimplitigsSections(file, simplitigs); });
+}
+
+/// Save the overlap path on the k-mers as described in SavePathFile.
+template <typename length_t, typename kmer_t>
+bool SavePathFile(const std::string &path, const std::string &dataset, int k, bool complements, bool cycleCover,
+                  const std::vector<size_t> &edgeFrom, const std::vector<length_t> &overlaps, const std::vector<kmer_t> &kMers) {
+    static_assert(std::is_trivially_copyable<kmer_t>::value, "k-mers are saved as raw bytes");
+    uint64_t bytes = kMers.size() * sizeof(kmer_t);
+    return SavePathFile(path, dataset, k, complements, cycleCover, edgeFrom, overlaps, true, kMers.size(),
+                        {bytes}, [&](FILE *file) { return WriteCheckpointSection(file, kMers.data(), bytes); });
+}
+
+/// Return the hash of the input file and the given parameters of the computation.
+/// The file is identified by its path, size and modification time.
+inline uint64_t CheckpointFingerprint(const std::string &path, const std::string &parameters) {
+    std::string identity = path + "\n" + parameters;
+    struct stat status;
+    if (stat(path.c_str(), &status) == 0) {
+        identity += "\n" + std::to_string(status.st_size) + "\n" + std::to_string(status.st_mtime);
+    }
+    // FNV-1a.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : identity) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/// Checkpoints of the global greedy saved to a directory, from which the computation can be resumed.
+///
+/// There is one file for the k-mers, one for the nodes of the overlap phase and one for the state of the overlap phase,
+/// each overwriting the previous checkpoint of the same kind.
+/// The files are written asynchronously by a background thread, so the computation only waits for the data to be copied.
+/// The state of the overlap phase is copied into a single buffer, so the checkpoints of the overlap phase
+/// which come while the previous one is still being written are skipped.
+class Checkpoint {
+public:
+    /// Use the given directory for the checkpoints of the computation identified by the fingerprint.
+    /// If resume is set, find the latest consistent checkpoint in it; otherwise, remove the existing checkpoints.
+    Checkpoint(const std::string &directory, uint64_t fingerprint, bool resume) : directory(directory), fingerprint(fingerprint) {
+        mkdir(directory.c_str(), 0777);
+        struct stat status;
+        if (stat(directory.c_str(), &status) != 0 || !S_ISDIR(status.st_mode)) {
+            throw std::runtime_error("cannot create the checkpoint directory '" + directory + "'");
+        }
+        std::random_device device;
+        run = (uint64_t(device()) << 32) ^ device() ^ (uint64_t)std::chrono::system_clock::now().time_since_epoch().count();
+        if (resume) {
+            if (nodes.Map(Path(CHECKPOINT_SIMPLITIGS), fingerprint) && (nodes.Header().stage == CHECKPOINT_SIMPLITIGS
+                    || nodes.Header().stage == CHECKPOINT_KMER_VECTOR)) {
+                stage = (CheckpointStage)nodes.Header().stage;
+                run = nodes.Header().run;
+                if (overlap.Map(Path(CHECKPOINT_OVERLAP), fingerprint) && overlap.Header().run == run) stage = CHECKPOINT_OVERLAP;
+                else overlap.Unmap();
+            } else if (kMers.Map(Path(CHECKPOINT_KMERS), fingerprint)) {
+                nodes.Unmap();
+                stage = CHECKPOINT_KMERS;
+                run = kMers.Header().run;
+            }
+            struct stat file;
+            for (CheckpointStage fileStage : {CHECKPOINT_KMERS, CHECKPOINT_SIMPLITIGS, CHECKPOINT_OVERLAP}) {
+                if (stage == CHECKPOINT_NONE && stat(Path(fileStage).c_str(), &file) == 0) {
+                    throw std::runtime_error("the checkpoints in '" + directory + "' do not match the input and the parameters");
+                }
+            }
+        }
+        // The later checkpoints which cannot be used would not correspond to the resumed computation.
+        if (stage < CHECKPOINT_OVERLAP) remove(Path(CHECKPOINT_OVERLAP).c_str());
+        if (stage < CHECKPOINT_SIMPLITIGS) remove(Path(CHECKPOINT_KMER_VECTOR).c_str());
+        if (stage < CHECKPOINT_KMERS) remove(Path(CHECKPOINT_KMERS).c_str());
+        worker = std::thread([this] { Work(); });
+    }
+
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    ~Checkpoint() {
+        Wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    /// Return the latest stage from which the computation can be resumed.
+    CheckpointStage ResumeStage() const { return stage; }
+
+    /// Return whether the nodes of the overlap phase in the checkpoint are k-mers rather than simplitigs.
+    bool NodesAreKMers() const {
+        return nodes.Mapped() && nodes.Header().stage == CHECKPOINT_KMER_VECTOR;
+    }
+
+    /// Return the overlap length at which the overlap phase is to be resumed with the given number of nodes, index size
+    /// and overlap length size, or k - 1 if there is no such checkpoint.
+    /// The state of the nodes is loaded to edgeFrom and state and the first and last nodes of the paths to first and last.
+    template <typename index_t, typename length_t>
+    int LoadOverlap(int k, size_t kMersCount, std::vector<index_t> &edgeFrom, std::vector<length_t> &state,
+                    std::vector<index_t> &first, std::vector<index_t> &last) {
+        if (!overlap.Mapped()) return k - 1;
+        const CheckpointHeader &header = overlap.Header();
+        if (header.count != kMersCount || header.indexBytes != sizeof(index_t) || header.overlapBytes != sizeof(length_t)
+                || header.sectionCount != 4
+                || overlap.SectionSize<index_t>(0) != kMersCount || overlap.SectionSize<length_t>(1) != kMersCount
+                || overlap.SectionSize<index_t>(2) != first.size() || overlap.SectionSize<index_t>(3) != last.size()) {
+            throw std::runtime_error("the checkpoint of the overlap phase does not match the nodes");
+        }
+        edgeFrom.assign(overlap.Section<index_t>(0), overlap.Section<index_t>(0) + kMersCount);
+        state.assign(overlap.Section<length_t>(1), overlap.Section<length_t>(1) + kMersCount);
+        first.assign(overlap.Section<index_t>(2), overlap.Section<index_t>(2) + first.size());
+        last.assign(overlap.Section<index_t>(3), overlap.Section<index_t>(3) + last.size());
+        int level = (int)header.level;
+        overlap.Unmap();
+        return level;
+    }
+
+    /// Return the k-mers from the checkpoint of the k-mers or of the vector of k-mers.
+    template <typename kmer_t>
+    std::vector<kmer_t> LoadKMers([[maybe_unused]] kmer_t kmerType) const {
+        const MappedCheckpoint &file = stage == CHECKPOINT_KMERS ? kMers : nodes;
+        return file.LoadSection<kmer_t>(0);
+    }
+
+    /// Return the simplitigs from the checkpoint of the nodes.
+    std::vector<simplitig_t> LoadSimplitigs() const {
+        return LoadSimplitigsSections(nodes, 0);
+    }
+
+    /// Save the collected k-mers.
+    template <typename kmer_t>
+    void SaveKMers(std::vector<kmer_t> &&kMerVec) {
+        static_assert(std::is_trivially_copyable<kmer_t>::value, "k-mers are saved as raw bytes");
+        auto saved = std::make_shared<std::vector<kmer_t>>(std::move(kMerVec));
+        Submit(CHECKPOINT_KMERS, [this, saved] {
+            CheckpointHeader header = Header(CHECKPOINT_KMERS, saved->size(), {saved->size() * sizeof(kmer_t)});
+            return WriteCheckpointFile(Path(CHECKPOINT_KMERS), header, [&](FILE *file) {
+                return WriteCheckpointSection(file, saved->data(), header.sectionBytes[0]);
+            });
+        });
+    }
+
+    /// Save the vector of k-mers which are the nodes of the overlap phase.
+    /// The k-mers are not copied, so they must not be modified until Wait is called.
+    template <typename kmer_t>
+    void SaveKMerVector(const std::vector<kmer_t> &kMerVec) {
+        static_assert(std::is_trivially_copyable<kmer_t>::value, "k-mers are saved as raw bytes");
+        Submit(CHECKPOINT_KMER_VECTOR, [this, &kMerVec] {
+            CheckpointHeader header = Header(CHECKPOINT_KMER_VECTOR, kMerVec.size(), {kMerVec.size() * sizeof(kmer_t)});
+            return WriteCheckpointFile(Path(CHECKPOINT_KMER_VECTOR), header, [&](FILE *file) {
+                return WriteCheckpointSection(file, kMerVec.data(), header.sectionBytes[0]);
+            });
+        });
+    }
+
+    /// Save the simplitigs which are the nodes of the overlap phase as described by SimplitigsSectionBytes.
+    /// The simplitigs are not copied, so they must not be modified until Wait is called.
+    void SaveSimplitigs(const std::vector<simplitig_t> &simplitigs) {
+        Submit(CHECKPOINT_SIMPLITIGS, [this, &simplitigs] {
+            CheckpointHeader header = Header(CHECKPOINT_SIMPLITIGS, simplitigs.size(), SimplitigsSectionBytes(simplitigs));
+            return WriteCheckpointFile(Path(CHECKPOINT_SIMPLITIGS), header, [&](FILE *file) {
+                return WriteSimplitigsSections(file, simplitigs);
+            });
+        });
+    }
+
+    /// Save the state of the overlap phase, which is to be resumed at the given overlap length, and return whether it is saved.
+    /// The state is copied into a buffer, which is reused by the next checkpoints, so the computation can continue right away.
+    /// While the previous state is still being written, the new one is skipped unless wait is set.
+    template <typename index_t, typename length_t>
+    bool SaveOverlap(int level, const std::vector<index_t> &edgeFrom, const std::vector<length_t> &state,
+                     const std::vector<index_t> &first, const std::vector<index_t> &last, bool wait = false) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (overlapWriting && !wait) return false;
+            changed.wait(lock, [this] { return !overlapWriting; });
+            overlapWriting = true;
+        }
+        std::vector<uint64_t> sectionBytes = {edgeFrom.size() * sizeof(index_t), state.size() * sizeof(length_t),
+                                              first.size() * sizeof(index_t), last.size() * sizeof(index_t)};
+        overlapSnapshot.resize(sectionBytes[0] + sectionBytes[1] + sectionBytes[2] + sectionBytes[3]);
+        char *position = overlapSnapshot.data();
+        auto copy = [&](const void *data, uint64_t bytes) {
+            if (bytes) memcpy(position, data, bytes);
+            position += bytes;
+        };
+        copy(edgeFrom.data(), sectionBytes[0]);
+        copy(state.data(), sectionBytes[1]);
+        copy(first.data(), sectionBytes[2]);
+        copy(last.data(), sectionBytes[3]);
+        Submit(CHECKPOINT_OVERLAP, [this, sectionBytes, level, count = edgeFrom.size()] {
+            CheckpointHeader header = Header(CHECKPOINT_OVERLAP, count, sectionBytes);
+            header.level = level;
+            header.indexBytes = sizeof(index_t);
+            header.overlapBytes = sizeof(length_t);
+            bool written = WriteCheckpointFile(Path(CHECKPOINT_OVERLAP), header, [&](FILE *file) {
+                const char *section = overlapSnapshot.data();
+                for (uint64_t bytes : sectionBytes) {
+                    if (!WriteCheckpointSection(file, section, bytes)) return false;
+                    section += bytes;
+                }
+                return true;
+            });
+            std::lock_guard<std::mutex> lock(mutex);
+            overlapWriting = false;
+            return written;
+        });
+        return true;
+    }
+
+    /// Wait until all the submitted checkpoints are written.
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return jobs.empty() && !busy; });
+    }
+
+private:
+    std::string directory;
+    uint64_t fingerprint;
+    uint64_t run;
+    CheckpointStage stage = CHECKPOINT_NONE;
+    MappedCheckpoint kMers, nodes, overlap;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::pair<CheckpointStage, std::function<bool()>>> jobs;
+    bool busy = false;
+    // Copy of the state of the overlap phase which is being written and whether it is.
+    std::vector<char> overlapSnapshot;
+    bool overlapWriting = false;
+    bool stopping = false;
+
+    /// Return the path of the file of the checkpoints of the given stage; both kinds of nodes share one.
+    std::string Path(CheckpointStage fileStage) const {
+        if (fileStage == CHECKPOINT_KMERS) return directory + "/kmers.ckpt";
+        if (fileStage == CHECKPOINT_OVERLAP) return directory + "/overlap.ckpt";
+        return directory + "/nodes.ckpt";
+    }
+
+    CheckpointHeader Header(CheckpointStage fileStage, uint64_t count, const std::vector<uint64_t> &sectionBytes) const {
+        return NewCheckpointHeader(fileStage, fingerprint, run, count, sectionBytes);
+    }
+
+    void Submit(CheckpointStage jobStage, std::function<bool()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace_back(jobStage, std::move(job));
+        }
+        changed.notify_all();
+    }
+
+    void Work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            auto [jobStage, job] = std::move(jobs.front());
+            jobs.pop_front();
+            busy = true;
+            lock.unlock();
+            if (!job()) WriteLog("Warning: failed to write the checkpoint '" + Path(jobStage) + "'.");
+            lock.lock();
+            busy = false;
+            changed.notify_all();
+        }
+    }
+};
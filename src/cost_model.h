@@ -0,0 +1,192 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "khash.h"
+#include "parser.h"
+#include "simplitigs.h"
+#include "memory_plan.h"
+#include "global.h"
+
+/// The ways in which the greedy computes the masked superstring once the k-mers are collected.
+enum Engine {
+    // Decide by the cost model.
+    ENGINE_AUTO,
+    // Compute the simplitigs and run the overlap phase on them.
+    ENGINE_SIMPLITIG,
+    // Run the overlap phase directly on the sorted k-mers.
+    ENGINE_SPARSE,
+    // Read the input once more and compute the superstring by the streaming algorithm.
+    ENGINE_STREAMING,
+};
+
+/// The number of k-mers from which the lengths of the simplitigs are sampled.
+constexpr size_t ENGINE_SAMPLE_SIZE = 10000;
+
+/// Predicted costs in nanoseconds of the single-threaded greedy after the k-mers are collected, fitted on bacterial genomes and random k-mers.
+/// Cost per k-mer of computing the simplitigs.
+constexpr double SIMPLITIG_BUILD_COST = 250;
+/// Cost per simplitig, direction and overlap length of the overlap phase on simplitigs.
+constexpr double SIMPLITIG_NODE_COST = 400;
+/// Cost per k-mer of extracting and sorting the k-mers and of the overlap length k-1, which joins them into simplitigs.
+constexpr double KMER_NODE_COST = 1300;
+/// Cost per simplitig, direction and overlap length of the remaining overlap lengths on k-mers,
+/// in which only the k-mers at the ends of the simplitigs are still free.
+constexpr double KMER_END_COST = 250;
+
+/// Parse the engine given by --engine.
+Engine ParseEngine(const std::string &name) {
+    if (name == "auto") return ENGINE_AUTO;
+    if (name == "simplitig") return ENGINE_SIMPLITIG;
+    if (name == "sparse") return ENGINE_SPARSE;
+    throw std::invalid_argument("unknown engine '" + name + "'");
+}
+
+/// Return the name of the engine for logging.
+std::string EngineName(Engine engine) {
+    switch (engine) {
+        case ENGINE_SIMPLITIG: return "simplitig";
+        case ENGINE_SPARSE: return "sparse";
+        case ENGINE_STREAMING: return "streaming";
+        default: return "auto";
+    }
+}
+
+/// Return the number of k-mers in kMers which extend the given (k-1)-mer by a nucleotide to the right (or to the left).
+template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+int CountExtensions(kh_S_t *kMers, kh_wrapper_t wrapper, kmer_t overlap, int k, bool complements, bool right) {
+    int count = 0;
+    for (kmer_t ext = 0; ext < kmer_t(4); ++ext) {
+        kmer_t kMer = right ? ((overlap << 2) | ext) : ((ext << ((k - 1) << 1)) | overlap);
+        if (complements) kMer = std::min(kMer, ReverseComplement(kMer, k));
+        if (wrapper.kh_get_from_set(kMers, kMer) != kh_end(kMers)) ++count;
+    }
+    return count;
+}
+
+/// Estimate the number of simplitigs of the k-mer set from the neighbourhoods of a sample of its k-mers.
+/// The k-mers ending by a (k-1)-mer can be followed by any of the k-mers starting by it, so when the simplitigs are extended greedily,
+/// either all the former or all the latter are matched. A k-mer ending by a (k-1)-mer shared by a k-mers and starting b of them
+/// therefore ends a simplitig with probability max(0, 1 - b/a), and the same holds for the starts. The number of simplitigs
+/// is estimated as the number of k-mers times the mean of these probabilities over both sides of the sampled k-mers.
+/// Unlike walking along the simplitigs, this does not depend on their length; only cycles without any end are not counted.
+template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+double EstimateSimplitigCount(kh_S_t *kMers, kh_wrapper_t wrapper, [[maybe_unused]] kmer_t _, int k, bool complements,
+                              size_t sampleSize = ENGINE_SAMPLE_SIZE) {
+    size_t n = kh_size(kMers);
+    if (!n) return 0;
+    kmer_t overlapMask = (kmer_t(1) << ((k - 1) << 1)) - kmer_t(1);
+    auto endProbability = [&](kmer_t overlap, bool right) {
+        double matching = CountExtensions(kMers, wrapper, overlap, k, complements, right);
+        double sharing = CountExtensions(kMers, wrapper, overlap, k, complements, !right);
+        return std::max(0.0, 1.0 - matching / sharing);
+    };
+    // Take the first k-mer in each of the evenly spaced ranges of buckets so that the sample is deterministic.
+    size_t stride = std::max(size_t(1), size_t(kh_end(kMers)) / sampleSize);
+    double ends = 0;
+    size_t sampled = 0;
+    for (size_t start = kh_begin(kMers); start < kh_end(kMers); start += stride) {
+        size_t i = start;
+        while (i < std::min(start + stride, size_t(kh_end(kMers))) && !kh_exist(kMers, i)) ++i;
+        if (i == std::min(start + stride, size_t(kh_end(kMers)))) continue;
+        kmer_t kMer = kh_key(kMers, i);
+        ends += (endProbability(kMer & overlapMask, true) + endProbability(kMer >> 2, false)) / 2;
+        ++sampled;
+    }
+    return std::max(1.0, n * ends / sampled);
+}
+
+/// Predicted time and peak memory of the greedy engines.
+struct EnginePrediction {
+    // Number of the collected k-mers.
+    size_t kMers = 0;
+    // Estimated number of simplitigs.
+    double simplitigs = 0;
+    // Predicted time in seconds.
+    double simplitigSeconds = 0;
+    double sparseSeconds = 0;
+    // Predicted peak memory in bytes.
+    size_t simplitigBytes = 0;
+    size_t sparseBytes = 0;
+    size_t streamingBytes = 0;
+};
+
+/// Return the smallest memory of the overlap phase on the given nodes, i.e., with the largest number of batches.
+template <typename kmer_t>
+size_t MinimumOverlapBytes(kmer_t _, size_t nodeBytes, size_t kMerCount, size_t n, bool complements) {
+    size_t kMersCount = n * (1 + complements);
+    auto plan = PlanOverlapMemory(_, 0, nodeBytes, kMerCount, kMersCount, n, SUFFIX_QUERY_BLOCK_SIZE,
+                                  OverlapIndexBytes(kMersCount));
+    return OverlapMemoryWithBatches(_, plan, kMersCount, kMersCount, std::min(MAX_BATCH_COUNT, std::max(kMersCount, size_t(1))));
+}
+
+/// Predict the time and memory of the greedy engines for the given number of k-mers and estimated number of simplitigs.
+template <typename kmer_t>
+EnginePrediction PredictEngines(kmer_t _, size_t kMerCount, double simplitigs, int k, bool complements) {
+    EnginePrediction prediction;
+    prediction.kMers = kMerCount;
+    prediction.simplitigs = simplitigs;
+    double n = kMerCount, directions = 1 + complements;
+    prediction.simplitigSeconds = (n * SIMPLITIG_BUILD_COST + simplitigs * directions * k * SIMPLITIG_NODE_COST) * 1e-9;
+    prediction.sparseSeconds = (n * KMER_NODE_COST + simplitigs * directions * k * KMER_END_COST) * 1e-9;
+
+    size_t setBytes = KMerSetBytes(_, kMerCount);
+    size_t simplitigCount = size_t(simplitigs);
+    // Each simplitig has k - 1 nucleotides in addition to its k-mers.
+    size_t simplitigBytes = simplitigCount * sizeof(simplitig_t) + (kMerCount + simplitigCount * (k - 1)) / 4;
+    prediction.simplitigBytes = std::max(setBytes + simplitigBytes,
+                                         MinimumOverlapBytes(_, simplitigBytes, kMerCount, simplitigCount, complements));
+    size_t kMerVecBytes = kMerCount * sizeof(kmer_t);
+    prediction.sparseBytes = std::max(setBytes + kMerVecBytes,
+                                      MinimumOverlapBytes(_, kMerVecBytes, kMerCount, kMerCount, complements));
+    prediction.streamingBytes = setBytes;
+    return prediction;
+}
+
+/// Choose the cheaper greedy engine which fits into the memory budget (0 if unlimited).
+/// Both run the same greedy algorithm and differ only in how the ties are broken.
+/// If neither fits and the streaming algorithm, which gives a different superstring, is explicitly allowed and fits, choose it instead.
+Engine DecideEngine(const EnginePrediction &prediction, size_t budget, bool streamingAllowed) {
+    Engine cheaper = prediction.sparseSeconds < prediction.simplitigSeconds ? ENGINE_SPARSE : ENGINE_SIMPLITIG;
+    if (!budget) return cheaper;
+    Engine other = cheaper == ENGINE_SPARSE ? ENGINE_SIMPLITIG : ENGINE_SPARSE;
+    auto bytes = [&](Engine engine) {
+        return engine == ENGINE_SPARSE ? prediction.sparseBytes : prediction.simplitigBytes;
+    };
+    if (bytes(cheaper) <= budget) return cheaper;
+    if (bytes(other) <= budget) return other;
+    if (streamingAllowed && prediction.streamingBytes <= budget) return ENGINE_STREAMING;
+    return bytes(cheaper) <= bytes(other) ? cheaper : other;
+}
+
+/// Log the prediction and the chosen engine so that the cost model can be tuned afterwards.
+void WriteEngineDecision(const EnginePrediction &prediction, Engine engine, bool forced) {
+    WriteLog("Cost model: " + std::to_string(prediction.kMers) + " k-mers, about "
+             + std::to_string(size_t(prediction.simplitigs)) + " simplitigs; predicted simplitig "
+             + std::to_string(prediction.simplitigSeconds) + " s and " + FormatMemorySize(prediction.simplitigBytes)
+             + ", sparse " + std::to_string(prediction.sparseSeconds) + " s and " + FormatMemorySize(prediction.sparseBytes)
+             + ", streaming " + FormatMemorySize(prediction.streamingBytes) + ".");
+    WriteLog("Engine: " + EngineName(engine) + (forced ? " (given by --engine)." : " (chosen by the cost model)."));
+}
+
+/// Decide how the greedy proceeds with the collected k-mers and log the decision.
+/// Unless the engine is given, the number of simplitigs is estimated from a sample and the engine is chosen by the cost model.
+template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+Engine ChooseEngine(kh_S_t *kMers, kh_wrapper_t wrapper, kmer_t _, int k, bool complements, Engine engine,
+                    size_t budget, bool streamingAllowed) {
+    double simplitigs = EstimateSimplitigCount(kMers, wrapper, _, k, complements);
+    auto prediction = PredictEngines(_, kh_size(kMers), simplitigs, k, complements);
+    bool forced = engine != ENGINE_AUTO;
+    if (!forced) engine = DecideEngine(prediction, budget, streamingAllowed);
+    WriteEngineDecision(prediction, engine, forced);
+    if (engine == ENGINE_STREAMING) {
+        WriteLog("Warning: neither greedy engine fits the memory budget, falling back to the streaming algorithm as allowed by --allow-streaming.");
+    } else if (budget && (engine == ENGINE_SPARSE ? prediction.sparseBytes : prediction.simplitigBytes) > budget) {
+        WriteLog("Warning: the " + EngineName(engine) + " engine is predicted to exceed the memory budget.");
+    }
+    return engine;
+}
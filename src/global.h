@@ -6,11 +6,17 @@
 #include <list>
 #include <algorithm>
 #include <cstdint>
+#include <numeric>
+#include <chrono>
 
 #include "kmers.h"
 #include "khash.h"
 #include "khash_utils.h"
 #include "simplitigs.h"
+#include "parallel.h"
+#include "memory_plan.h"
+#include "radix_sort.h"
+#include "checkpoint.h"
 
 /// Provide possibility to access reverse complements as if they were in the field.
 #define accessPrefix(field, index) (((field).size() > (index)) ? simplitig_first(kmer_t(0), (field)[(index)], k) : \
@@ -29,183 +35,666 @@
         (((b)[(index) - (n)]) + (n)) % (2*(n)))
 
 
-/// Determines which fraction of k-mers store its prefixes at one time.
+/// Determines which fraction of k-mers store its prefixes at one time if no memory budget is given.
 constexpr int MEMORY_REDUCTION_FACTOR = 16;
 
-typedef std::pair<std::vector<size_t>, std::vector<unsigned char>> overlapPath;
+/// Determines how many suffixes are looked up in parallel before the found edges are committed.
+constexpr size_t SUFFIX_QUERY_BLOCK_SIZE = 1 << 20;
 
+/// The lists of active nodes are compacted once fewer than 1/ACTIVE_COMPACTION_FACTOR of the listed nodes are available.
+constexpr size_t ACTIVE_COMPACTION_FACTOR = 2;
 
-/// Greedily find the approximate Hamiltonian path with longest overlaps.
-/// Simplitigs are expected to be maximal and to contain only one out of canonical k-mer pair.
-/// If complements are provided, treat k-mer and its complement as identical.
-/// Moreover, if so, the resulting Hamiltonian path contains two superstrings which are reverse complements of one another.
+/// The successor of each node and the length of the overlap with it, which is -1 if there is none.
+template <typename kmer_t>
+using overlapPath = std::pair<std::vector<size_t>, std::vector<overlap_t<kmer_t>>>;
+
+/// Parameters of the computation of the overlap path of the global greedy.
+struct OverlapOptions {
+    // Number of threads to be used.
+    int threads = 1;
+    // Memory budget in bytes to which the batching is adapted; 0 for the default batching.
+    size_t maxMemory = 0;
+    // Find the overlaps by sorting and merging the prefixes and suffixes instead of the batched prefix map.
+    // The sorted prefixes and suffixes of all the free nodes are kept at once regardless of the memory budget.
+    bool sortMerge = false;
+    // Find the overlaps of greedy-ac by a suffix array of the k-mers instead of the automaton.
+    bool suffixArray = false;
+    // Precompute the first and last k-mers of the nodes if the memory budget allows it.
+    bool endpointCache = true;
+    // After this time, all overlap lengths but 0 are skipped, so that the remaining paths are only joined.
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // If set, the state after each overlap length is saved to it and the computation is resumed from it.
+    Checkpoint *checkpoint = nullptr;
+    // If not empty, the finished overlap path is saved with its nodes to this file for the render subcommand.
+    std::string savePath;
+    // Name of the input which is saved with the overlap path.
+    std::string dataset;
+};
+
+
+/// Return whether the indices of the given number of nodes and the sentinel fit into 32 bits.
+inline bool FitsCompactIndex(size_t kMersCount) {
+    return kMersCount < size_t(UINT32_MAX);
+}
+
+/// Return the size of a node index stored in the overlap phase with the given number of nodes.
+inline size_t OverlapIndexBytes(size_t kMersCount) {
+    return FitsCompactIndex(kMersCount) ? sizeof(uint32_t) : sizeof(size_t);
+}
+
+/// State of the nodes in the overlap phase with the node indices stored as index_t and the overlap lengths as length_t.
+/// The suffix of a node is forbidden iff the node has an outgoing edge and the flag whether its prefix is forbidden
+/// is packed together with the overlap length into its highest bit.
+template <typename index_t, typename length_t>
+struct OverlapNodes {
+    static constexpr index_t NONE = index_t(-1);
+    static constexpr length_t PREFIX_FORBIDDEN = length_t(1) << (8 * sizeof(length_t) - 1);
+    static constexpr length_t NO_OVERLAP = PREFIX_FORBIDDEN - 1;
+
+    std::vector<index_t> edgeFrom;
+    std::vector<length_t> state;
+
+    explicit OverlapNodes(size_t count) : edgeFrom(count, NONE), state(count, NO_OVERLAP) {}
+
+    bool PrefixForbidden(size_t i) const { return state[i] & PREFIX_FORBIDDEN; }
+    bool SuffixForbidden(size_t i) const { return edgeFrom[i] != NONE; }
+
+    /// Add the edge from x to y with the overlap d < NO_OVERLAP.
+    void AddEdge(size_t x, size_t y, int d) {
+        edgeFrom[x] = y;
+        state[x] = (state[x] & PREFIX_FORBIDDEN) | (length_t)d;
+        state[y] |= PREFIX_FORBIDDEN;
+    }
+
+    /// Convert the state to the overlap path with full-width indices and release the memory.
+    std::pair<std::vector<size_t>, std::vector<length_t>> ToOverlapPath() {
+        size_t count = edgeFrom.size();
+        std::vector<length_t> overlaps(count);
+        for (size_t i = 0; i < count; ++i) {
+            length_t overlap = state[i] & NO_OVERLAP;
+            overlaps[i] = overlap == NO_OVERLAP ? (length_t)-1 : overlap;
+        }
+        std::vector<length_t>().swap(state);
+        std::vector<size_t> fullEdgeFrom(count);
+        for (size_t i = 0; i < count; ++i) fullEdgeFrom[i] = edgeFrom[i] == NONE ? size_t(-1) : size_t(edgeFrom[i]);
+        std::vector<index_t>().swap(edgeFrom);
+        return {fullEdgeFrom, overlaps};
+    }
+};
+
+/// Return the number of nodes in the sorted list of active nodes which are not forbidden.
+/// If they make up only a small part of the list, remove the forbidden ones from it.
+template <typename index_t, typename forbidden_t>
+size_t CompactActiveNodes(std::vector<index_t> &active, forbidden_t forbidden) {
+    size_t available = 0;
+    for (index_t i : active) available += !forbidden(i);
+    if (available * ACTIVE_COMPACTION_FACTOR < active.size()) {
+        active.erase(std::remove_if(active.begin(), active.end(), forbidden), active.end());
+        active.shrink_to_fit();
+    }
+    return available;
+}
+
+/// Return the thread whose part of the prefix map stores the given prefix.
+template <typename kmer_t>
+inline int PrefixMapOwner(kmer_t prefix, int threads) {
+    return (int)(((((uint64_t)prefix) * 0x9E3779B97F4A7C15ULL) >> 32) % (uint64_t)threads);
+}
+
+/// Save the overlap path, or the cycle cover, with its nodes to the file given by the options, if there is one.
+template <typename length_t, typename nodes_t>
+void SaveOverlapPath(const OverlapOptions &options, const std::pair<std::vector<size_t>, std::vector<length_t>> &path, const nodes_t &nodes, int k, bool complements,
+                     bool cycleCover) {
+    if (options.savePath.empty()) return;
+    std::string name = cycleCover ? "cycle cover" : "Hamiltonian path";
+    if (SavePathFile(options.savePath, options.dataset, k, complements, cycleCover, path.first, path.second, nodes)) {
+        WriteLog("Saved the " + name + " to '" + options.savePath + "'.");
+    } else {
+        WriteLog("Warning: failed to save the " + name + " to '" + options.savePath + "'.");
+    }
+}
+
+/// Greedily find the approximate Hamiltonian path with longest overlaps on n nodes and, if complements are provided, their reverse complements.
+/// The i-th node has the first k-mer getPrefix(i) and the last k-mer getSuffix(i); for i >= n, it is the reverse complement of the (i-n)-th node.
+/// For each overlap length, the nodes with a matching prefix are found either in a batched prefix map or by sorting and merging
+/// the prefixes and suffixes. Either is done in parallel, but the found edges are committed in the index order,
+/// so the result does not depend on the number of threads. The sort-merge engine commits the edges batch by batch
+/// as the prefix map engine with the same batching would, so both engines give the same result.
+/// Each overlap length considers only the nodes in the lists of nodes with an available prefix or suffix.
+/// The nodes are indexed by index_t, which has to fit 2n and the sentinel.
+/// If the deadline in options passes, the remaining overlap lengths except 0 are skipped.
+/// If a checkpoint is given, the state is saved after each overlap length which was not cut short by the time limit,
+/// unless the previous state is still being written, and the computation is resumed from the saved state if there is one.
 /// If lower_bound is set to true, return a shortest cycle cover instead.
-template <typename kmer_t, typename kh_wrapper_t>
-overlapPath OverlapHamiltonianPath (kh_wrapper_t wrapper, kmer_t kmerType, std::vector<simplitig_t> &simplitigs, int k, bool complements,
-                                    bool lower_bound = false) {
-    size_t n = simplitigs.size();
+template <typename index_t, typename kmer_t, typename kh_wrapper_t, typename prefix_getter_t, typename suffix_getter_t>
+overlapPath<kmer_t> OverlapHamiltonianPathIndexed (kh_wrapper_t wrapper, kmer_t kmerType, size_t n,
+                                                   prefix_getter_t getPrefix, suffix_getter_t getSuffix, int k, bool complements,
+                                                   bool lower_bound, const OverlapOptions &options, const MemoryPlan &plan) {
+    constexpr index_t NONE = OverlapNodes<index_t, overlap_t<kmer_t>>::NONE;
+    int threads = std::max(options.threads, 1);
+    bool sortMerge = options.sortMerge;
     size_t kMersCount = n * (1 + complements);
-    size_t batchSize = kMersCount / MEMORY_REDUCTION_FACTOR + 1;
-    std::vector<size_t> edgeFrom(kMersCount, -1);
-    std::vector<unsigned char> overlaps(kMersCount, -1);
-    std::vector<bool> suffixForbidden(kMersCount, false);
-    std::vector<bool> prefixForbidden(kMersCount, false);
+    // Without a memory budget, always split the prefixes into the same number of batches.
+    size_t batchCount = MEMORY_REDUCTION_FACTOR;
+    if (plan.budget) {
+        WriteMemoryPlan(plan);
+        if (sortMerge) WriteLog("The sorted prefixes and suffixes of the sort-merge engine are not bounded by the memory budget.");
+        batchCount = PlanBatchCount(kmerType, plan, kMersCount, kMersCount);
+    }
+    size_t batchSize = kMersCount / batchCount + 1;
+    OverlapNodes<index_t, overlap_t<kmer_t>> nodes(kMersCount);
+    auto prefixForbidden = [&](index_t i) { return nodes.PrefixForbidden(i); };
+    auto suffixForbidden = [&](index_t i) { return nodes.SuffixForbidden(i); };
+    // Sorted indices of the nodes whose prefix, resp. suffix, may still be available.
+    std::vector<index_t> activePrefixes(kMersCount), activeSuffixes(kMersCount);
+    std::iota(activePrefixes.begin(), activePrefixes.end(), 0);
+    std::iota(activeSuffixes.begin(), activeSuffixes.end(), 0);
     // For reverse complements, compute first from last and vice versa.
-    auto first = new size_t[n];
-    auto last = new size_t[n];
-    // Index next relative to the batch.
-    auto next = new size_t[batchSize];
-    for (size_t i = 0; i < n; ++i) {
-        first[i] = last[i] = i;
-    }
-    auto *prefixes = wrapper.kh_init_map();
-    wrapper.kh_resize_map(prefixes, (kMersCount / MEMORY_REDUCTION_FACTOR + 1 ) * 100 / 77 );
-    for (int d = k - 1; d >= 0; --d) {
+    std::vector<index_t> first(n), last(n);
+    // Position of the next k-mer with the same prefix, i.e., index relative to the batch or position in the sorted prefixes.
+    std::vector<index_t> next(sortMerge ? 0 : batchSize);
+    // Prefixes of the current batch so that they are computed only once even if the map is partitioned.
+    std::vector<kmer_t> batchPrefixes(sortMerge ? 0 : batchSize);
+    // Positions of the available prefixes of the current batch grouped by the thread owning them and the number of them
+    // found by each chunk for each owner, so that each thread goes only over its own prefixes.
+    bool partitioned = !sortMerge && threads > 1;
+    std::vector<index_t> batchOrder(partitioned ? batchSize : 0);
+    std::vector<size_t> ownerCounts(partitioned ? threads * threads : 0), ownerBegins(partitioned ? threads + 1 : 0);
+    // Position of the first k-mer whose prefix matches the suffix of the given k-mer in the current query block.
+    std::vector<index_t> candidates(std::min(kMersCount, SUFFIX_QUERY_BLOCK_SIZE));
+    // Prefixes and suffixes of the available k-mers together with their indices for the sort-merge engine.
+    std::vector<std::pair<kmer_t, index_t>> sortedPrefixes, sortedSuffixes;
+    // Position of the first sorted prefix of the sort-merge engine which matches the suffix of the given k-mer
+    // and is not in the batches matched so far.
+    std::vector<index_t> cursors(sortMerge ? kMersCount : 0);
+    std::iota(first.begin(), first.end(), 0);
+    std::iota(last.begin(), last.end(), 0);
+    // The cycle cover of the lower bound is not checkpointed.
+    Checkpoint *checkpoint = lower_bound ? nullptr : options.checkpoint;
+    int startLevel = k - 1;
+    if (checkpoint != nullptr) {
+        startLevel = checkpoint->LoadOverlap(k, kMersCount, nodes.edgeFrom, nodes.state, first, last);
+        if (startLevel < k - 1) WriteLog("Resumed the overlap phase at overlap length " + std::to_string(startLevel) + ".");
+    }
+    // Each thread inserts to and owns only the prefixes assigned to it by PrefixMapOwner.
+    std::vector<decltype(wrapper.kh_init_map())> prefixes(sortMerge ? 0 : threads);
+    for (auto &map : prefixes) {
+        map = wrapper.kh_init_map();
+        wrapper.kh_resize_map(map, (batchSize / threads + 1) * 100 / 77);
+    }
+
+    // Add the edge from i to the first available k-mer in the list starting at the position head.
+    // The positions in the list are linked by next and kMerAt maps them to the indices of the k-mers.
+    auto addEdgeFromList = [&](size_t i, index_t head, auto kMerAt, int d) {
+        index_t previous, position;
+        previous = position = head;
+        while (position != NONE && \
+                // k-mers are complementary
+               ((!lower_bound && (i + n) % (2 * n) == kMerAt(position)) \
+               // forms a cycle
+               || (!lower_bound && accessFirstLast(first, last, i, n) == kMerAt(position)) \
+               // k-mer is already used
+               || prefixForbidden(kMerAt(position)))) {
+            index_t new_position = next[position];
+            // If the k-mer is forbidden, remove it to keep the complexity linear.
+            // This is not done with the first k-mer but that is not a problem.
+            if (prefixForbidden(kMerAt(position))) next[previous] = new_position;
+            else previous = position;
+            position = new_position;
+        }
+        if (position == NONE) {
+            return;
+        }
+        size_t j = kMerAt(position);
+        std::vector<std::pair<size_t, size_t>> new_edges({{i, j}});
+        // Add also the edge between complementary k-mers in the opposite direction.
+        if (complements) new_edges.emplace_back((j + n) % kMersCount, (i + n) % kMersCount);
+        for (auto [x, y]: new_edges) {
+            nodes.AddEdge(x, y, d);
+            auto lastY =  accessFirstLast(last, first, y, n);
+            auto firstX = accessFirstLast(first, last, x, n);
+            if (lastY < n) first[lastY] = firstX;
+            if (firstX < n) last[firstX] = lastY;
+        }
+        next[previous] = next[position];
+    };
+
+    bool outOfTime = false;
+    // Return whether the time limit has been exceeded and log it for the first time.
+    auto checkTimeLimit = [&](int d) {
+        if (!outOfTime && std::chrono::steady_clock::now() >= options.deadline) {
+            outOfTime = true;
+            WriteLog("Time limit exceeded at overlap length " + std::to_string(d) + ", the remaining paths are joined with overlap 0.");
+        }
+        return outOfTime;
+    };
+
+    for (int d = startLevel; d >= 0; --d) {
+        // Once out of time, skip to the overlap length 0, which joins the remaining paths.
+        if (d > 0 && checkTimeLimit(d)) d = 0;
+        if (checkpoint != nullptr && d != startLevel && !outOfTime) {
+            checkpoint->SaveOverlap(d, nodes.edgeFrom, nodes.state, first, last);
+        }
+        size_t freePrefixes = CompactActiveNodes(activePrefixes, prefixForbidden);
+        size_t freeSuffixes = CompactActiveNodes(activeSuffixes, suffixForbidden);
+        WriteLog("Overlap length " + std::to_string(d) + ": " + std::to_string(freePrefixes) + " free prefixes and "
+                 + std::to_string(freeSuffixes) + " free suffixes.");
+        if (!freePrefixes || !freeSuffixes) break;
+        if (plan.budget) {
+            // With fewer prefixes left, more of them fit into one batch.
+            size_t newBatchCount = PlanBatchCount(kmerType, plan, kMersCount, freePrefixes);
+            if (!sortMerge && (newBatchCount != batchCount || d == startLevel)) {
+                WriteLog("Overlap length " + std::to_string(d) + ": " + std::to_string(freePrefixes) + " prefixes in "
+                         + std::to_string(newBatchCount) + " batches (estimated "
+                         + FormatMemorySize(OverlapMemoryWithBatches(kmerType, plan, kMersCount, freePrefixes, newBatchCount)) + ").");
+            }
+            if (newBatchCount != batchCount) {
+                batchCount = newBatchCount;
+                batchSize = kMersCount / batchCount + 1;
+                if (!sortMerge) {
+                    // Release the old arrays first so that they do not coexist with the new ones.
+                    std::vector<index_t>().swap(next);
+                    std::vector<kmer_t>().swap(batchPrefixes);
+                    std::vector<index_t>().swap(batchOrder);
+                    next.resize(batchSize);
+                    batchPrefixes.resize(batchSize);
+                    if (partitioned) batchOrder.resize(batchSize);
+                }
+            }
+        }
+        if (sortMerge) {
+            // Sort the prefixes and suffixes of the available k-mers and match them by a linear merge.
+            sortedPrefixes.clear();
+            sortedSuffixes.clear();
+            for (index_t i : activePrefixes) if (!prefixForbidden(i)) sortedPrefixes.emplace_back(kmer_t(0), i);
+            for (index_t i : activeSuffixes) if (!suffixForbidden(i)) sortedSuffixes.emplace_back(kmer_t(0), i);
+            ParallelFor(0, sortedPrefixes.size(), threads, [&](size_t from, size_t to, int) {
+                for (size_t p = from; p < to; ++p) sortedPrefixes[p].first = BitPrefix(getPrefix(sortedPrefixes[p].second), k, d);
+            });
+            ParallelFor(0, sortedSuffixes.size(), threads, [&](size_t from, size_t to, int) {
+                for (size_t p = from; p < to; ++p) sortedSuffixes[p].first = BitSuffix(getSuffix(sortedSuffixes[p].second), d);
+            });
+            // The sort is stable, so the k-mers with the same prefix remain ordered by their index.
+            RadixSortPairs(sortedPrefixes, 2 * d, threads);
+            RadixSortPairs(sortedSuffixes, 2 * d, threads);
+            size_t prefixCount = sortedPrefixes.size();
+            next.resize(prefixCount);
+            // Link the k-mers with the same prefix in the same batch from the largest index, as they would be in the prefix map.
+            ParallelFor(0, prefixCount, threads, [&](size_t from, size_t to, int) {
+                for (size_t p = from; p < to; ++p) {
+                    next[p] = (p > 0 && sortedPrefixes[p - 1].first == sortedPrefixes[p].first
+                               && sortedPrefixes[p - 1].second / batchSize == sortedPrefixes[p].second / batchSize) ? index_t(p - 1) : NONE;
+                }
+            });
+            ParallelFor(0, sortedSuffixes.size(), threads, [&](size_t from, size_t to, int) {
+                auto byKey = [](const std::pair<kmer_t, index_t> &a, const std::pair<kmer_t, index_t> &b) { return a.first < b.first; };
+                // The first prefix which is not smaller than the current suffix.
+                size_t lower = std::lower_bound(sortedPrefixes.begin(), sortedPrefixes.end(), sortedSuffixes[from], byKey) - sortedPrefixes.begin();
+                for (size_t s = from; s < to; ++s) {
+                    kmer_t suffix = sortedSuffixes[s].first;
+                    while (lower < prefixCount && sortedPrefixes[lower].first < suffix) ++lower;
+                    bool matches = lower < prefixCount && sortedPrefixes[lower].first == suffix;
+                    cursors[sortedSuffixes[s].second] = matches ? index_t(lower) : NONE;
+                }
+            });
+            // The matching prefixes are ordered by their indices, so those of each batch follow those of the previous batches.
+            for (size_t part = 0; part < batchCount; part++) {
+                if (d > 0 && checkTimeLimit(d)) break;
+                size_t to = std::min(kMersCount, (part + 1) * batchSize);
+                size_t suffixCount = activeSuffixes.size();
+                for (size_t blockFrom = 0; blockFrom < suffixCount; blockFrom += SUFFIX_QUERY_BLOCK_SIZE) {
+                    size_t blockTo = std::min(suffixCount, blockFrom + SUFFIX_QUERY_BLOCK_SIZE);
+                    // Find the last matching prefix in the batch for each suffix in parallel and move its cursor to the next batch.
+                    ParallelFor(blockFrom, blockTo, threads, [&](size_t chunkFrom, size_t chunkTo, int) {
+                        for (size_t p = chunkFrom; p < chunkTo; ++p) {
+                            size_t i = activeSuffixes[p];
+                            candidates[p - blockFrom] = NONE;
+                            if (suffixForbidden(i) || cursors[i] == NONE) continue;
+                            size_t begin = cursors[i];
+                            kmer_t suffix = sortedPrefixes[begin].first;
+                            size_t end = std::partition_point(sortedPrefixes.begin() + begin, sortedPrefixes.end(), [&](const std::pair<kmer_t, index_t> &prefix) {
+                                return prefix.first == suffix && prefix.second < to;
+                            }) - sortedPrefixes.begin();
+                            cursors[i] = (end < prefixCount && sortedPrefixes[end].first == suffix) ? index_t(end) : NONE;
+                            if (end > begin) candidates[p - blockFrom] = index_t(end - 1);
+                        }
+                    });
+                    // Commit the edges serially in the same order as the prefix map engine does.
+                    for (size_t p = blockFrom; p < blockTo; ++p) {
+                        size_t i = activeSuffixes[p];
+                        if (suffixForbidden(i) || candidates[p - blockFrom] == NONE) continue;
+                        addEdgeFromList(i, candidates[p - blockFrom], [&](index_t position) { return sortedPrefixes[position].second; }, d);
+                    }
+                }
+            }
+            continue;
+        }
         // In order to reduce memory requirements, the prefixes are not processed at once, but in batches.
         // As a cost, this slows down the algorithm.
-        for (int part = 0; part < MEMORY_REDUCTION_FACTOR; part++) {
-            wrapper.kh_clear_map(prefixes);
-            for (size_t i = 0; i < batchSize; ++i) {
-                next[i] = (size_t)-1;
-            }
+        for (size_t part = 0; part < batchCount; part++) {
+            if (d > 0 && checkTimeLimit(d)) break;
             size_t to = std::min(kMersCount, (part + 1) * batchSize);
-            size_t from = part * batchSize;
-            for (size_t i = from; i < to; ++i)
-                if (!prefixForbidden[i]) {
-                    next[i - from] = -1;
-                    kmer_t prefix = BitPrefix(accessPrefix(simplitigs,i), k, d);
-                    auto prefix_key = wrapper.kh_get_from_map(prefixes, prefix);
-                    if (prefix_key != kh_end(prefixes)) {
-                        next[i - from] = kh_val(prefixes, prefix_key);
-                    } else {
-                        int ret;
-                        prefix_key = wrapper.kh_put_to_map(prefixes, prefix, &ret);
-                    }
-                    kh_value(prefixes, prefix_key) = i;
+            size_t from = std::min(to, part * batchSize);
+            // The positions of the batch in the list of active prefixes.
+            size_t listFrom = std::lower_bound(activePrefixes.begin(), activePrefixes.end(), from) - activePrefixes.begin();
+            size_t listTo = std::lower_bound(activePrefixes.begin() + listFrom, activePrefixes.end(), to) - activePrefixes.begin();
+            if (listFrom == listTo) continue;
+            std::fill(ownerCounts.begin(), ownerCounts.end(), 0);
+            ParallelFor(listFrom, listTo, threads, [&](size_t chunkFrom, size_t chunkTo, int chunk) {
+                for (size_t p = chunkFrom; p < chunkTo; ++p) {
+                    size_t i = activePrefixes[p];
+                    if (prefixForbidden(i)) continue;
+                    kmer_t prefix = batchPrefixes[i - from] = BitPrefix(getPrefix(i), k, d);
+                    if (partitioned) ownerCounts[chunk * threads + PrefixMapOwner(prefix, threads)]++;
+                }
+            });
+            // The prefixes with the same key are inserted in the order of the list, so the result does not depend on the number of threads.
+            auto insertPrefix = [&](decltype(prefixes[0]) map, size_t position) {
+                next[position] = NONE;
+                auto prefix_key = wrapper.kh_get_from_map(map, batchPrefixes[position]);
+                if (prefix_key != kh_end(map)) {
+                    next[position] = kh_val(map, prefix_key);
+                } else {
+                    int ret;
+                    prefix_key = wrapper.kh_put_to_map(map, batchPrefixes[position], &ret);
                 }
-            for (size_t i = 0; i < kMersCount; ++i)
-                if (!suffixForbidden[i]) {
-                    kmer_t suffix = BitSuffix(accessSuffix(simplitigs, i), d);
-                    auto suffix_key = wrapper.kh_get_from_map(prefixes, suffix);
-                    if (suffix_key == kh_end(prefixes)) continue;
-                    size_t previous, j;
-                    previous = j = kh_val(prefixes, suffix_key);
-                    while (j != size_t(-1) && \
-                            // k-mers are complementary
-                           ((!lower_bound && (i + n) % (2 * n) == j) \
-                           // forms a cycle
-                           || (!lower_bound && accessFirstLast(first, last, i, n) == j) \
-                           // k-mer is already used
-                           || prefixForbidden[j])) {
-                        size_t new_j = next[j - from];
-                        // If the k-mer is forbidden, remove it to keep the complexity linear.
-                        // This is not done with the first k-mer but that is not a problem.
-                        if (prefixForbidden[j]) next[previous - from] = new_j;
-                        else previous = j;
-                        j = new_j;
+                kh_value(map, prefix_key) = position;
+            };
+            if (!partitioned) {
+                wrapper.kh_clear_map(prefixes[0]);
+                for (size_t p = listFrom; p < listTo; ++p) {
+                    size_t i = activePrefixes[p];
+                    if (!prefixForbidden(i)) insertPrefix(prefixes[0], i - from);
+                }
+            } else {
+                // Group the positions stably by their owner by a counting sort; the chunks are the same as in the counting pass.
+                size_t position = 0;
+                for (int owner = 0; owner < threads; ++owner) {
+                    ownerBegins[owner] = position;
+                    for (int chunk = 0; chunk < threads; ++chunk) {
+                        size_t count = ownerCounts[chunk * threads + owner];
+                        ownerCounts[chunk * threads + owner] = position;
+                        position += count;
                     }
-                    if (j == size_t(-1)) {
-                        continue;
+                }
+                ownerBegins[threads] = position;
+                ParallelFor(listFrom, listTo, threads, [&](size_t chunkFrom, size_t chunkTo, int chunk) {
+                    for (size_t p = chunkFrom; p < chunkTo; ++p) {
+                        size_t i = activePrefixes[p];
+                        if (prefixForbidden(i)) continue;
+                        batchOrder[ownerCounts[chunk * threads + PrefixMapOwner(batchPrefixes[i - from], threads)]++] = i - from;
                     }
-                    std::vector<std::pair<size_t, size_t>> new_edges({{i, j}});
-                    // Add also the edge between complementary k-mers in the opposite direction.
-                    if (complements) new_edges.emplace_back((j + n) % kMersCount, (i + n) % kMersCount);
-                    for (auto [x, y]: new_edges) {
-                        edgeFrom[x] = y;
-                        overlaps[x] = d;
-                        prefixForbidden[y] = true;
-                        auto lastY =  accessFirstLast(last, first, y, n);
-                        auto firstX = accessFirstLast(first, last, x, n);
-                        if (lastY < n) first[lastY] = firstX;
-                        if (firstX < n) last[firstX] = lastY;
-                        suffixForbidden[x] = true;
+                });
+                ParallelForEachThread(threads, [&](int thread) {
+                    auto *map = prefixes[thread];
+                    wrapper.kh_clear_map(map);
+                    for (size_t q = ownerBegins[thread]; q < ownerBegins[thread + 1]; ++q) insertPrefix(map, batchOrder[q]);
+                });
+            }
+            size_t suffixCount = activeSuffixes.size();
+            for (size_t blockFrom = 0; blockFrom < suffixCount; blockFrom += SUFFIX_QUERY_BLOCK_SIZE) {
+                size_t blockTo = std::min(suffixCount, blockFrom + SUFFIX_QUERY_BLOCK_SIZE);
+                // Look up the suffixes in parallel, the prefix maps are not modified until the next batch.
+                ParallelFor(blockFrom, blockTo, threads, [&](size_t chunkFrom, size_t chunkTo, int) {
+                    for (size_t p = chunkFrom; p < chunkTo; ++p) {
+                        size_t i = activeSuffixes[p];
+                        candidates[p - blockFrom] = NONE;
+                        if (suffixForbidden(i)) continue;
+                        kmer_t suffix = BitSuffix(getSuffix(i), d);
+                        auto *map = prefixes[threads > 1 ? PrefixMapOwner(suffix, threads) : 0];
+                        auto suffix_key = wrapper.kh_get_from_map(map, suffix);
+                        if (suffix_key != kh_end(map)) candidates[p - blockFrom] = kh_val(map, suffix_key);
                     }
-                    next[previous - from] = next[j - from];
+                });
+                // Commit the edges serially in the same order as if the suffixes were processed one by one.
+                for (size_t p = blockFrom; p < blockTo; ++p) {
+                    size_t i = activeSuffixes[p];
+                    if (suffixForbidden(i) || candidates[p - blockFrom] == NONE) continue;
+                    addEdgeFromList(i, candidates[p - blockFrom], [from](index_t position) { return position + from; }, d);
                 }
+            }
         }
     }
 
-    wrapper.kh_destroy_map(prefixes);
-    delete[](next);
-    delete[](first);
-    delete[](last);
-    return {edgeFrom, overlaps};
+    for (auto &map : prefixes) wrapper.kh_destroy_map(map);
+    if (checkpoint != nullptr && !outOfTime) checkpoint->SaveOverlap(-1, nodes.edgeFrom, nodes.state, first, last, true);
+    return nodes.ToOverlapPath();
 }
 
+/// Greedily find the approximate Hamiltonian path with longest overlaps on n nodes as in OverlapHamiltonianPathIndexed.
+/// The node indices are stored in 32 bits whenever they fit.
+template <typename kmer_t, typename kh_wrapper_t, typename prefix_getter_t, typename suffix_getter_t>
+overlapPath<kmer_t> OverlapHamiltonianPathGeneric (kh_wrapper_t wrapper, kmer_t kmerType, size_t n,
+                                                   prefix_getter_t getPrefix, suffix_getter_t getSuffix, int k, bool complements,
+                                                   bool lower_bound, const OverlapOptions &options, const MemoryPlan &plan) {
+    if (FitsCompactIndex(n * (1 + complements))) {
+        return OverlapHamiltonianPathIndexed<uint32_t>(wrapper, kmerType, n, getPrefix, getSuffix, k, complements,
+                                                       lower_bound, options, plan);
+    }
+    return OverlapHamiltonianPathIndexed<size_t>(wrapper, kmerType, n, getPrefix, getSuffix, k, complements,
+                                                 lower_bound, options, plan);
+}
 
-void PrintSimplitigStart(simplitig_t &simplitig, std::ostream& of, std::ostream *maskf, int k) {
-    size_t count = kmers_in_simplitig(simplitig, k);
-    for (size_t i = 0; i < count; ++i) {
-        char nucleotide = simplitig_at_index(simplitig, i);
-        of << nucleotide;
-        if (maskf != nullptr) (*maskf) << nucleotide;
+/// Greedily find the approximate Hamiltonian path with longest overlaps.
+/// Simplitigs are expected to be maximal and to contain only one out of canonical k-mer pair.
+/// If complements are provided, treat k-mer and its complement as identical.
+/// Moreover, if so, the resulting Hamiltonian path contains two superstrings which are reverse complements of one another.
+/// If lower_bound is set to true, return a shortest cycle cover instead.
+/// The options determine the number of threads and how the overlaps are found.
+/// Unless the memory budget is too tight, the first and last k-mers of the simplitigs and their reverse complements are precomputed.
+template <typename kmer_t, typename kh_wrapper_t>
+overlapPath<kmer_t> OverlapHamiltonianPath (kh_wrapper_t wrapper, kmer_t kmerType, std::vector<simplitig_t> &simplitigs, int k, bool complements,
+                                            bool lower_bound = false, const OverlapOptions &options = OverlapOptions()) {
+    size_t n = simplitigs.size();
+    size_t kMersCount = n * (1 + complements);
+    MemoryPlan plan;
+    if (options.maxMemory) {
+        size_t kMerCount = 0;
+        for (auto &simplitig : simplitigs) kMerCount += kmers_in_simplitig(simplitig, k);
+        plan = PlanOverlapMemory(kmerType, options.maxMemory, SimplitigsBytes(simplitigs), kMerCount, kMersCount,
+                                 n, SUFFIX_QUERY_BLOCK_SIZE, OverlapIndexBytes(kMersCount), !lower_bound && options.checkpoint != nullptr);
     }
+    if (options.endpointCache
+            && PlanEndpointCache(kmerType, plan, 2 * kMersCount * sizeof(kmer_t), kMersCount, MEMORY_REDUCTION_FACTOR)) {
+        std::vector<kmer_t> firstKMers(kMersCount), lastKMers(kMersCount);
+        ParallelFor(0, kMersCount, std::max(options.threads, 1), [&](size_t from, size_t to, int) {
+            for (size_t i = from; i < to; ++i) {
+                firstKMers[i] = accessPrefix(simplitigs, i);
+                lastKMers[i] = accessSuffix(simplitigs, i);
+            }
+        });
+        return OverlapHamiltonianPathGeneric(wrapper, kmerType, n,
+                                             [&](size_t i) { return firstKMers[i]; },
+                                             [&](size_t i) { return lastKMers[i]; },
+                                             k, complements, lower_bound, options, plan);
+    }
+    return OverlapHamiltonianPathGeneric(wrapper, kmerType, n,
+                                         [&](size_t i) { return accessPrefix(simplitigs, i); },
+                                         [&](size_t i) { return accessSuffix(simplitigs, i); },
+                                         k, complements, lower_bound, options, plan);
 }
 
 
-/// Construct the superstring and its mask from the given overlapPath path in the overlap graph.
-/// If reverse complements are considered and the overlapPath path contains two paths which are reverse complements of one another,
-/// return only one of them.
-template <typename kmer_t, typename kh_wrapper_t >
-size_t SuperstringFromPath(kh_wrapper_t wrapper, kmer_t kmerType, const overlapPath &hamiltonianPath, const std::vector<simplitig_t> &simplitigs, std::ostream& of, std::ostream *maskf, const int k, const bool complements) {
-    size_t kMersCount = simplitigs.size() * (1 + complements);
-    auto edgeFrom = hamiltonianPath.first;
-    auto overlaps = hamiltonianPath.second;
+/// Maximum number of characters of the superstring which are rendered in memory before they are written.
+constexpr size_t RENDER_BUFFER_SIZE = 1 << 24;
+
+/// Return the nodes of the path given by edgeFrom in their order, starting from start.
+inline std::vector<size_t> PathOrder(const std::vector<size_t> &edgeFrom, size_t start) {
+    std::vector<size_t> order;
+    for (size_t i = start; i != size_t(-1); i = edgeFrom[i]) order.push_back(i);
+    return order;
+}
+
+/// Write the superstring, and the mask if maskf is given, rendered node by node along a path of the given number of nodes.
+/// The p-th node takes nodeLength(p) characters, which renderNode(p, superstring, mask) writes to the given positions.
+/// The offsets of the nodes are computed by a prefix sum and the nodes are then rendered in parallel
+/// into a buffer of at most about bufferSize characters, which is written at once.
+/// Return the number of written characters.
+template <typename length_getter_t, typename renderer_t>
+size_t RenderPath(size_t nodes, length_getter_t nodeLength, renderer_t renderNode, std::ostream &of, std::ostream *maskf, int threads,
+                  size_t bufferSize = RENDER_BUFFER_SIZE) {
+    std::vector<size_t> offsets(nodes + 1, 0);
+    for (size_t p = 0; p < nodes; ++p) offsets[p + 1] = offsets[p] + nodeLength(p);
+    std::string superstring, mask;
+    for (size_t from = 0; from < nodes; ) {
+        // Take at least one node even if it does not fit into the buffer.
+        size_t to = std::upper_bound(offsets.begin() + from + 1, offsets.end(), offsets[from] + bufferSize) - offsets.begin() - 1;
+        to = std::max(to, from + 1);
+        size_t size = offsets[to] - offsets[from];
+        superstring.resize(size);
+        if (maskf != nullptr) mask.resize(size);
+        ParallelFor(from, to, std::max(threads, 1), [&](size_t chunkFrom, size_t chunkTo, int) {
+            for (size_t p = chunkFrom; p < chunkTo; ++p) {
+                size_t offset = offsets[p] - offsets[from];
+                renderNode(p, &superstring[offset], maskf != nullptr ? &mask[offset] : nullptr);
+            }
+        });
+        of.write(superstring.data(), size);
+        if (maskf != nullptr) maskf->write(mask.data(), size);
+        from = to;
+    }
+    return offsets[nodes];
+}
+
+/// Membership of the k-mers queried when printing the max-one mask, which is much smaller than a k-mer set.
+/// The k-mers are stored canonical and sorted; if present is not empty, only the stored k-mers marked in it are represented.
+template <typename kmer_t>
+struct MaskMembership {
+    std::vector<kmer_t> kMers;
+    std::vector<bool> present;
+    int k;
+    bool complements;
 
-    // Find the vertex in the overlap graph with in-degree 0.
+    kmer_t Canonical(kmer_t kMer) const {
+        if (!complements) return kMer;
+        kmer_t reverseComplement = ReverseComplement(kMer, k);
+        return kMer < reverseComplement ? kMer : reverseComplement;
+    }
+
+    bool Contains(kmer_t kMer) const {
+        auto it = std::lower_bound(kMers.begin(), kMers.end(), Canonical(kMer));
+        if (it == kMers.end() || *it != Canonical(kMer)) return false;
+        return present.empty() || present[it - kMers.begin()];
+    }
+};
+
+/// Build the membership of the k-mers for the max-one mask without constructing a k-mer set.
+/// forEachJunction enumerates the junctionCount k-mers which span two consecutive nodes of the superstring
+/// and forEachKMer the kMerCount represented k-mers.
+/// If there are fewer junction k-mers, only they are stored and the represented ones are marked;
+/// otherwise, all the represented k-mers are stored.
+template <typename kmer_t, typename junctions_t, typename kmers_t>
+MaskMembership<kmer_t> BuildMaskMembership(size_t junctionCount, size_t kMerCount, junctions_t forEachJunction,
+                                           kmers_t forEachKMer, int k, bool complements) {
+    MaskMembership<kmer_t> membership{{}, {}, k, complements};
+    auto &kMers = membership.kMers;
+    auto add = [&](kmer_t kMer) { kMers.push_back(membership.Canonical(kMer)); };
+    if (junctionCount < kMerCount) {
+        kMers.reserve(junctionCount);
+        forEachJunction(add);
+        std::sort(kMers.begin(), kMers.end());
+        kMers.erase(std::unique(kMers.begin(), kMers.end()), kMers.end());
+        kMers.shrink_to_fit();
+        membership.present.assign(kMers.size(), false);
+        forEachKMer([&](kmer_t kMer) {
+            kmer_t canonical = membership.Canonical(kMer);
+            auto it = std::lower_bound(kMers.begin(), kMers.end(), canonical);
+            if (it != kMers.end() && *it == canonical) membership.present[it - kMers.begin()] = true;
+        });
+    } else {
+        kMers.reserve(kMerCount);
+        forEachKMer(add);
+        std::sort(kMers.begin(), kMers.end());
+    }
+    return membership;
+}
+
+/// Return the first node of the path given by edgeFrom, i.e., the node with in-degree 0.
+inline size_t PathStart(const std::vector<size_t> &edgeFrom) {
+    size_t kMersCount = edgeFrom.size();
     std::vector<bool> isStart(kMersCount, true);
     for (auto edge : edgeFrom) {
         if (edge != size_t(-1)) isStart[edge] = false;
     }
     size_t start = 0;
     for (; start < kMersCount && !isStart[start]; ++start);
+    return start;
+}
 
-    auto *kMersDict = wrapper.kh_init_set();
+/// Construct the superstring and its mask from the given overlapPath path in the overlap graph.
+/// If reverse complements are considered and the overlapPath path contains two paths which are reverse complements of one another,
+/// return only one of them.
+/// The max-one mask is printed in the same pass using MaskMembership instead of a k-mer set.
+/// The simplitigs are rendered by the given number of threads.
+template <typename kmer_t, typename kh_wrapper_t >
+size_t SuperstringFromPath([[maybe_unused]] kh_wrapper_t wrapper, kmer_t kmerType, const overlapPath<kmer_t> &hamiltonianPath, const std::vector<simplitig_t> &simplitigs, std::ostream& of, std::ostream *maskf, const int k, const bool complements,
+                           int threads = 1) {
+    const auto &edgeFrom = hamiltonianPath.first;
+    const auto &overlaps = hamiltonianPath.second;
+    size_t start = PathStart(edgeFrom);
 
+    MaskMembership<kmer_t> membership;
     if (maskf != nullptr) {
-        fill_kmers(kMersDict, wrapper, kmerType, simplitigs, k);
+        size_t junctionCount = 0, kMerCount = 0;
+        for (size_t i = start; edgeFrom[i] != size_t(-1); i = edgeFrom[i]) junctionCount += k - overlaps[i] - 1;
+        for (auto &simplitig : simplitigs) kMerCount += kmers_in_simplitig(simplitig, k);
+        membership = BuildMaskMembership<kmer_t>(junctionCount, kMerCount, [&](auto add) {
+            for (size_t i = start; edgeFrom[i] != size_t(-1); i = edgeFrom[i]) {
+                kmer_t last = accessSuffix(simplitigs, i);
+                kmer_t current = accessPrefix(simplitigs, edgeFrom[i]);
+                for (int j = 0; j < k - overlaps[i] - 1; ++j) {
+                    last = BitSuffix((last << 2) | AtIndex(current, k, overlaps[i] + j), k);
+                    add(last);
+                }
+            }
+        }, [&](auto add) {
+            for (auto &simplitig : simplitigs) {
+                size_t count = kmers_in_simplitig(simplitig, k);
+                for (size_t i = 0; i < count; ++i) add(kmer_at_simplitig_index(kmerType, simplitig, k, i));
+            }
+        }, k, complements);
     }
 
-
-    simplitig_t simplitig = accessSimplitig(simplitigs, start);
-    kmer_t last = simplitig_last(kmerType, simplitig, k);
-
-    PrintSimplitigStart(simplitig, of, maskf, k);
-    size_t length = simplitig.size() / 2;
-
-    // Move from the first k-mer to the last which has no successor.
-    while(edgeFrom[start] != size_t(-1)) {
-        int overlapLength = overlaps[start];
-        simplitig = accessSimplitig(simplitigs, edgeFrom[start]);
-        length += simplitig.size() / 2 - overlapLength;
-        std::string unmaskedNucleotides = NumberToKMer(BitPrefix(last, k-1, k-1-overlapLength), k-1-overlapLength);
-        std::transform(unmaskedNucleotides.begin(), unmaskedNucleotides.end(), unmaskedNucleotides.begin(), tolower);
-        of << unmaskedNucleotides;
-        // If provided, output also mask maximizing ones.
-        if (maskf != nullptr) for (int j = 0; j < k - overlapLength - 1; ++j) {
+    auto order = PathOrder(edgeFrom, start);
+    // Each simplitig is preceded by the unmasked part of the previous one which does not overlap with it.
+    // The reverse complement of a simplitig has the same length.
+    auto nodeLength = [&](size_t p) {
+        size_t junction = p ? k - 1 - overlaps[order[p - 1]] : 0;
+        return junction + kmers_in_simplitig(simplitigs[order[p] % simplitigs.size()], k);
+    };
+    size_t length = RenderPath(order.size(), nodeLength, [&](size_t p, char *superstring, char *mask) {
+        simplitig_t simplitig = accessSimplitig(simplitigs, order[p]);
+        if (p) {
+            int overlapLength = overlaps[order[p - 1]];
+            kmer_t last = accessSuffix(simplitigs, order[p - 1]);
             kmer_t current = simplitig_first(kmerType, simplitig, k);
-            last <<= 2;
-            last |= AtIndex(current, k, overlapLength + j);
-            last = BitSuffix(last, k);
-            if (containsKMer(kMersDict, wrapper, last, k, complements)) {
-                (*maskf) << Masked(NucleotideAtIndex(last, k, 0), true);
-            } else {
-                (*maskf) << Masked(NucleotideAtIndex(last, k, 0), false);
+            kmer_t junction = last;
+            for (int j = 0; j < k - overlapLength - 1; ++j) {
+                *(superstring++) = tolower(NucleotideAtIndex(last, k, j + 1));
+                // If provided, output also mask maximizing ones.
+                if (mask != nullptr) {
+                    junction = BitSuffix((junction << 2) | AtIndex(current, k, overlapLength + j), k);
+                    *(mask++) = Masked(NucleotideAtIndex(junction, k, 0), membership.Contains(junction));
+                }
             }
         }
-        last = simplitig_last(kmerType, simplitig, k);
-        PrintSimplitigStart(simplitig, of, maskf, k);
-        start = edgeFrom[start];
-    }
+        size_t count = kmers_in_simplitig(simplitig, k);
+        for (size_t i = 0; i < count; ++i) {
+            char nucleotide = simplitig_at_index(simplitig, i);
+            *(superstring++) = nucleotide;
+            if (mask != nullptr) *(mask++) = nucleotide;
+        }
+    }, of, maskf, threads);
 
     // Print the trailing k-1 characters.
-    last = BitSuffix(last, k-1);
+    kmer_t last = BitSuffix(accessSuffix(simplitigs, order.back()), k-1);
     std::string unmaskedNucleotides = NumberToKMer(last, k-1);
     std::transform(unmaskedNucleotides.begin(), unmaskedNucleotides.end(), unmaskedNucleotides.begin(), tolower);
     of << unmaskedNucleotides;
     if (maskf != nullptr) {
         (*maskf) << unmaskedNucleotides << std::endl;
     }
+    length += k - 1;
     return length;
 }
 
@@ -215,12 +704,14 @@ size_t SuperstringFromPath(kh_wrapper_t wrapper, kmer_t kmerType, const overlapP
 /// If complements are provided, treat k-mer and its complement as identical.
 /// If this is the case, k-mers are expected not to contain both k-mer and its complement.
 template <typename kmer_t, typename kh_wrapper_t>
-void Global(kh_wrapper_t wrapper, kmer_t kmerType, std::vector<simplitig_t> &simplitigs, std::ostream& of, std::ostream *maskf, int k, bool complements) {
+void Global(kh_wrapper_t wrapper, kmer_t kmerType, std::vector<simplitig_t> &simplitigs, std::ostream& of, std::ostream *maskf, int k, bool complements,
+            const OverlapOptions &options = OverlapOptions()) {
     if (simplitigs.empty()) {
         throw std::invalid_argument("input cannot be empty");
     }
-    auto hamiltonianPath = OverlapHamiltonianPath(wrapper, kmerType, simplitigs, k, complements);
+    auto hamiltonianPath = OverlapHamiltonianPath(wrapper, kmerType, simplitigs, k, complements, false, options);
     WriteLog("Finished 2. part: Hamiltonian path.");
-    size_t length = SuperstringFromPath(wrapper, kmerType, hamiltonianPath, simplitigs, of, maskf, k, complements);
+    SaveOverlapPath(options, hamiltonianPath, simplitigs, k, complements, false);
+    size_t length = SuperstringFromPath(wrapper, kmerType, hamiltonianPath, simplitigs, of, maskf, k, complements, options.threads);
     WriteLog("Finished 3. part: masked superstring (l=" + std::to_string(length) + ").");
 }
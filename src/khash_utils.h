@@ -9,7 +9,7 @@
 
 #define kh_int128_hash_func(key) kh_int64_hash_func((khint64_t)((key)>>65^(key)^(key)<<21))
 #define kh_int128_hash_equal(a, b) ((a) == (b))
-#define kh_int256_hash_func(key) kh_int128_hash_func((__uint128_t)((key)>>129^(key)^(key)<<35))
+#define kh_int256_hash_func(key) kh_int128_hash_func((key).upper>>1^(key).lower^(key).lower<<35)
 #define kh_int256_hash_equal(a, b) ((a) == (b))
 
 #define KHASH_MAP_INIT_INT128(name, khval_t)								\
@@ -19,11 +19,36 @@
     KHASH_INIT(name, __uint128_t, char, 0, kh_int128_hash_func, kh_int128_hash_equal)
 
 #define KHASH_MAP_INIT_INT256(name, khval_t)								\
-	KHASH_INIT(name, uint256_t, khval_t, 1, kh_int256_hash_func, kh_int256_hash_equal)
+	KHASH_INIT(name, kmer256_t, khval_t, 1, kh_int256_hash_func, kh_int256_hash_equal)
 
 #define KHASH_SET_INIT_INT256(name)										\
-	KHASH_INIT(name, uint256_t, char, 0, kh_int256_hash_func, kh_int256_hash_equal)
+	KHASH_INIT(name, kmer256_t, char, 0, kh_int256_hash_func, kh_int256_hash_equal)
+
+/// Hash the multi-word k-mer by mixing its words one by one and applying the Wang hash to the result.
+template <int W>
+inline khint64_t kh_kmer_words_hash_func(const kmer_words_t<W> &key) {
+    khint64_t hash = 0;
+    for (int i = 0; i < W; ++i) {
+        hash = (hash ^ key.words[i]) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 32;
+    }
+    return kh_int64_hash_func(hash);
+}
+#define kh_kmer_words_hash_equal(a, b) ((a) == (b))
+
+#define KHASH_MAP_INIT_WORDS(name, kmer_t, khval_t)								\
+	KHASH_INIT(name, kmer_t, khval_t, 1, kh_kmer_words_hash_func, kh_kmer_words_hash_equal)
+
+#define KHASH_SET_INIT_WORDS(name, kmer_t)										\
+	KHASH_INIT(name, kmer_t, char, 0, kh_kmer_words_hash_func, kh_kmer_words_hash_equal)
 
+// Use multi-word integers for k-mers longer than 127.
+KHASH_SET_INIT_WORDS(S1024, kmer1024_t)
+KHASH_MAP_INIT_WORDS(P1024, kmer1024_t, size_t)
+KHASH_MAP_INIT_WORDS(Q1024, kmer1024_t, uint8_t)
+KHASH_SET_INIT_WORDS(S512, kmer512_t)
+KHASH_MAP_INIT_WORDS(P512, kmer512_t, size_t)
+KHASH_MAP_INIT_WORDS(Q512, kmer512_t, uint8_t)
 // Use 128-bit integers for extra large k-mers to allow for larger k.
 KHASH_SET_INIT_INT256(S256)
 KHASH_MAP_INIT_INT256(P256, size_t)
@@ -93,6 +118,8 @@ KHASH_MAP_INIT_INT64(Q64, uint8_t)
 INIT_KHASH_WRAPPER(64)
 INIT_KHASH_WRAPPER(128)
 INIT_KHASH_WRAPPER(256)
+INIT_KHASH_WRAPPER(512)
+INIT_KHASH_WRAPPER(1024)
 
 /// Determine whether the k-mer or its reverse complement is present.
 template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+/// Unsigned 256-bit integer of two 128-bit limbs for the k-mers with 64 <= k < 128.
+///
+/// It implements the same operations as kmer_words_t, but the shifts and comparisons are computed without branches
+/// on the limbs, which keeps the hot loops of the parser and of the greedy algorithms close to the 128-bit ones.
+/// The type is trivially copyable, so it can be saved as raw bytes as the other k-mer types.
+struct kmer256_t {
+    // The lower and the upper 128 bits.
+    __uint128_t lower;
+    __uint128_t upper;
+
+    kmer256_t() = default;
+
+    /// Convert from a built-in integer, extending the sign of the negative ones as the built-in conversion does.
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    constexpr kmer256_t(T value) : lower(__uint128_t(value)), upper(0) {
+        if constexpr (std::is_signed<T>::value) {
+            if (value < 0) {
+                lower = __uint128_t(__int128(value));
+                upper = ~__uint128_t(0);
+            }
+        }
+    }
+
+    constexpr kmer256_t(__uint128_t value) : lower(value), upper(0) {}
+
+    constexpr kmer256_t(__uint128_t upper, __uint128_t lower) : lower(lower), upper(upper) {}
+
+    explicit constexpr operator bool() const {
+        return lower | upper;
+    }
+
+    explicit constexpr operator __uint128_t() const {
+        return lower;
+    }
+
+    /// Return the lowest bits converted to the given built-in integer.
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>>
+    explicit constexpr operator T() const {
+        return T(lower);
+    }
+
+    /// Return the shift amount given by this number, saturated to the width.
+    constexpr unsigned ShiftAmount() const {
+        return upper || lower >= 256 ? 256 : unsigned(lower);
+    }
+
+    constexpr kmer256_t ShiftedLeft(unsigned shift) const {
+        unsigned inLimb = shift & 127;
+        // Shifting by one first avoids the undefined shift by 128 if inLimb is 0.
+        __uint128_t shiftedLower = lower << inLimb;
+        __uint128_t shiftedUpper = (upper << inLimb) | ((lower >> 1) >> (127 - inLimb));
+        __uint128_t crossLimb = -__uint128_t((shift >> 7) & 1);
+        __uint128_t valid = -__uint128_t(shift < 256);
+        return kmer256_t(((shiftedUpper & ~crossLimb) | (shiftedLower & crossLimb)) & valid, shiftedLower & ~crossLimb & valid);
+    }
+
+    constexpr kmer256_t ShiftedRight(unsigned shift) const {
+        unsigned inLimb = shift & 127;
+        __uint128_t shiftedUpper = upper >> inLimb;
+        __uint128_t shiftedLower = (lower >> inLimb) | ((upper << 1) << (127 - inLimb));
+        __uint128_t crossLimb = -__uint128_t((shift >> 7) & 1);
+        __uint128_t valid = -__uint128_t(shift < 256);
+        return kmer256_t(shiftedUpper & ~crossLimb & valid, ((shiftedLower & ~crossLimb) | (shiftedUpper & crossLimb)) & valid);
+    }
+
+    friend constexpr kmer256_t operator~(const kmer256_t &a) {
+        return kmer256_t(~a.upper, ~a.lower);
+    }
+
+    friend constexpr kmer256_t operator&(const kmer256_t &a, const kmer256_t &b) {
+        return kmer256_t(a.upper & b.upper, a.lower & b.lower);
+    }
+
+    friend constexpr kmer256_t operator|(const kmer256_t &a, const kmer256_t &b) {
+        return kmer256_t(a.upper | b.upper, a.lower | b.lower);
+    }
+
+    friend constexpr kmer256_t operator^(const kmer256_t &a, const kmer256_t &b) {
+        return kmer256_t(a.upper ^ b.upper, a.lower ^ b.lower);
+    }
+
+    friend constexpr kmer256_t operator+(const kmer256_t &a, const kmer256_t &b) {
+        __uint128_t lower = a.lower + b.lower;
+        return kmer256_t(a.upper + b.upper + (lower < a.lower), lower);
+    }
+
+    friend constexpr kmer256_t operator-(const kmer256_t &a, const kmer256_t &b) {
+        return kmer256_t(a.upper - b.upper - (a.lower < b.lower), a.lower - b.lower);
+    }
+
+    friend constexpr kmer256_t operator<<(const kmer256_t &a, int shift) {
+        return a.ShiftedLeft(unsigned(shift));
+    }
+
+    friend constexpr kmer256_t operator<<(const kmer256_t &a, const kmer256_t &shift) {
+        return a.ShiftedLeft(shift.ShiftAmount());
+    }
+
+    friend constexpr kmer256_t operator>>(const kmer256_t &a, int shift) {
+        return a.ShiftedRight(unsigned(shift));
+    }
+
+    friend constexpr kmer256_t operator>>(const kmer256_t &a, const kmer256_t &shift) {
+        return a.ShiftedRight(shift.ShiftAmount());
+    }
+
+    friend constexpr bool operator==(const kmer256_t &a, const kmer256_t &b) {
+        return !((a.upper ^ b.upper) | (a.lower ^ b.lower));
+    }
+
+    friend constexpr bool operator!=(const kmer256_t &a, const kmer256_t &b) {
+        return !(a == b);
+    }
+
+    friend constexpr bool operator<(const kmer256_t &a, const kmer256_t &b) {
+        return (a.upper < b.upper) | ((a.upper == b.upper) & (a.lower < b.lower));
+    }
+
+    friend constexpr bool operator>(const kmer256_t &a, const kmer256_t &b) {
+        return b < a;
+    }
+
+    friend constexpr bool operator<=(const kmer256_t &a, const kmer256_t &b) {
+        return !(b < a);
+    }
+
+    friend constexpr bool operator>=(const kmer256_t &a, const kmer256_t &b) {
+        return !(a < b);
+    }
+
+    constexpr kmer256_t &operator&=(const kmer256_t &b) { return *this = *this & b; }
+    constexpr kmer256_t &operator|=(const kmer256_t &b) { return *this = *this | b; }
+    constexpr kmer256_t &operator^=(const kmer256_t &b) { return *this = *this ^ b; }
+    constexpr kmer256_t &operator+=(const kmer256_t &b) { return *this = *this + b; }
+    constexpr kmer256_t &operator-=(const kmer256_t &b) { return *this = *this - b; }
+    constexpr kmer256_t &operator<<=(int shift) { return *this = *this << shift; }
+    constexpr kmer256_t &operator>>=(int shift) { return *this = *this >> shift; }
+    constexpr kmer256_t &operator++() { return *this = *this + kmer256_t(1); }
+    constexpr kmer256_t &operator--() { return *this = *this - kmer256_t(1); }
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+/// Unsigned integer of W 64-bit words for the k-mers which do not fit into kmer256_t.
+///
+/// It implements the operations which the algorithms use on the k-mers with the semantics of the built-in unsigned integers:
+/// bitwise operations, shifts, addition, subtraction and comparison. The words are stored from the lowest one,
+/// so the type is trivially copyable and can be saved as raw bytes as the other k-mer types.
+template <int W>
+struct kmer_words_t {
+    static_assert(W > 0, "k-mers need at least one word");
+
+    // The words from the lowest one.
+    uint64_t words[W];
+
+    kmer_words_t() = default;
+
+    /// Convert from a built-in integer, extending the sign of the negative ones as the built-in conversion does.
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    constexpr kmer_words_t(T value) : words{} {
+        words[0] = uint64_t(value);
+        if constexpr (std::is_signed<T>::value) {
+            if (value < 0) for (int i = 1; i < W; ++i) words[i] = ~uint64_t(0);
+        }
+    }
+
+    explicit constexpr operator bool() const {
+        for (int i = 0; i < W; ++i) if (words[i]) return true;
+        return false;
+    }
+
+    /// Return the lowest bits converted to the given built-in integer.
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>>
+    explicit constexpr operator T() const {
+        return T(words[0]);
+    }
+
+    /// Return the shift amount given by this number, saturated to the width.
+    constexpr size_t ShiftAmount() const {
+        for (int i = 1; i < W; ++i) if (words[i]) return 64 * W;
+        return words[0] < 64 * W ? size_t(words[0]) : 64 * W;
+    }
+
+    constexpr kmer_words_t ShiftedLeft(size_t shift) const {
+        kmer_words_t result(0);
+        if (shift >= 64 * W) return result;
+        int wordShift = int(shift >> 6), bitShift = int(shift & 63);
+        for (int i = W - 1; i >= wordShift; --i) {
+            result.words[i] = words[i - wordShift] << bitShift;
+            if (bitShift && i > wordShift) result.words[i] |= words[i - wordShift - 1] >> (64 - bitShift);
+        }
+        return result;
+    }
+
+    constexpr kmer_words_t ShiftedRight(size_t shift) const {
+        kmer_words_t result(0);
+        if (shift >= 64 * W) return result;
+        int wordShift = int(shift >> 6), bitShift = int(shift & 63);
+        for (int i = 0; i + wordShift < W; ++i) {
+            result.words[i] = words[i + wordShift] >> bitShift;
+            if (bitShift && i + wordShift + 1 < W) result.words[i] |= words[i + wordShift + 1] << (64 - bitShift);
+        }
+        return result;
+    }
+
+    friend constexpr kmer_words_t operator~(const kmer_words_t &a) {
+        kmer_words_t result;
+        for (int i = 0; i < W; ++i) result.words[i] = ~a.words[i];
+        return result;
+    }
+
+    friend constexpr kmer_words_t operator&(const kmer_words_t &a, const kmer_words_t &b) {
+        kmer_words_t result;
+        for (int i = 0; i < W; ++i) result.words[i] = a.words[i] & b.words[i];
+        return result;
+    }
+
+    friend constexpr kmer_words_t operator|(const kmer_words_t &a, const kmer_words_t &b) {
+        kmer_words_t result;
+        for (int i = 0; i < W; ++i) result.words[i] = a.words[i] | b.words[i];
+        return result;
+    }
+
+    friend constexpr kmer_words_t operator^(const kmer_words_t &a, const kmer_words_t &b) {
+        kmer_words_t result;
+        for (int i = 0; i < W; ++i) result.words[i] = a.words[i] ^ b.words[i];
+        return result;
+    }
+
+    friend constexpr kmer_words_t operator+(const kmer_words_t &a, const kmer_words_t &b) {
+        kmer_words_t result;
+        uint64_t carry = 0;
+        for (int i = 0; i < W; ++i) {
+            uint64_t sum = a.words[i] + carry;
+            carry = sum < carry;
+            result.words[i] = sum + b.words[i];
+            carry += result.words[i] < sum;
+        }
+        return result;
+    }
+
+    friend constexpr kmer_words_t operator-(const kmer_words_t &a, const kmer_words_t &b) {
+        kmer_words_t result;
+        uint64_t borrow = 0;
+        for (int i = 0; i < W; ++i) {
+            uint64_t difference = a.words[i] - borrow;
+            borrow = a.words[i] < borrow;
+            result.words[i] = difference - b.words[i];
+            borrow += difference < b.words[i];
+        }
+        return result;
+    }
+
+    friend constexpr kmer_words_t operator<<(const kmer_words_t &a, int shift) {
+        return a.ShiftedLeft(size_t(shift));
+    }
+
+    friend constexpr kmer_words_t operator<<(const kmer_words_t &a, const kmer_words_t &shift) {
+        return a.ShiftedLeft(shift.ShiftAmount());
+    }
+
+    friend constexpr kmer_words_t operator>>(const kmer_words_t &a, int shift) {
+        return a.ShiftedRight(size_t(shift));
+    }
+
+    friend constexpr kmer_words_t operator>>(const kmer_words_t &a, const kmer_words_t &shift) {
+        return a.ShiftedRight(shift.ShiftAmount());
+    }
+
+    friend constexpr bool operator==(const kmer_words_t &a, const kmer_words_t &b) {
+        for (int i = 0; i < W; ++i) if (a.words[i] != b.words[i]) return false;
+        return true;
+    }
+
+    friend constexpr bool operator!=(const kmer_words_t &a, const kmer_words_t &b) {
+        return !(a == b);
+    }
+
+    friend constexpr bool operator<(const kmer_words_t &a, const kmer_words_t &b) {
+        for (int i = W - 1; i >= 0; --i) if (a.words[i] != b.words[i]) return a.words[i] < b.words[i];
+        return false;
+    }
+
+    friend constexpr bool operator>(const kmer_words_t &a, const kmer_words_t &b) {
+        return b < a;
+    }
+
+    friend constexpr bool operator<=(const kmer_words_t &a, const kmer_words_t &b) {
+        return !(b < a);
+    }
+
+    friend constexpr bool operator>=(const kmer_words_t &a, const kmer_words_t &b) {
+        return !(a < b);
+    }
+
+    constexpr kmer_words_t &operator&=(const kmer_words_t &b) { return *this = *this & b; }
+    constexpr kmer_words_t &operator|=(const kmer_words_t &b) { return *this = *this | b; }
+    constexpr kmer_words_t &operator^=(const kmer_words_t &b) { return *this = *this ^ b; }
+    constexpr kmer_words_t &operator+=(const kmer_words_t &b) { return *this = *this + b; }
+    constexpr kmer_words_t &operator-=(const kmer_words_t &b) { return *this = *this - b; }
+    constexpr kmer_words_t &operator<<=(int shift) { return *this = *this << shift; }
+    constexpr kmer_words_t &operator>>=(int shift) { return *this = *this >> shift; }
+    constexpr kmer_words_t &operator++() { return *this = *this + kmer_words_t(1); }
+    constexpr kmer_words_t &operator--() { return *this = *this - kmer_words_t(1); }
+};
@@ -4,13 +4,16 @@
 #include <iostream>
 #include <cstdint>
 
-#include "uint256_t/uint256_t.h"
+#include "kmer256.h"
+#include "kmer_words.h"
 
 #include "ac/kmers_ac.h"
 
 typedef __uint128_t kmer128_t;
 typedef uint64_t kmer64_t;
-typedef uint256_t kmer256_t;
+// Multi-word k-mers for k up to 255 and 511.
+typedef kmer_words_t<8> kmer512_t;
+typedef kmer_words_t<16> kmer1024_t;
 
 static const uint8_t nucleotideToInt[] = {
 		4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
@@ -34,13 +37,13 @@ static const uint8_t nucleotideToInt[] = {
 /// Compute the prefix of size d of the given k-mer.
 template <typename kmer_t>
 kmer_t BitPrefix(kmer_t kMer, int k, int d) {
-    return kMer >> ((k - d) << kmer_t(1));
+    return kMer >> ((k - d) << 1);
 }
 
 /// Compute the suffix of size d of the given k-mer.
 template <typename kmer_t>
 kmer_t BitSuffix(kmer_t kMer, int d) {
-    return kMer & ((kmer_t(1) << (d << kmer_t(1))) - kmer_t(1));
+    return kMer & ((kmer_t(1) << (d << 1)) - kmer_t(1));
 }
 
 /// Checkered mask. cmask<uint16_t, 1> is every other bit on
@@ -83,9 +86,15 @@ inline kmer128_t word_reverse_complement(kmer128_t w) {
 
 /// Compute the reverse complement of a word.
 inline kmer256_t word_reverse_complement(kmer256_t w) {
-    kmer128_t low = word_reverse_complement(w.lower());
-    kmer128_t high = word_reverse_complement(w.upper());
-    return kmer256_t(low, high);
+    return kmer256_t(word_reverse_complement(w.lower), word_reverse_complement(w.upper));
+}
+
+/// Compute the reverse complement of a multi-word k-mer by reversing the order of its words.
+template <int W>
+inline kmer_words_t<W> word_reverse_complement(const kmer_words_t<W> &w) {
+    kmer_words_t<W> result;
+    for (int i = 0; i < W; ++i) result.words[i] = word_reverse_complement(w.words[W - 1 - i]);
+    return result;
 }
 
 /// Compute the reverse complement of the given k-mer.
@@ -98,7 +107,7 @@ const char letters[4] {'A', 'C', 'G', 'T'};
 
 template <typename kmer_t>
 inline kmer_t AtIndex(kmer_t encoded, int k, int index) {
-    return ((encoded >> ((k - index - kmer_t(1)) << kmer_t(1))) & kmer_t(3));
+    return ((encoded >> ((k - index - 1) << 1)) & kmer_t(3));
 }
 
 /// Return the index-th nucleotide from the encoded k-mer.
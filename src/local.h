@@ -6,10 +6,20 @@
 #include <deque>
 #include <cstdint>
 #include <algorithm>
+#include <numeric>
+#include <list>
 #include <fstream>
+#include <atomic>
+#include <mutex>
+#include <cstdio>
+#include <stdexcept>
+
+#include <sys/mman.h>
 
 #include "kmers.h"
 #include "khash_utils.h"
+#include "radix_sort.h"
+#include "parallel.h"
 
 
 /// Find the right extension to the provided last k-mer from the kMers.
@@ -42,40 +52,228 @@ std::pair<kmer_t, kmer_t> LeftExtension(kmer_t first, kh_S_t *kMers, kh_wrapper_
     return {-1, -1};
 }
 
-/// Find the next generalized simplitig.
-/// Also remove the used k-mers from kMers.
-/// If complements are true, it is expected that kMers only contain one k-mer from a complementary pair.
+/// Reverse the order of the nucleotides of the given k-mer without complementing them.
+template <typename kmer_t>
+inline kmer_t ReverseNucleotides(kmer_t kMer, int k) {
+    return ReverseComplement(kMer, k) ^ ((kmer_t(1) << (k << 1)) - kmer_t(1));
+}
+
+/// The largest length of the prefixes in the directory of SortedKMers, which limits it to 4^11 entries.
+constexpr int MAX_DIRECTORY_LENGTH = 11;
+
+/// Sorted k-mers which can be marked as used and queried for an unused k-mer with a given prefix.
+/// The used k-mers are skipped by pointers to the next unused k-mer with path halving
+/// and the binary searches are narrowed by a directory of the positions of the short prefixes.
+template <typename kmer_t>
+class SortedKMers {
+    int k;
+    std::vector<kmer_t> kMers;
+    // For each position, the same or a later position whose k-mer is unused, or a position before it.
+    std::vector<size_t> next;
+    // The position of the first k-mer with each prefix of length directoryLength.
+    std::vector<size_t> directory;
+    int directoryLength = 0;
+
+public:
+    /// Sort the given k-mers, remove duplicates, and make all of them unused.
+    SortedKMers(std::vector<kmer_t> &&unsorted, int k) : k(k), kMers(std::move(unsorted)) {
+        RadixSortKMers(kMers, k, 1);
+        kMers.erase(std::unique(kMers.begin(), kMers.end()), kMers.end());
+        kMers.shrink_to_fit();
+        // The last position is a sentinel which is never used.
+        next.resize(kMers.size() + 1);
+        std::iota(next.begin(), next.end(), 0);
+        // Use about one directory entry per two k-mers.
+        while (directoryLength < std::min(k, MAX_DIRECTORY_LENGTH) && (size_t(1) << (2 * directoryLength + 3)) <= kMers.size()) {
+            ++directoryLength;
+        }
+        directory.resize((size_t(1) << (2 * directoryLength)) + 1);
+        size_t position = 0;
+        for (size_t prefix = 0; prefix + 1 < directory.size(); ++prefix) {
+            directory[prefix] = position;
+            while (position < kMers.size() && size_t(uint64_t(BitPrefix(kMers[position], k, directoryLength))) == prefix) ++position;
+        }
+        directory.back() = kMers.size();
+    }
+
+    const std::vector<kmer_t> &KMers() const {
+        return kMers;
+    }
+
+    /// Return the position of the first k-mer which is not smaller than the given one.
+    size_t LowerBound(kmer_t kMer) const {
+        size_t prefix = size_t(uint64_t(BitPrefix(kMer, k, directoryLength)));
+        return std::lower_bound(kMers.begin() + directory[prefix], kMers.begin() + directory[prefix + 1], kMer) - kMers.begin();
+    }
+
+    /// Return the first position at or after the given one with an unused k-mer.
+    size_t FindUnused(size_t position) {
+        while (next[position] != position) {
+            next[position] = next[next[position]];
+            position = next[position];
+        }
+        return position;
+    }
+
+    /// Find an unused k-mer with the given prefix of length k-d, or return -1 if there is none.
+    kmer_t FindPrefix(kmer_t prefix, int d) {
+        size_t position = FindUnused(LowerBound(prefix << (d << 1)));
+        if (position == kMers.size() || (kMers[position] >> (d << 1)) != prefix) return kmer_t(-1);
+        return kMers[position];
+    }
+
+    /// Mark the given k-mer as used and return whether it was present and unused.
+    bool Use(kmer_t kMer) {
+        size_t position = LowerBound(kMer);
+        if (position == kMers.size() || kMers[position] != kMer || next[position] != position) return false;
+        next[position] = position + 1;
+        return true;
+    }
+};
+
+/// Index of the unused k-mers for the local greedy.
+/// The k-mers with a given prefix of any length form a range in the sorted k-mers, so an extension by d characters
+/// is found by a binary search and a skip to the next unused k-mer instead of probing all the 4^d possible extensions.
+/// The k-mers with a given suffix are found in the same way among the reverse complements,
+/// or without complements, among the k-mers with their nucleotides reversed.
+template <typename kmer_t>
+class ExtensionIndex {
+    int k;
+    bool complements;
+    // Without complements, the k-mers with the reversed nucleotides; empty otherwise.
+    SortedKMers<kmer_t> suffixes;
+    // The k-mers and, with complements, their reverse complements.
+    SortedKMers<kmer_t> prefixes;
+    // Position from which the next unused k-mer is searched for when starting a new generalized simplitig.
+    size_t cursor = 0;
+    size_t unused = 0;
+
+    static std::vector<kmer_t> WithComplements(std::vector<kmer_t> &&kMers, int k) {
+        size_t n = kMers.size();
+        kMers.reserve(2 * n);
+        for (size_t i = 0; i < n; ++i) kMers.push_back(ReverseComplement(kMers[i], k));
+        return std::move(kMers);
+    }
+
+    static std::vector<kmer_t> Reversed(const std::vector<kmer_t> &kMers, int k) {
+        std::vector<kmer_t> reversed(kMers.size());
+        for (size_t i = 0; i < kMers.size(); ++i) reversed[i] = ReverseNucleotides(kMers[i], k);
+        return reversed;
+    }
+
+public:
+    /// Build the index of the given k-mers, which are consumed.
+    /// If complements are true, it is expected that kMers only contain one k-mer from a complementary pair.
+    ExtensionIndex(std::vector<kmer_t> &&kMers, int k, bool complements)
+            : k(k), complements(complements),
+              suffixes(complements ? std::vector<kmer_t>() : Reversed(kMers, k), k),
+              prefixes(complements ? WithComplements(std::move(kMers), k) : std::move(kMers), k) {
+        if (!complements) unused = prefixes.KMers().size();
+        else for (kmer_t kMer : prefixes.KMers()) unused += kMer <= ReverseComplement(kMer, k);
+    }
+
+    /// Return the number of the unused k-mers.
+    size_t Unused() const {
+        return unused;
+    }
+
+    /// Return the smallest unused k-mer after the previously returned one, or -1 if all are used.
+    kmer_t NextUnused() {
+        cursor = prefixes.FindUnused(cursor);
+        return cursor == prefixes.KMers().size() ? kmer_t(-1) : prefixes.KMers()[cursor];
+    }
+
+    /// Mark the given k-mer (and its reverse complement) as used.
+    void Erase(kmer_t kMer) {
+        bool used = prefixes.Use(kMer);
+        if (complements) used |= prefixes.Use(ReverseComplement(kMer, k));
+        else suffixes.Use(ReverseNucleotides(kMer, k));
+        unused -= used;
+    }
+
+    /// Find an unused right extension of the provided last k-mer with k-d overlap.
+    /// Return the extension - that is the d chars extending the kmer - and the extending k-mer, or -1s if there is none.
+    std::pair<kmer_t, kmer_t> RightExtension(kmer_t last, int d) {
+        kmer_t next = prefixes.FindPrefix(BitSuffix(last, k - d), d);
+        if (next == kmer_t(-1)) return {-1, -1};
+        return {BitSuffix(next, d), next};
+    }
+
+    /// Find an unused left extension of the provided first k-mer with k-d overlap.
+    /// Return the extension - that is the d chars extending the kmer - and the extending k-mer, or -1s if there is none.
+    std::pair<kmer_t, kmer_t> LeftExtension(kmer_t first, int d) {
+        kmer_t prefix = BitPrefix(first, k, k - d);
+        kmer_t next;
+        if (complements) {
+            // The k-mers ending with the prefix are the reverse complements of those starting with its reverse complement.
+            next = prefixes.FindPrefix(ReverseComplement(prefix, k - d), d);
+            if (next != kmer_t(-1)) next = ReverseComplement(next, k);
+        } else {
+            next = suffixes.FindPrefix(ReverseNucleotides(prefix, k - d), d);
+            if (next != kmer_t(-1)) next = ReverseNucleotides(next, k);
+        }
+        if (next == kmer_t(-1)) return {-1, -1};
+        return {BitPrefix(next, k, d), next};
+    }
+};
+
+/// Extension search which probes all the 4^d possible extensions in the k-mer set, which is fast for small d.
 template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
-void NextGeneralizedSimplitig(kh_S_t *kMers, kh_wrapper_t wrapper, kmer_t begin, std::ostream& of,  int k, int d_max, bool complements) {
+struct ProbingExtensions {
+    kh_S_t *kMers;
+    kh_wrapper_t wrapper;
+    int k;
+    bool complements;
+
+    void Erase(kmer_t kMer) {
+        eraseKMer(kMers, wrapper, kMer, k, complements);
+    }
+
+    std::pair<kmer_t, kmer_t> RightExtension(kmer_t last, int d) {
+        return ::RightExtension(last, kMers, wrapper, k, d, complements);
+    }
+
+    std::pair<kmer_t, kmer_t> LeftExtension(kmer_t first, int d) {
+        return ::LeftExtension(first, kMers, wrapper, k, d, complements);
+    }
+};
+
+/// The largest d_max for which the local greedy probes all the possible extensions instead of building the ExtensionIndex.
+constexpr int MAX_PROBING_D = 5;
+
+/// Return the generalized simplitig starting from the given k-mer using the given extension search.
+/// Also mark the used k-mers as used in the search.
+template <typename kmer_t, typename extensions_t>
+std::string GeneralizedSimplitig(extensions_t &extensions, kmer_t begin, int k, int d_max) {
      // Maintain the first and last k-mer in the simplitig.
     kmer_t last = begin, first = begin;
     std::list<char> simplitig {NucleotideAtIndex(first, k, 0)};
-    eraseKMer(kMers, wrapper, last, k, complements);
+    extensions.Erase(last);
     int d_l = 1, d_r = 1;
     while (d_l <= d_max || d_r <= d_max) {
         if (d_r <= d_l) {
-            auto extension = RightExtension(last, kMers, wrapper, k, d_r, complements);
+            auto extension = extensions.RightExtension(last, d_r);
             kmer_t ext = extension.first;
             if (ext == kmer_t(-1)) {
                 // No right extension found.
                 ++d_r;
             } else {
                 // Extend the generalized simplitig to the right.
-                eraseKMer(kMers, wrapper, extension.second, k, complements);
+                extensions.Erase(extension.second);
                 for (int i = 1; i < d_r; ++i) simplitig.emplace_back((char)std::tolower(NucleotideAtIndex(last, k, i)));
                 simplitig.emplace_back(NucleotideAtIndex(last, k, d_r));
                 last = extension.second;
                 d_r = 1;
             }
         } else {
-            auto extension = LeftExtension(first, kMers,  wrapper, k, d_l, complements);
+            auto extension = extensions.LeftExtension(first, d_l);
             kmer_t ext = extension.first;
             if (ext == kmer_t(-1)) {
                 // No left extension found.
                 ++d_l;
             } else {
                 // Extend the simplitig to the left.
-                eraseKMer(kMers, wrapper, extension.second, k, complements);
+                extensions.Erase(extension.second);
                 for (int i = d_l - 1; i > 0; --i) simplitig.emplace_front((char)std::tolower(NucleotideAtIndex(extension.second, k, i)));
                 simplitig.emplace_front(NucleotideAtIndex(extension.second, k, 0));
                 first = extension.second;
@@ -84,23 +282,349 @@ void NextGeneralizedSimplitig(kh_S_t *kMers, kh_wrapper_t wrapper, kmer_t begin,
         }
     }
     for (int i = 1; i < k; ++i) simplitig.emplace_back((char)std::tolower(NucleotideAtIndex(last, k, i)));
-    of << std::string(simplitig.begin(), simplitig.end());
+    return std::string(simplitig.begin(), simplitig.end());
+}
+
+/// Find the next generalized simplitig starting from the given k-mer using the given extension search and print it.
+template <typename kmer_t, typename extensions_t>
+void NextGeneralizedSimplitig(extensions_t &extensions, kmer_t begin, std::ostream& of,  int k, int d_max) {
+    of << GeneralizedSimplitig(extensions, begin, k, d_max);
     of.flush();
 }
 
+/// Find the next generalized simplitig.
+/// Also remove the used k-mers from kMers.
+/// If complements are true, it is expected that kMers only contain one k-mer from a complementary pair.
+template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+void NextGeneralizedSimplitig(kh_S_t *kMers, kh_wrapper_t wrapper, kmer_t begin, std::ostream& of,  int k, int d_max, bool complements) {
+    ProbingExtensions<kmer_t, kh_S_t, kh_wrapper_t> extensions{kMers, wrapper, k, complements};
+    NextGeneralizedSimplitig(extensions, begin, of, k, d_max);
+}
+
 /// Get the approximated shortest superstring of the given k-mers using the local greedy algorithm.
 ///
-/// This runs in O(n d_max ^ k), where n is the number of k-mers, but for practical uses it is faster than AC version.
+/// Up to d_max of MAX_PROBING_D, all the possible extensions are probed in the hash table, which runs in O(n 4^d_max)
+/// for n k-mers, but for practical uses it is faster than the AC version.
+/// For larger d_max, the extensions are found in the ExtensionIndex in O(n d_max log n).
 /// If complements are provided, treat k-mer and its complement as identical.
 /// If this is the case, k-mers are expected not to contain both k-mer and its complement.
 /// Warning: this will destroy kMers.
 template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
 void Local(kh_S_t *kMers, kh_wrapper_t wrapper, kmer_t _, std::ostream& of, int k, int d_max, bool complements) {
-    size_t lastIndex = 0;
+    if (d_max <= MAX_PROBING_D) {
+        size_t lastIndex = 0;
+        while(true) {
+            kmer_t begin = nextKMer(kMers, _, lastIndex);
+            // No more k-mers.
+            if (begin == kmer_t(-1)) break;
+            NextGeneralizedSimplitig(kMers, wrapper, begin, of,  k, d_max, complements);
+        }
+        wrapper.kh_destroy_set(kMers);
+        return;
+    }
+    auto kMerVec = kMersToVec(kMers, _);
+    wrapper.kh_destroy_set(kMers);
+    ExtensionIndex<kmer_t> index(std::move(kMerVec), k, complements);
     while(true) {
-        kmer_t begin = nextKMer(kMers, _, lastIndex);
+        kmer_t begin = index.NextUnused();
         // No more k-mers.
         if (begin == kmer_t(-1)) return;
-        NextGeneralizedSimplitig(kMers, wrapper, begin, of,  k, d_max, complements);
+        NextGeneralizedSimplitig(index, begin, of,  k, d_max);
+    }
+}
+
+/// Number of partitions of the k-mers in the parallel local greedy; it does not depend on the number of threads,
+/// so that the result is the same for any number of threads larger than 1 (a single thread runs the serial Local, whose result differs).
+constexpr size_t LOCAL_PARTITION_COUNT = 256;
+
+/// The largest length of the minimizers by which the k-mers are partitioned in the parallel local greedy.
+constexpr int LOCAL_MINIMIZER_LENGTH = 11;
+
+/// The largest d_max of the local greedy inside the partitions. The k-mers of a partition share their minimizer,
+/// so with larger d, their ends would be joined by spurious overlaps before their true neighbours from other partitions are reached.
+/// It also keeps probing the extensions of the many short generalized simplitigs of the partitions cheap; the larger overlaps are left to the stitching.
+constexpr int LOCAL_PARTITION_D_MAX = 1;
+
+/// Return the partition of the k-mer given by the hash of its minimizer of length m.
+/// With complements, the minimizer is canonical, so that a k-mer and its reverse complement fall into the same partition.
+template <typename kmer_t>
+size_t MinimizerPartition(kmer_t kMer, int k, int m, bool complements, size_t partitions) {
+    kmer_t mask = (kmer_t(1) << (m << 1)) - kmer_t(1);
+    kmer_t reverseComplement = complements ? ReverseComplement(kMer, k) : kmer_t(0);
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i + m <= k; ++i) {
+        uint64_t mMer = uint64_t((kMer >> (i << 1)) & mask);
+        if (complements) mMer = std::min(mMer, uint64_t((reverseComplement >> ((k - m - i) << 1)) & mask));
+        best = std::min(best, uint64_t(__ac_Wang_hash(mMer)));
+    }
+    return best % partitions;
+}
+
+/// Compute the generalized simplitigs of the given k-mers by the local greedy and append them to superstring
+/// and the positions of their ends to ends.
+/// As in Local, the extensions are probed in a k-mer set up to d_max of MAX_PROBING_D and found in the ExtensionIndex otherwise.
+template <typename kmer_t, typename kh_wrapper_t>
+void LocalGeneralizedSimplitigs(std::vector<kmer_t> &&kMers, kh_wrapper_t wrapper, int k, int d_max, bool complements,
+                                std::string &superstring, std::vector<size_t> &ends) {
+    if (d_max > MAX_PROBING_D) {
+        ExtensionIndex<kmer_t> index(std::move(kMers), k, complements);
+        for (kmer_t begin = index.NextUnused(); begin != kmer_t(-1); begin = index.NextUnused()) {
+            superstring += GeneralizedSimplitig(index, begin, k, d_max);
+            ends.push_back(superstring.size());
+        }
+        return;
+    }
+    auto kMerSet = wrapper.kh_init_set();
+    kMersFromVec(kMerSet, wrapper, kMers);
+    std::vector<kmer_t>().swap(kMers);
+    ProbingExtensions<kmer_t, std::remove_pointer_t<decltype(kMerSet)>, kh_wrapper_t> extensions{kMerSet, wrapper, k, complements};
+    size_t lastIndex = 0;
+    for (kmer_t begin = nextKMer(kMerSet, kmer_t(0), lastIndex); begin != kmer_t(-1); begin = nextKMer(kMerSet, kmer_t(0), lastIndex)) {
+        superstring += GeneralizedSimplitig(extensions, begin, k, d_max);
+        ends.push_back(superstring.size());
+    }
+    wrapper.kh_destroy_set(kMerSet);
+}
+
+/// Temporary file to which the generalized simplitigs of the partitions are written in the order of the partitions
+/// as soon as they and all the previous partitions are computed, so that they are not kept in memory at once.
+/// Once all are written, the file is mapped to memory to be read by the stitching.
+class PartitionSpill {
+public:
+    explicit PartitionSpill(size_t partitions) : superstrings(partitions), done(partitions) {
+        file = std::tmpfile();
+        if (file == nullptr) throw std::runtime_error("cannot create a temporary file for the partitions of the local greedy");
+    }
+    PartitionSpill(const PartitionSpill&) = delete;
+    PartitionSpill& operator=(const PartitionSpill&) = delete;
+    ~PartitionSpill() {
+        if (data != nullptr) munmap((void *)data, size);
+        std::fclose(file);
+    }
+
+    /// Hand over the superstring of the given partition and write all the partitions which are ready.
+    void Add(size_t partition, std::string &&superstring) {
+        std::lock_guard<std::mutex> lock(mutex);
+        superstrings[partition] = std::move(superstring);
+        done[partition] = true;
+        for (; written < done.size() && done[written]; ++written) {
+            size += superstrings[written].size();
+            if (std::fwrite(superstrings[written].data(), 1, superstrings[written].size(), file) != superstrings[written].size()) {
+                throw std::runtime_error("cannot write the partitions of the local greedy to a temporary file");
+            }
+            std::string().swap(superstrings[written]);
+        }
+    }
+
+    /// Map the written superstrings to memory and return them; all the partitions have to be added.
+    const char *Map() {
+        if (!size) return "";
+        if (std::fflush(file) != 0) throw std::runtime_error("cannot write the partitions of the local greedy to a temporary file");
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (mapped == MAP_FAILED) throw std::runtime_error("cannot map the partitions of the local greedy to memory");
+        return data = (const char *)mapped;
+    }
+
+private:
+    std::FILE *file = nullptr;
+    std::mutex mutex;
+    // Superstrings of the partitions which wait for the previous partitions to be written.
+    std::vector<std::string> superstrings;
+    std::vector<bool> done;
+    size_t written = 0;
+    size_t size = 0;
+    const char *data = nullptr;
+};
+
+/// Encode the k-mer at the given position of a masked superstring.
+template <typename kmer_t>
+kmer_t KMerAt(const char *superstring, size_t position, int k) {
+    kmer_t kMer = 0;
+    for (int i = 0; i < k; ++i) kMer = (kMer << 2) | kmer_t(nucleotideToInt[(uint8_t)superstring[position + i]]);
+    return kMer;
+}
+
+/// Print the masked superstring of the given length at the given position without its last skip characters,
+/// reverse complemented if reversed.
+inline void WriteMaskedPiece(std::ostream &of, const char *superstring, size_t position, size_t length, int k,
+                             bool reversed, size_t skip) {
+    if (!reversed) {
+        of.write(superstring + position, length - skip);
+        return;
+    }
+    std::string piece(length - skip, 'A');
+    for (size_t j = 0; j < piece.size(); ++j) {
+        char c = letters[3 - nucleotideToInt[(uint8_t)superstring[position + length - 1 - j]]];
+        // The k-mer starting at j is the reverse complement of the one ending at length - 1 - j.
+        piece[j] = Masked(c, j + k <= length && std::isupper(superstring[position + length - k - j]));
+    }
+    of << piece;
+}
+
+/// Join the generalized simplitigs of the partitions by the local greedy on their first and last k-mers and print the result.
+/// The nodes are extended by the nodes whose first k-mer (or the reverse complement of the last one) is found by starts
+/// and whose last k-mer (or the reverse complement of the first one) is found by endings; maps give the nodes of these k-mers.
+template <typename kmer_t, typename extensions_t, typename kh_wrapper_t, typename kh_P_t>
+void StitchGeneralizedSimplitigs(const char *superstring, const std::vector<size_t> &ends,
+                                 const std::vector<kmer_t> &first, const std::vector<kmer_t> &last,
+                                 extensions_t &starts, extensions_t &endings, kh_P_t *startMap, kh_P_t *endMap,
+                                 kh_wrapper_t wrapper, std::ostream &of, int k, int d_max, bool complements) {
+    size_t n = ends.size();
+    std::vector<bool> used(n);
+    auto use = [&](size_t node) {
+        used[node] = true;
+        starts.Erase(first[node]);
+        endings.Erase(last[node]);
+        if (complements) {
+            starts.Erase(ReverseComplement(last[node], k));
+            endings.Erase(ReverseComplement(first[node], k));
+        }
+    };
+    auto nodeOf = [&](kh_P_t *map, kmer_t kMer) {
+        return kh_val(map, wrapper.kh_get_from_map(map, kMer));
+    };
+    struct Piece {
+        size_t node;
+        bool reversed;
+        // Number of characters at the end which overlap the next piece.
+        size_t skip;
+    };
+    for (size_t begin = 0; begin < n; ++begin) {
+        if (used[begin]) continue;
+        use(begin);
+        std::deque<Piece> pieces {{begin, false, 0}};
+        kmer_t front = first[begin], back = last[begin];
+        int d_l = 1, d_r = 1;
+        while (d_l <= d_max || d_r <= d_max) {
+            if (d_r <= d_l) {
+                auto extension = starts.RightExtension(back, d_r);
+                if (extension.first == kmer_t(-1)) {
+                    ++d_r;
+                    continue;
+                }
+                size_t value = nodeOf(startMap, extension.second);
+                size_t node = value >> 1;
+                bool reversed = value & 1;
+                use(node);
+                pieces.back().skip = k - d_r;
+                pieces.push_back({node, reversed, 0});
+                back = reversed ? ReverseComplement(first[node], k) : last[node];
+                d_r = 1;
+            } else {
+                auto extension = endings.LeftExtension(front, d_l);
+                if (extension.first == kmer_t(-1)) {
+                    ++d_l;
+                    continue;
+                }
+                size_t value = nodeOf(endMap, extension.second);
+                size_t node = value >> 1;
+                bool reversed = value & 1;
+                use(node);
+                pieces.push_front({node, reversed, size_t(k - d_l)});
+                front = reversed ? ReverseComplement(last[node], k) : first[node];
+                d_l = 1;
+            }
+        }
+        for (auto &piece : pieces) {
+            size_t position = piece.node ? ends[piece.node - 1] : 0;
+            WriteMaskedPiece(of, superstring, position, ends[piece.node] - position, k, piece.reversed, piece.skip);
+        }
+    }
+    of.flush();
+}
+
+/// Get the approximated shortest superstring of the given k-mers using the local greedy algorithm with multiple threads.
+///
+/// The k-mers are partitioned by their minimizers, so that consecutive k-mers of the input mostly fall into the same partition.
+/// The threads take the partitions one by one and compute their generalized simplitigs, which are written to a temporary file
+/// and then joined serially by the local greedy with the given d_max on their first and last k-mers.
+/// The extensions are searched for in the same way as in Local in both steps.
+/// The result is the same for any number of threads, but it differs from (and is usually slightly longer than) the result of the serial Local.
+/// If complements are provided, treat k-mer and its complement as identical.
+/// If this is the case, k-mers are expected not to contain both k-mer and its complement.
+/// Warning: this will destroy kMers.
+template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+void LocalParallel(kh_S_t *kMers, kh_wrapper_t wrapper, kmer_t _, std::ostream& of, int k, int d_max, bool complements,
+                   int threads) {
+    std::vector<kmer_t> kMerVec = kMersToVec(kMers, _);
+    wrapper.kh_destroy_set(kMers);
+
+    // Distribute the k-mers into the partitions in their order.
+    int m = std::min(LOCAL_MINIMIZER_LENGTH, std::max(1, (k + 1) / 2));
+    std::vector<uint16_t> partitionOf(kMerVec.size());
+    ParallelFor(0, kMerVec.size(), threads, [&](size_t from, size_t to, int) {
+        for (size_t i = from; i < to; ++i) partitionOf[i] = MinimizerPartition(kMerVec[i], k, m, complements, LOCAL_PARTITION_COUNT);
+    });
+    std::vector<std::vector<kmer_t>> partitions(LOCAL_PARTITION_COUNT);
+    {
+        std::vector<size_t> counts(LOCAL_PARTITION_COUNT);
+        for (uint16_t partition : partitionOf) ++counts[partition];
+        for (size_t p = 0; p < LOCAL_PARTITION_COUNT; ++p) partitions[p].reserve(counts[p]);
+        for (size_t i = 0; i < kMerVec.size(); ++i) partitions[partitionOf[i]].push_back(kMerVec[i]);
+    }
+    std::vector<kmer_t>().swap(kMerVec);
+    std::vector<uint16_t>().swap(partitionOf);
+
+    // The threads take the next unprocessed partition until there are none.
+    PartitionSpill spill(LOCAL_PARTITION_COUNT);
+    std::vector<std::vector<size_t>> partitionEnds(LOCAL_PARTITION_COUNT);
+    std::atomic<size_t> nextPartition(0);
+    ParallelForEachThread(threads, [&](int) {
+        for (size_t p = nextPartition++; p < LOCAL_PARTITION_COUNT; p = nextPartition++) {
+            std::string superstring;
+            LocalGeneralizedSimplitigs(std::move(partitions[p]), wrapper, k, std::min(d_max, LOCAL_PARTITION_D_MAX), complements,
+                                       superstring, partitionEnds[p]);
+            spill.Add(p, std::move(superstring));
+        }
+    });
+
+    // The generalized simplitigs follow each other in the order of the partitions.
+    std::vector<size_t> ends;
+    for (size_t p = 0; p < LOCAL_PARTITION_COUNT; ++p) {
+        size_t offset = ends.empty() ? 0 : ends.back();
+        for (size_t end : partitionEnds[p]) ends.push_back(offset + end);
+        std::vector<size_t>().swap(partitionEnds[p]);
+    }
+    const char *superstring = spill.Map();
+    size_t n = ends.size();
+    WriteLog("Computed " + std::to_string(n) + " generalized simplitigs in " + std::to_string(LOCAL_PARTITION_COUNT) + " partitions.");
+
+    // Index the nodes by their first and last k-mers in both orientations.
+    std::vector<kmer_t> first(n), last(n);
+    std::vector<kmer_t> startKMers, endKMers;
+    auto startMap = wrapper.kh_init_map(), endMap = wrapper.kh_init_map();
+    auto add = [&](decltype(startMap) map, std::vector<kmer_t> &endpoints, kmer_t kMer, size_t value) {
+        int ret;
+        khint_t key = wrapper.kh_put_to_map(map, kMer, &ret);
+        if (!ret) return;
+        kh_val(map, key) = value;
+        endpoints.push_back(kMer);
+    };
+    for (size_t i = 0; i < n; ++i) {
+        size_t position = i ? ends[i - 1] : 0;
+        first[i] = KMerAt<kmer_t>(superstring, position, k);
+        last[i] = KMerAt<kmer_t>(superstring, ends[i] - k, k);
+        add(startMap, startKMers, first[i], i << 1);
+        add(endMap, endKMers, last[i], i << 1);
+        if (complements) {
+            add(startMap, startKMers, ReverseComplement(last[i], k), (i << 1) | 1);
+            add(endMap, endKMers, ReverseComplement(first[i], k), (i << 1) | 1);
+        }
+    }
+    if (d_max > MAX_PROBING_D) {
+        ExtensionIndex<kmer_t> starts(std::move(startKMers), k, false), endings(std::move(endKMers), k, false);
+        StitchGeneralizedSimplitigs(superstring, ends, first, last, starts, endings, startMap, endMap, wrapper, of, k, d_max, complements);
+    } else {
+        auto startSet = wrapper.kh_init_set(), endSet = wrapper.kh_init_set();
+        kMersFromVec(startSet, wrapper, startKMers);
+        kMersFromVec(endSet, wrapper, endKMers);
+        std::vector<kmer_t>().swap(startKMers);
+        std::vector<kmer_t>().swap(endKMers);
+        ProbingExtensions<kmer_t, std::remove_pointer_t<decltype(startSet)>, kh_wrapper_t> starts{startSet, wrapper, k, false}, endings{endSet, wrapper, k, false};
+        StitchGeneralizedSimplitigs(superstring, ends, first, last, starts, endings, startMap, endMap, wrapper, of, k, d_max, complements);
+        wrapper.kh_destroy_set(startSet);
+        wrapper.kh_destroy_set(endSet);
     }
+    wrapper.kh_destroy_map(startMap);
+    wrapper.kh_destroy_map(endMap);
 }
@@ -4,34 +4,46 @@
 #include "global_sparse.h"
 #include "kmers.h"
 
-/// Return the length of the cycle cover which lower bounds the superstring length.
-template <typename kmer_t, typename kh_wrapper_t>
-size_t LowerBoundLength(kh_wrapper_t wrapper, kmer_t kmer_type, std::vector<simplitig_t> simplitigs, int k, bool complements) {
-    auto cycle_cover = OverlapHamiltonianPath(wrapper, kmer_type, simplitigs, k, complements, true);
-    WriteLog("Finished 2. part: Hamiltonian path.");
+/// Return the length of the cycle cover with the given overlaps on nodes of the given total length.
+/// If complements are provided, the nodes include the reverse complements and the length is halved.
+template <typename length_t>
+size_t CycleCoverLength(size_t nodesLength, const std::vector<length_t> &overlaps, bool complements) {
+    size_t res = nodesLength;
+    for (auto &overlap : overlaps) {
+        res -= overlap;
+    }
+    return res / (1 + complements);
+}
+
+/// Return the total length of the simplitigs and, if complements are provided, of their reverse complements.
+inline size_t SimplitigsLength(const std::vector<simplitig_t> &simplitigs, bool complements) {
     size_t res = 0;
     for (auto &simplitig : simplitigs) {
         res += simplitig.size() / (2 - complements);
     }
-    for (auto &overlap : cycle_cover.second) {
-        res -= overlap;
-    }
-    res /= (1 + complements);
+    return res;
+}
+
+/// Return the length of the cycle cover which lower bounds the superstring length.
+template <typename kmer_t, typename kh_wrapper_t>
+size_t LowerBoundLength(kh_wrapper_t wrapper, kmer_t kmer_type, std::vector<simplitig_t> simplitigs, int k, bool complements,
+                        const OverlapOptions &options = OverlapOptions()) {
+    auto cycle_cover = OverlapHamiltonianPath(wrapper, kmer_type, simplitigs, k, complements, true, options);
+    WriteLog("Finished 2. part: Hamiltonian path.");
+    SaveOverlapPath(options, cycle_cover, simplitigs, k, complements, true);
+    size_t res = CycleCoverLength(SimplitigsLength(simplitigs, complements), cycle_cover.second, complements);
     WriteLog("Finished 3. part: lower bound = " + std::to_string(res) + ".");
     return res;
 }
 
-/// Same as LowerBoundLength for the k-mer overlap graph (as used by GlobalSparse / PartialPreSort).
+/// Same as LowerBoundLength for the k-mer overlap graph (as used by GlobalSparse).
 template <typename kmer_t, typename kh_wrapper_t>
-size_t LowerBoundLengthSparse(kh_wrapper_t wrapper, std::vector<kmer_t> &kMers, int k, bool complements) {
-    auto cycle_cover = OverlapHamiltonianPathSparse(wrapper, kMers, k, complements, true);
+size_t LowerBoundLengthSparse(kh_wrapper_t wrapper, std::vector<kmer_t> &kMers, int k, bool complements,
+                              const OverlapOptions &options = OverlapOptions()) {
+    auto cycle_cover = OverlapHamiltonianPathSparse(wrapper, kMers, k, complements, true, options);
     WriteLog("Finished 2. part: Hamiltonian path.");
-    size_t n = kMers.size();
-    size_t res = n * k * (1 + complements);
-    for (auto &overlap : cycle_cover.second) {
-        res -= overlap;
-    }
-    res /= (1 + complements);
+    SaveOverlapPath(options, cycle_cover, kMers, k, complements, true);
+    size_t res = CycleCoverLength(kMers.size() * k * (1 + complements), cycle_cover.second, complements);
     WriteLog("Finished 3. part: lower bound = " + std::to_string(res) + ".");
     return res;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <string>
 
 #include "unistd.h"
+#include "getopt.h"
 #include "version.h"
 #include "ac/global_ac.h"
 #include "global.h"
@@ -20,6 +21,8 @@
 #include "version.h"
 #include "masks.h"
 #include "lower_bound.h"
+#include "memory_plan.h"
+#include "cost_model.h"
 
 int usage() {
     std::cerr << std::endl;
@@ -35,6 +38,7 @@ int usage() {
     std::cerr << "    ms2spss    - Compute rSPSS from a masked superstring (may be of much larger total length)." << std::endl;
     std::cerr << "    spss2ms    - Compute masked superstring corresponding to (r)SPSS." << std::endl;
     std::cerr << "    lowerbound - Compute the lower bound on masked superstring size of a k-mer set." << std::endl;
+    std::cerr << "    render     - Compute the masked superstring or the lower bound from a path saved by compute or lowerbound." << std::endl;
     std::cerr << std::endl;
     return 1;
 }
@@ -44,13 +48,15 @@ int usage_subcommand(std::string subcommand) {
     std::cerr << "Usage:   kmercamel " << subcommand << " [options]";
     if (subcommand == "compute" || subcommand == "lowerbound" || subcommand == "spss2ms")
     std::cerr << " <fasta>";
+    else if (subcommand == "render")
+    std::cerr << " <path>";
     else if (subcommand != "mssep2ms")
     std::cerr << " <ms>";
 
     std::cerr  << std::endl << std::endl;
     std::cerr << "Options:" << std::endl;
-    if (subcommand != "mssep2ms" && subcommand != "ms2mssep")
-    std::cerr << "  -k INT   - k-mer size [required; up to 127]" << std::endl;
+    if (subcommand != "mssep2ms" && subcommand != "ms2mssep" && subcommand != "render")
+    std::cerr << "  -k INT   - k-mer size [required; up to 511]" << std::endl;
 
     if (subcommand == "compute")
     std::cerr << "  -a STR   - the algorithm to be run [greedy (default), streaming, local-greedy, greedy-ac (experimental), local-greedy-ac (experimental)]" << std::endl;
@@ -58,12 +64,23 @@ int usage_subcommand(std::string subcommand) {
     else if (subcommand == "maskopt")
     std::cerr << "  -t STR   - the target mask type to be run [max-one (default), min-one, min-run, approx-min-run]" << std::endl;
 
+    if (subcommand == "maskopt")
+    std::cerr << "  --threads INT - number of threads for max-one, min-one and min-run; default 1" << std::endl;
+
+    if (subcommand == "maskopt")
+    std::cerr << "  --stream - read the file again for each pass instead of keeping the superstring in memory (not with stdin)" << std::endl;
+
     if (subcommand != "lowerbound" && subcommand != "ms2mssep")
     std::cerr << "  -o FILE  - output for the (min-one) masked superstring; if not specified, printed to stdout" << std::endl;
     
     if (subcommand == "compute")
     std::cerr << "  -M FILE  - if given, print also ms with mask maximizing ones (only with greedy)" << std::endl;
 
+    if (subcommand == "render") {
+    std::cerr << "  -M FILE  - if given, print also ms with mask maximizing ones" << std::endl;
+    std::cerr << "  -t INT   - number of threads; default 1" << std::endl;
+    }
+
     
     if (subcommand == "compute" || subcommand == "lowerbound")
     std::cerr << "  -S       - optimize for the input being pre-computed simplitigs or unitigs (only with greedy)" << std::endl;
@@ -71,6 +88,37 @@ int usage_subcommand(std::string subcommand) {
     if (subcommand == "compute")
     std::cerr << "  -d INT   - d_max for local-greedy; default 5" << std::endl;
 
+    if (subcommand == "compute")
+    std::cerr << "  -t INT   - number of threads (not with streaming); default 1" << std::endl;
+    if (subcommand == "lowerbound")
+    std::cerr << "  -t INT   - number of threads; default 1" << std::endl;
+
+    if (subcommand == "compute" || subcommand == "lowerbound")
+    std::cerr << "  --max-memory SIZE - memory budget such as 16G to which the batching is adapted (only with greedy); by default, fixed batching" << std::endl;
+
+    if (subcommand == "compute")
+    std::cerr << "  --time-limit SECONDS - after this time, merge the remaining simplitigs without overlaps (only with greedy)" << std::endl;
+
+    if (subcommand == "compute" || subcommand == "lowerbound")
+    std::cerr << "  --save-path FILE - save the Hamiltonian path (the cycle cover for lowerbound) for render (only with greedy)" << std::endl;
+
+    if (subcommand == "compute") {
+    std::cerr << "  --checkpoint DIR - save the progress to the directory so that it can be resumed (only with greedy)" << std::endl;
+    std::cerr << "  --resume - resume the computation from the latest checkpoint in the directory given by --checkpoint" << std::endl;
+    }
+
+    if (subcommand == "compute" || subcommand == "lowerbound")
+    std::cerr << "  --engine STR - how greedy proceeds from the k-mers [auto (default), simplitig, sparse]; auto chooses by the predicted cost and memory" << std::endl;
+
+    if (subcommand == "compute")
+    std::cerr << "  --allow-streaming - let --engine auto fall back to streaming, which gives a longer superstring, if neither greedy engine fits --max-memory" << std::endl;
+
+    if (subcommand == "compute" || subcommand == "lowerbound")
+    std::cerr << "  --overlap-engine STR - how greedy finds the overlaps [hash (default), sort]; sort merges sorted prefixes and suffixes, which gives the same result but is not bounded by --max-memory" << std::endl;
+
+    if (subcommand == "compute")
+    std::cerr << "  --overlap-engine suffix-array - greedy-ac finds the overlaps by a suffix array instead of the automaton, which needs less memory for large k" << std::endl;
+
     if (subcommand == "compute" || subcommand == "maskopt" || subcommand == "lowerbound")
     std::cerr << "  -u       - treat k-mer and its reverse complement as distinct" << std::endl;
     
@@ -90,8 +138,21 @@ int usage_subcommand(std::string subcommand) {
     return 1;
 }
 
-constexpr int MAX_K = 127;
-constexpr int SIMPLITIG_RATIO_THRESHOLD = 5;
+constexpr int MAX_K = 511;
+
+/// Codes of the options which have only the long form.
+enum LongOption {
+    OPT_MAX_MEMORY = 256,
+    OPT_OVERLAP_ENGINE,
+    OPT_TIME_LIMIT,
+    OPT_CHECKPOINT,
+    OPT_RESUME,
+    OPT_SAVE_PATH,
+    OPT_ENGINE,
+    OPT_THREADS,
+    OPT_STREAM,
+    OPT_ALLOW_STREAMING,
+};
 
 // For backward compatibility
 static std::string normalize_compute_algorithm(const std::string &algorithm) {
@@ -118,18 +179,23 @@ void Version() {
     std::cerr << VERSION << std::endl;
 }
 
-/// Run KmerCamel with the given parameters.
+/// Optimize the mask of the masked superstring in the given file by the given number of threads.
+/// If stream is set, the file is read by blocks for each pass instead of whole.
 template <typename kmer_t, typename kh_wrapper_t>
-int kmercamel(kh_wrapper_t wrapper, kmer_t kmer_type, std::string path, int k, int d_max, std::ostream *of, std::ostream *maskf, bool complements, bool masks,
-                    std::string algorithm, bool lower_bound, bool assume_simplitigs, uint16_t min_frequency) {
-    if (masks) {
-        WriteLog("Started optimization of a masked superstring from '" + path + "'.");
-        int ret = Optimize(wrapper, kmer_type, algorithm, path, *of, k, complements);
-        if (ret) usage_subcommand("maskopt");
-        WriteLog("Finished optimization.");
-        return ret;
-    }
+int optimize(kh_wrapper_t wrapper, kmer_t kmer_type, std::string path, int k, std::ostream *of, bool complements,
+             std::string algorithm, int threads, bool stream) {
+    WriteLog("Started optimization of a masked superstring from '" + path + "'.");
+    int ret = Optimize(wrapper, kmer_type, algorithm, path, *of, k, complements, threads, stream);
+    if (ret) usage_subcommand("maskopt");
+    WriteLog("Finished optimization.");
+    return ret;
+}
 
+/// Run KmerCamel with the given parameters.
+template <typename kmer_t, typename kh_wrapper_t>
+int kmercamel(kh_wrapper_t wrapper, kmer_t kmer_type, std::string path, int k, int d_max, std::ostream *of, std::ostream *maskf, bool complements,
+                    std::string algorithm, bool lower_bound, bool assume_simplitigs, uint16_t min_frequency,
+                    const OverlapOptions &overlap_options, Engine engine = ENGINE_AUTO, bool allow_streaming = false) {
     if (!lower_bound) WriteLog("Started computation of a masked superstring from '" + path + "'.");
     else WriteLog("Started computation of a masked superstring length lower bound from '" + path + "'.");
 
@@ -143,9 +209,16 @@ int kmercamel(kh_wrapper_t wrapper, kmer_t kmer_type, std::string path, int k, i
     /* Handle hash table based algorithms separately so that they consume less memory. */
     else if (algorithm == "greedy" || algorithm == "local-greedy") {
 
+        Checkpoint *checkpoint = overlap_options.checkpoint;
+        CheckpointStage resumed = checkpoint != nullptr ? checkpoint->ResumeStage() : CHECKPOINT_NONE;
         auto *kMers = wrapper.kh_init_set();
-        size_t kmer_count;
-        if (!assume_simplitigs) {
+        size_t kmer_count = 0;
+        if (resumed == CHECKPOINT_KMERS) {
+            auto kMerVec = checkpoint->LoadKMers(kmer_type);
+            kMersFromVec(kMers, wrapper, kMerVec);
+            kmer_count = kh_size(kMers);
+            WriteLog("Resumed from the checkpoint of the k-mers: " + std::to_string(kmer_count) + " " + std::to_string(k) + "-mers.");
+        } else if (resumed == CHECKPOINT_NONE && !assume_simplitigs) {
             if (min_frequency == 1) {
                 ReadKMers(kMers, wrapper, kmer_type, path, k, complements);
             } else {
@@ -158,52 +231,104 @@ int kmercamel(kh_wrapper_t wrapper, kmer_t kmer_type, std::string path, int k, i
             }
             kmer_count = kh_size(kMers);
             WriteLog("Finished collecting k-mers: " + std::to_string(kmer_count) + " " + std::to_string(k) + "-mers.");
+            if (overlap_options.maxMemory && KMerSetBytes(kmer_type, kmer_count) > overlap_options.maxMemory) {
+                WriteLog("Warning: the k-mer set alone takes about " + FormatMemorySize(KMerSetBytes(kmer_type, kmer_count)) + ", which exceeds the memory budget.");
+            }
+            if (checkpoint != nullptr && algorithm == "greedy") checkpoint->SaveKMers(kMersToVec(kMers, kmer_type));
         }
         
+        if (algorithm == "greedy" && resumed <= CHECKPOINT_KMERS && !assume_simplitigs) {
+            // Streaming gives a different superstring, so it is used only if allowed explicitly. It also needs to read the input again
+            // and cannot output the max-one mask or save the progress.
+            bool streaming_allowed = allow_streaming && !lower_bound && path != "-" && maskf == nullptr && checkpoint == nullptr
+                    && overlap_options.savePath.empty();
+            engine = ChooseEngine(kMers, wrapper, kmer_type, k, complements, engine, overlap_options.maxMemory, streaming_allowed);
+        }
+        if (engine == ENGINE_STREAMING) {
+            wrapper.kh_destroy_set(kMers);
+            WriteName(path, "streaming", k, false, !complements, *of);
+            if (min_frequency == 1) Streaming(wrapper, kmer_type, path, *of,  k , complements);
+            else StreamingFiltered(wrapper, kmer_type, path, *of,  k , complements, min_frequency);
+            WriteLog("Finished masked superstring computation.");
+            *of << std::endl;
+            return 0;
+        }
+
         d_max = std::min(k - 1, d_max);
         if (!lower_bound) WriteName(path, algorithm, k, false, !complements, *of);
         if (maskf != nullptr) WriteName(path, algorithm, k, true, !complements, *maskf);
         if (algorithm == "greedy") {
             std::vector<simplitig_t> simplitigs;
-            if (!assume_simplitigs) {
-                simplitigs = get_simplitigs(kMers, wrapper, kmer_type, k, complements);
-                wrapper.kh_destroy_set(kMers);
-            } else {
+            std::vector<kmer_t> kMerVec;
+            bool sparse = resumed == CHECKPOINT_KMER_VECTOR || (resumed == CHECKPOINT_OVERLAP && checkpoint->NodesAreKMers());
+            if (sparse) {
+                kMerVec = checkpoint->LoadKMers(kmer_type);
+                WriteLog("Resumed from the checkpoint of the nodes: " + std::to_string(kMerVec.size()) + " k-mers.");
+            } else if (resumed >= CHECKPOINT_SIMPLITIGS) {
+                simplitigs = checkpoint->LoadSimplitigs();
+                WriteLog("Resumed from the checkpoint of the nodes: " + std::to_string(simplitigs.size()) + " simplitigs.");
+            } else if (assume_simplitigs) {
                 simplitigs = simplitigs_from_fasta(path);
+            } else if (engine == ENGINE_SPARSE) {
+                WriteLog("Computing directly from k-mers.");
+                kMerVec = kMersToVec(kMers, kmer_type);
+                sparse = true;
+            } else {
+                simplitigs = get_simplitigs(kMers, wrapper, kmer_type, k, complements);
+            }
+            wrapper.kh_destroy_set(kMers);
+            if (!sparse) WriteLog("Finished 1. part: simplitigs (" + std::to_string(simplitigs.size()) + " simplitigs).");
+            if (assume_simplitigs && engine == ENGINE_SPARSE) {
+                WriteLog("Computing directly from the k-mers of the simplitigs.");
+                for (auto &simplitig : simplitigs) kmer_count += kmers_in_simplitig(simplitig, k);
+                kMerVec = simplitigs_to_kmer_vec(kmer_type, simplitigs, k, kmer_count);
+                simplitigs.clear();
+                sparse = true;
+            }
+            if (sparse && resumed < CHECKPOINT_KMER_VECTOR) {
+               // Sorting the k-mers keeps the k-mers with the same prefix close together for the prefix map.
+               RadixSortKMers(kMerVec, k, overlap_options.threads);
+               if (checkpoint != nullptr) checkpoint->SaveKMerVector(kMerVec);
+            } else if (!sparse && checkpoint != nullptr && resumed < CHECKPOINT_SIMPLITIGS) {
+                checkpoint->SaveSimplitigs(simplitigs);
             }
-            WriteLog("Finished 1. part: simplitigs (" + std::to_string(simplitigs.size()) + " simplitigs).");
-            if (!assume_simplitigs && simplitigs.size() * SIMPLITIG_RATIO_THRESHOLD >= kmer_count) {
-               WriteLog("2. part: Number of simplitigs over threshold, computing directly from k-mers.");
-               auto kMerVec = simplitigs_to_kmer_vec(kmer_type, simplitigs, k, kmer_count);
-               PartialPreSort(kMerVec, k);
-               if (!lower_bound) GlobalSparse(wrapper, kMerVec, *of, maskf, k, complements);
-               else std::cout << LowerBoundLengthSparse(wrapper, kMerVec, k, complements);
+            if (sparse) {
+               if (!lower_bound) GlobalSparse(wrapper, kMerVec, *of, maskf, k, complements, overlap_options);
+               else std::cout << LowerBoundLengthSparse(wrapper, kMerVec, k, complements, overlap_options);
             }
-            else if (lower_bound) std::cout << LowerBoundLength(wrapper, kmer_type, simplitigs, k, complements);
-            else Global(wrapper, kmer_type, simplitigs, *of, maskf, k, complements);
+            else if (lower_bound) std::cout << LowerBoundLength(wrapper, kmer_type, simplitigs, k, complements, overlap_options);
+            else Global(wrapper, kmer_type, simplitigs, *of, maskf, k, complements, overlap_options);
+            // The checkpoint of the nodes refers to them until it is written.
+            if (checkpoint != nullptr) checkpoint->Wait();
         } else {
-            Local(kMers, wrapper, kmer_type, *of, k, d_max, complements);
+            if (overlap_options.threads > 1) LocalParallel(kMers, wrapper, kmer_type, *of, k, d_max, complements, overlap_options.threads);
+            else Local(kMers, wrapper, kmer_type, *of, k, d_max, complements);
             WriteLog("Finished masked superstring computation.");
         }
     } else {
-        auto data = ReadFasta(path);
-        if (data.empty()) {
-            std::cerr << "Path '" << path << "' not to a fasta file." << std::endl;
+        auto kMers = ReadPackedKMers(path, k, complements);
+        if (!kMers.Size()) {
+            std::cerr << "Path '" << path << "' not to a fasta file with any " << k << "-mers." << std::endl;
             return usage_subcommand("compute");
         }
+        WriteLog("Finished collecting k-mers: " + std::to_string(kMers.Size()) + " " + std::to_string(k) + "-mers.");
         d_max = std::min(k - 1, d_max);
 
-        auto kMers = ConstructKMers(data, k, complements);
         WriteName(path, algorithm, k, false, !complements, *of);
-        if (algorithm == "greedy-ac") {
-            GlobalAC(kMers, *of, complements);
-        }
-        else if (algorithm == "local-greedy-ac") {
-            LocalAC(kMers, *of, k, d_max, complements);
-        }
-        else {
-            std::cerr << "Algorithm '" << algorithm << "' not supported." << std::endl;
-            return usage_subcommand("compute");
+        try {
+            if (algorithm == "greedy-ac") {
+                GlobalAC(kMers, *of, complements, overlap_options.threads, overlap_options.suffixArray);
+            }
+            else if (algorithm == "local-greedy-ac") {
+                LocalAC(kMers, *of, k, d_max, complements, overlap_options.threads);
+            }
+            else {
+                std::cerr << "Algorithm '" << algorithm << "' not supported." << std::endl;
+                return usage_subcommand("compute");
+            }
+        } catch (std::length_error &e) {
+            std::cerr << "The input is too large: " << e.what() << "." << std::endl;
+            return 1;
         }
         WriteLog("Finished masked superstring computation.");
     }
@@ -230,8 +355,27 @@ int camel_compute(int argc, char **argv) {
     bool assume_simplitigs = false;
     int opt;
     uint16_t min_frequency = 1;
+    OverlapOptions overlap_options;
+    bool threads_set = false;
+    std::string overlap_engine = "hash";
+    Engine engine = ENGINE_AUTO;
+    double time_limit = 0;
+    std::string checkpoint_directory;
+    bool resume = false;
+    bool allow_streaming = false;
+    static struct option long_options[] = {
+        {"max-memory", required_argument, nullptr, OPT_MAX_MEMORY},
+        {"overlap-engine", required_argument, nullptr, OPT_OVERLAP_ENGINE},
+        {"time-limit", required_argument, nullptr, OPT_TIME_LIMIT},
+        {"checkpoint", required_argument, nullptr, OPT_CHECKPOINT},
+        {"resume", no_argument, nullptr, OPT_RESUME},
+        {"save-path", required_argument, nullptr, OPT_SAVE_PATH},
+        {"engine", required_argument, nullptr, OPT_ENGINE},
+        {"allow-streaming", no_argument, nullptr, OPT_ALLOW_STREAMING},
+        {nullptr, 0, nullptr, 0},
+    };
     try {
-        while ((opt = getopt(argc, argv, "k:d:a:o:huxM:Sz:"))  != -1) {
+        while ((opt = getopt_long(argc, argv, "k:d:a:o:huxM:Sz:t:", long_options, nullptr))  != -1) {
             switch(opt) {
                 case 'o':
                     output.open(optarg);
@@ -266,6 +410,35 @@ int camel_compute(int argc, char **argv) {
                 case 'z':
                     min_frequency = std::stoi(optarg);
                     break;
+                case 't':
+                    threads_set = true;
+                    overlap_options.threads = std::stoi(optarg);
+                    break;
+                case OPT_MAX_MEMORY:
+                    overlap_options.maxMemory = ParseMemorySize(optarg);
+                    break;
+                case OPT_OVERLAP_ENGINE:
+                    overlap_engine = optarg;
+                    break;
+                case OPT_SAVE_PATH:
+                    overlap_options.savePath = optarg;
+                    break;
+                case OPT_ENGINE:
+                    engine = ParseEngine(optarg);
+                    break;
+                case OPT_TIME_LIMIT:
+                    time_limit = std::stod(optarg);
+                    if (time_limit <= 0) throw std::invalid_argument("time limit must be positive");
+                    break;
+                case OPT_CHECKPOINT:
+                    checkpoint_directory = optarg;
+                    break;
+                case OPT_RESUME:
+                    resume = true;
+                    break;
+                case OPT_ALLOW_STREAMING:
+                    allow_streaming = true;
+                    break;
                 default:
                     return usage_subcommand(subcommand);
             }
@@ -305,13 +478,72 @@ int camel_compute(int argc, char **argv) {
     } else if (min_frequency != 1 && assume_simplitigs) {
         std::cerr << "Inputting simplitigs is not compatible with frequency filterring." << std::endl;
         return usage_subcommand(subcommand); 
+    } else if (overlap_options.threads < 1) {
+        std::cerr << "Number of threads '-t' must be positive." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (threads_set && algorithm == "streaming") {
+        std::cerr << "Unsupported argument t for algorithm '" + algorithm + "'." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (overlap_options.maxMemory && algorithm != "greedy") {
+        std::cerr << "Unsupported argument max-memory for algorithm '" + algorithm + "'." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (overlap_engine != "hash" && overlap_engine != "sort" && overlap_engine != "suffix-array") {
+        std::cerr << "Unknown overlap engine '" + overlap_engine + "'." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (overlap_engine != "hash" && algorithm != (overlap_engine == "suffix-array" ? "greedy-ac" : "greedy")) {
+        std::cerr << "Unsupported argument overlap-engine for algorithm '" + algorithm + "'." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (time_limit && algorithm != "greedy") {
+        std::cerr << "Unsupported argument time-limit for algorithm '" + algorithm + "'." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (!checkpoint_directory.empty() && algorithm != "greedy") {
+        std::cerr << "Unsupported argument checkpoint for algorithm '" + algorithm + "'." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (resume && checkpoint_directory.empty()) {
+        std::cerr << "Resuming requires the checkpoint directory to be set." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (!overlap_options.savePath.empty() && algorithm != "greedy") {
+        std::cerr << "Unsupported argument save-path for algorithm '" + algorithm + "'." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (engine != ENGINE_AUTO && algorithm != "greedy") {
+        std::cerr << "Unsupported argument engine for algorithm '" + algorithm + "'." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (allow_streaming && (algorithm != "greedy" || engine != ENGINE_AUTO)) {
+        std::cerr << "The argument allow-streaming is supported only with greedy and --engine auto." << std::endl;
+        return usage_subcommand(subcommand);
+    }
+    overlap_options.sortMerge = overlap_engine == "sort";
+    overlap_options.suffixArray = overlap_engine == "suffix-array";
+    overlap_options.dataset = path;
+    if (time_limit) {
+        // The time limit counts from the start, so that it also covers reading the k-mers and computing simplitigs.
+        overlap_options.deadline = std::chrono::steady_clock::now()
+                + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_limit));
+    }
+    std::unique_ptr<Checkpoint> checkpoint;
+    if (!checkpoint_directory.empty()) {
+        // The checkpoints can be used only with the same input and the parameters which determine the nodes.
+        std::string parameters = "k=" + std::to_string(k) + " u=" + std::to_string(!complements)
+                + " S=" + std::to_string(assume_simplitigs) + " z=" + std::to_string(min_frequency);
+        try {
+            checkpoint = std::make_unique<Checkpoint>(checkpoint_directory, CheckpointFingerprint(path, parameters), resume);
+        } catch (std::runtime_error &e) {
+            std::cerr << "Cannot use the checkpoints: " << e.what() << "." << std::endl;
+            return 1;
+        }
+        if (resume && checkpoint->ResumeStage() == CHECKPOINT_NONE) WriteLog("No checkpoint to resume from, starting from the beginning.");
+        overlap_options.checkpoint = checkpoint.get();
     }
     if (k < 32) {
-        return kmercamel(kmer_dict64_t(), kmer64_t(0), path, k, d_max, of, maskf, complements, false, algorithm, false, assume_simplitigs, min_frequency);
+        return kmercamel(kmer_dict64_t(), kmer64_t(0), path, k, d_max, of, maskf, complements, algorithm, false, assume_simplitigs, min_frequency, overlap_options, engine, allow_streaming);
     } else if (k < 64) {
-        return kmercamel(kmer_dict128_t(), kmer128_t(0), path, k, d_max, of, maskf, complements, false, algorithm, false, assume_simplitigs, min_frequency);
+        return kmercamel(kmer_dict128_t(), kmer128_t(0), path, k, d_max, of, maskf, complements, algorithm, false, assume_simplitigs, min_frequency, overlap_options, engine, allow_streaming);
+    } else if (k < 128) {
+        return kmercamel(kmer_dict256_t(), kmer256_t(0), path, k, d_max, of, maskf, complements, algorithm, false, assume_simplitigs, min_frequency, overlap_options, engine, allow_streaming);
+    } else if (k < 256) {
+        return kmercamel(kmer_dict512_t(), kmer512_t(0), path, k, d_max, of, maskf, complements, algorithm, false, assume_simplitigs, min_frequency, overlap_options, engine, allow_streaming);
     } else {
-        return kmercamel(kmer_dict256_t(), kmer256_t(0), path, k, d_max, of, maskf, complements, false, algorithm, false, assume_simplitigs, min_frequency);
+        return kmercamel(kmer_dict1024_t(), kmer1024_t(0), path, k, d_max, of, maskf, complements, algorithm, false, assume_simplitigs, min_frequency, overlap_options, engine, allow_streaming);
     }
 }
 
@@ -327,9 +559,16 @@ int camel_optimize(int argc, char **argv) {
     std::ostream *of = &std::cout;
     std::string algorithm = "max-one";
     bool complements = true;
+    int threads = 1;
+    bool stream = false;
+    static struct option long_options[] = {
+        {"threads", required_argument, nullptr, OPT_THREADS},
+        {"stream", no_argument, nullptr, OPT_STREAM},
+        {nullptr, 0, nullptr, 0},
+    };
     int opt;
     try {
-        while ((opt = getopt(argc, argv, "k:t:o:hu"))  != -1) {
+        while ((opt = getopt_long(argc, argv, "k:t:o:hu", long_options, nullptr))  != -1) {
             switch(opt) {
                 case 'o':
                     output.open(optarg);
@@ -341,6 +580,12 @@ int camel_optimize(int argc, char **argv) {
                 case  't':
                     algorithm = optarg;
                     break;
+                case OPT_THREADS:
+                    threads = std::stoi(optarg);
+                    break;
+                case OPT_STREAM:
+                    stream = true;
+                    break;
                 case  'u':
                     complements = false;
                     break;
@@ -365,13 +610,29 @@ int camel_optimize(int argc, char **argv) {
     } else if (k < 0) {
         std::cerr << "k must be positive." << std::endl;
         return usage_subcommand(subcommand);
+    } else if (k > MAX_K) {
+        std::cerr << "k > " << MAX_K << " not supported." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (threads < 1) {
+        std::cerr << "Number of threads '--threads' must be positive." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (stream && path == "-") {
+        std::cerr << "Streaming '--stream' needs a file to be read repeatedly, not stdin." << std::endl;
+        return usage_subcommand(subcommand);
     }
     if (k < 32) {
-        return kmercamel(kmer_dict64_t(), kmer64_t(0), path, k, 0, of, nullptr, complements, true, algorithm, false, false, 1);
+        return optimize(kmer_dict64_t(), kmer64_t(0), path, k, of, complements, algorithm, threads, stream);
     } else if (k < 64) {
-        return kmercamel(kmer_dict128_t(), kmer128_t(0), path, k, 0, of, nullptr, complements, true, algorithm, false, false, 1);
+        return optimize(kmer_dict128_t(), kmer128_t(0), path, k, of, complements, algorithm, threads, stream);
+    } else if (k < 128) {
+        return optimize(kmer_dict256_t(), kmer256_t(0), path, k, of, complements, algorithm, threads, stream);
+    } else if (k < 256) {
+        return optimize(kmer_dict512_t(), kmer512_t(0), path, k, of, complements, algorithm, threads, stream);
+    } else if (k < 512) {
+        return optimize(kmer_dict1024_t(), kmer1024_t(0), path, k, of, complements, algorithm, threads, stream);
     } else {
-        return kmercamel(kmer_dict256_t(), kmer256_t(0), path, k, 0, of, nullptr, complements, true, algorithm, false, false, 1);
+        std::cerr << "k > " << MAX_K << " not supported." << std::endl;
+        return usage_subcommand(subcommand);
     }
 }
 
@@ -387,9 +648,19 @@ int camel_lowerbound(int argc, char **argv) {
     bool complements = true;
     bool assume_simplitigs = false;
     uint16_t min_frequency = 1;
+    OverlapOptions overlap_options;
+    std::string overlap_engine = "hash";
+    Engine engine = ENGINE_AUTO;
+    static struct option long_options[] = {
+        {"max-memory", required_argument, nullptr, OPT_MAX_MEMORY},
+        {"overlap-engine", required_argument, nullptr, OPT_OVERLAP_ENGINE},
+        {"save-path", required_argument, nullptr, OPT_SAVE_PATH},
+        {"engine", required_argument, nullptr, OPT_ENGINE},
+        {nullptr, 0, nullptr, 0},
+    };
     int opt;
     try {
-        while ((opt = getopt(argc, argv, "k:huxSz:"))  != -1) {
+        while ((opt = getopt_long(argc, argv, "k:huxSz:t:", long_options, nullptr))  != -1) {
             switch(opt) {
                 case  'k':
                     k = std::stoi(optarg);
@@ -409,6 +680,21 @@ int camel_lowerbound(int argc, char **argv) {
                 case 'z':
                     min_frequency = std::stoi(optarg);
                     break;
+                case 't':
+                    overlap_options.threads = std::stoi(optarg);
+                    break;
+                case OPT_MAX_MEMORY:
+                    overlap_options.maxMemory = ParseMemorySize(optarg);
+                    break;
+                case OPT_OVERLAP_ENGINE:
+                    overlap_engine = optarg;
+                    break;
+                case OPT_SAVE_PATH:
+                    overlap_options.savePath = optarg;
+                    break;
+                case OPT_ENGINE:
+                    engine = ParseEngine(optarg);
+                    break;
                 default:
                     return usage_subcommand(subcommand);
             }
@@ -426,19 +712,37 @@ int camel_lowerbound(int argc, char **argv) {
     } else if (k < 0) {
         std::cerr << "k must be positive." << std::endl;
         return usage_subcommand(subcommand);
+    } else if (k > MAX_K) {
+        std::cerr << "k > " << MAX_K << " not supported." << std::endl;
+        return usage_subcommand(subcommand);
     } else if (min_frequency >= 256 || min_frequency < 1) {
         std::cerr << "Minimum frequency '-z' must be between 1 and 255." << std::endl;
         return usage_subcommand(subcommand);
     } else if (min_frequency != 1 && assume_simplitigs) {
         std::cerr << "Inputting simplitigs is not compatible with frequency filterring." << std::endl;
         return usage_subcommand(subcommand);
+    } else if (overlap_options.threads < 1) {
+        std::cerr << "Number of threads '-t' must be positive." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (overlap_engine != "hash" && overlap_engine != "sort") {
+        std::cerr << "Unknown overlap engine '" + overlap_engine + "'." << std::endl;
+        return usage_subcommand(subcommand);
     }
+    overlap_options.sortMerge = overlap_engine == "sort";
+    overlap_options.dataset = path;
     if (k < 32) {
-        return kmercamel(kmer_dict64_t(), kmer64_t(0), path, k, 0, of, nullptr, complements, false, "greedy", true, assume_simplitigs, min_frequency);
+        return kmercamel(kmer_dict64_t(), kmer64_t(0), path, k, 0, of, nullptr, complements, "greedy", true, assume_simplitigs, min_frequency, overlap_options, engine);
     } else if (k < 64) {
-        return kmercamel(kmer_dict128_t(), kmer128_t(0), path, k, 0, of, nullptr, complements, false, "greedy", true, assume_simplitigs, min_frequency);
+        return kmercamel(kmer_dict128_t(), kmer128_t(0), path, k, 0, of, nullptr, complements, "greedy", true, assume_simplitigs, min_frequency, overlap_options, engine);
+    } else if (k < 128) {
+        return kmercamel(kmer_dict256_t(), kmer256_t(0), path, k, 0, of, nullptr, complements, "greedy", true, assume_simplitigs, min_frequency, overlap_options, engine);
+    } else if (k < 256) {
+        return kmercamel(kmer_dict512_t(), kmer512_t(0), path, k, 0, of, nullptr, complements, "greedy", true, assume_simplitigs, min_frequency, overlap_options, engine);
+    } else if (k < 512) {
+        return kmercamel(kmer_dict1024_t(), kmer1024_t(0), path, k, 0, of, nullptr, complements, "greedy", true, assume_simplitigs, min_frequency, overlap_options, engine);
     } else {
-        return kmercamel(kmer_dict256_t(), kmer256_t(0), path, k, 0, of, nullptr, complements, false, "greedy", true, assume_simplitigs, min_frequency);
+        std::cerr << "k > " << MAX_K << " not supported." << std::endl;
+        return usage_subcommand(subcommand);
     }
 }
 
@@ -666,6 +970,111 @@ int camel_spss_to_ms(int argc, char **argv) {
     return 0;
 }
 
+/// Print the masked superstring, or the lower bound if it is a cycle cover, from the given path file.
+template <typename kmer_t, typename kh_wrapper_t>
+int render(kh_wrapper_t wrapper, kmer_t kmer_type, const MappedCheckpoint &file, std::ostream *of, std::ostream *maskf, int threads) {
+    const CheckpointHeader &header = file.Header();
+    int k = header.k;
+    bool complements = header.complements;
+    if (header.overlapBytes != sizeof(overlap_t<kmer_t>)) {
+        std::cerr << "The overlap lengths of the path do not match k." << std::endl;
+        return 1;
+    }
+    overlapPath<kmer_t> path = {file.LoadSection<size_t>(PATH_EDGES), file.LoadSection<overlap_t<kmer_t>>(PATH_OVERLAPS)};
+    std::string dataset(file.Section<char>(PATH_DATASET), file.SectionSize<char>(PATH_DATASET));
+    std::vector<kmer_t> kMers;
+    std::vector<simplitig_t> simplitigs;
+    if (header.kMerNodes) kMers = file.LoadSection<kmer_t>(PATH_NODES);
+    else simplitigs = LoadSimplitigsSections(file, PATH_NODES);
+    size_t nodes = header.kMerNodes ? kMers.size() : simplitigs.size();
+    if (path.first.size() != nodes * (1 + complements) || path.second.size() != path.first.size()) {
+        std::cerr << "The path does not match its nodes." << std::endl;
+        return 1;
+    }
+    WriteLog("Loaded the " + std::string(header.cycleCover ? "cycle cover" : "Hamiltonian path") + " on " + std::to_string(nodes)
+             + (header.kMerNodes ? " k-mers." : " simplitigs."));
+    if (header.cycleCover) {
+        size_t nodesLength = header.kMerNodes ? kMers.size() * k * (1 + complements) : SimplitigsLength(simplitigs, complements);
+        size_t res = CycleCoverLength(nodesLength, path.second, complements);
+        WriteLog("Finished: lower bound = " + std::to_string(res) + ".");
+        std::cout << res << std::endl;
+        return 0;
+    }
+    WriteName(dataset, "greedy", k, false, !complements, *of);
+    if (maskf != nullptr) WriteName(dataset, "greedy", k, true, !complements, *maskf);
+    size_t length;
+    if (header.kMerNodes) length = SuperstringFromPathSparse(wrapper, path, kMers, *of, maskf, k, complements, threads);
+    else length = SuperstringFromPath(wrapper, kmer_type, path, simplitigs, *of, maskf, k, complements, threads);
+    WriteLog("Finished: masked superstring (l=" + std::to_string(length) + ").");
+    *of << std::endl;
+    return 0;
+}
+
+int camel_render(int argc, char **argv) {
+    std::string subcommand = "render";
+    std::string path;
+    if (argc > 1 && std::string(argv[argc - 1]) != "-h") {
+        path = argv[argc - 1];
+        argc--;
+    }
+    std::ofstream output;
+    std::ostream *of = &std::cout;
+    std::ofstream maskOutput;
+    std::ostream *maskf = nullptr;
+    int threads = 1;
+    int opt;
+    try {
+        while ((opt = getopt(argc, argv, "o:M:t:h"))  != -1) {
+            switch(opt) {
+                case 'o':
+                    output.open(optarg);
+                    of = &output;
+                    break;
+                case 'M':
+                    maskOutput.open(optarg);
+                    maskf = &maskOutput;
+                    break;
+                case 't':
+                    threads = std::stoi(optarg);
+                    break;
+                case 'h':
+                    usage_subcommand(subcommand);
+                    return 0;
+                default:
+                    return usage_subcommand(subcommand);
+            }
+        }
+    } catch (std::invalid_argument&) {
+        return usage_subcommand(subcommand);
+    }
+    if (path.empty()) {
+        std::cerr << "Required positional parameter path to the file not set." << std::endl;
+        return usage_subcommand(subcommand);
+    } else if (threads < 1) {
+        std::cerr << "Number of threads '-t' must be positive." << std::endl;
+        return usage_subcommand(subcommand);
+    }
+    MappedCheckpoint file;
+    if (!file.Map(path, 0) || file.Header().stage != CHECKPOINT_PATH || file.Header().k <= 0 || file.Header().k > MAX_K
+            || file.Header().sectionCount != PATH_NODES + 2 - file.Header().kMerNodes) {
+        std::cerr << "Path '" << path << "' is not a path saved by --save-path." << std::endl;
+        return usage_subcommand(subcommand);
+    }
+    WriteLog("Started rendering the path from '" + path + "'.");
+    int k = file.Header().k;
+    if (k < 32) {
+        return render(kmer_dict64_t(), kmer64_t(0), file, of, maskf, threads);
+    } else if (k < 64) {
+        return render(kmer_dict128_t(), kmer128_t(0), file, of, maskf, threads);
+    } else if (k < 128) {
+        return render(kmer_dict256_t(), kmer256_t(0), file, of, maskf, threads);
+    } else if (k < 256) {
+        return render(kmer_dict512_t(), kmer512_t(0), file, of, maskf, threads);
+    } else {
+        return render(kmer_dict1024_t(), kmer1024_t(0), file, of, maskf, threads);
+    }
+}
+
 int main(int argc, char **argv) {
     if (argc == 1 || std::string(argv[1]) == "-h") {
         usage();
@@ -684,6 +1093,8 @@ int main(int argc, char **argv) {
         return camel_ms_to_spss(argc - 1, argv + 1);
     } else if (std::string(argv[1]) == "spss2ms") {
         return camel_spss_to_ms(argc - 1, argv + 1);
+    } else if (std::string(argv[1]) == "render") {
+        return camel_render(argc - 1, argv + 1);
     } else {
         std::cerr << "Command '" << argv[1] << "' not recognized." << std::endl;
         return usage(); 
@@ -2,11 +2,16 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <numeric>
 #include <glpk.h>
 
 #include "parser.h"
 #include "khash_utils.h"
 #include "kmers.h"
+#include "parallel.h"
 
 /// Print a warning to stderr if the mask after optimization violates the mask convention
 /// (i.e., if there are more than k-1 last characters OFF).
@@ -36,54 +41,113 @@ void ReprintSequenceHeader(kseq_t* masked_superstring, std::string algorithm, st
     of << std::endl;
 }
 
+/// Maximum number of characters of the masked superstring which are optimized in memory before they are written.
+constexpr size_t MASK_BUFFER_SIZE = 1 << 24;
+
 /// For the given masked superstring output the same superstring with mask with minimal/maximal number of ones.
-template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
-void OptimizeOnes(kseq_t* masked_superstring, std::ostream &of, kh_S_t *kMers, kh_wrapper_t wrapper,
+/// The superstring is optimized by blocks of bufferSize k-mers from SuperstringRecord or SuperstringStream,
+/// each of which is split among the threads; a thread starts from the k-mer at the beginning of its chunk, so the chunks are independent.
+/// When minimizing, a single thread erases the k-mers once set; with more threads, the first occurrence of each k-mer
+/// is computed beforehand as an atomic minimum over the slots of the k-mer set, so that the output does not depend on the number of threads.
+template <typename superstring_t, typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+void OptimizeOnes(superstring_t &superstring, std::ostream &of, kh_S_t *kMers, kh_wrapper_t wrapper,
                   [[maybe_unused]] kmer_t _, int k,
-                  bool complements, bool minimize) {
-    kmer_t currentKMer = 0, reverseComplement = 0;
+                  bool complements, bool minimize, int threads = 1, size_t bufferSize = MASK_BUFFER_SIZE) {
     kmer_t mask = ((kmer_t(1)) << (2 * k)) - 1;
     kmer_t shift = 2 * (k - 1);
-    ReprintSequenceHeader(masked_superstring, minimize ? "min-one" : "max-one", of);
-    uint8_t ms_validation = 0;
-    for (size_t i = 0; i < masked_superstring->seq.l; ++i) {
-        auto data = nucleotideToInt[(uint8_t) masked_superstring->seq.s[i]];
-        ms_validation |= data;
-        currentKMer = ((currentKMer << 2) | data) & mask;
-        reverseComplement = (reverseComplement >> 2) | ((kmer_t(3 ^ data)) << shift);
-        if (i >= (size_t)k - 1) {
-            kmer_t canonical = ((!complements) || currentKMer < reverseComplement) ? currentKMer : reverseComplement;
-            auto kmer_pointer = wrapper.kh_get_from_set(kMers, canonical);
-            bool contained = kmer_pointer != kh_end(kMers);
-            of << Masked(masked_superstring->seq.s[i - k + 1], contained);
-            // If minimizing, erase the k-mer once set.
-            if (minimize && contained) {
-                wrapper.kh_del_from_set(kMers, kmer_pointer);
-            }
-            // Print a warning if the mask convention is violated.
-            if (i == masked_superstring->seq.l - 1 && !contained) {
-                PrintMaskConventionWarning();
+    threads = std::max(threads, 1);
+    std::vector<uint8_t> ms_validation(threads, 0);
+    // Return the number of the k-mers starting in the given block.
+    auto blockKMers = [&](size_t length) { return length >= (size_t)k ? std::min(bufferSize, length - k + 1) : 0; };
+    // Call f(position, slot) for the k-mers starting at the positions [from, to) of the block with their slots in the set, or kh_end if not contained.
+    auto forEachKMer = [&](const char *block, size_t from, size_t to, int thread, auto f) {
+        // A block shorter than k has no k-mers and its window would reach past its end.
+        if (from >= to) return;
+        kmer_t currentKMer = 0, reverseComplement = 0;
+        for (size_t i = from; i < to + k - 1; ++i) {
+            auto data = nucleotideToInt[(uint8_t) block[i]];
+            ms_validation[thread] |= data;
+            currentKMer = ((currentKMer << 2) | data) & mask;
+            reverseComplement = (reverseComplement >> 2) | ((kmer_t(3 ^ data)) << shift);
+            if (i >= from + k - 1) {
+                kmer_t canonical = ((!complements) || currentKMer < reverseComplement) ? currentKMer : reverseComplement;
+                f(i - k + 1, wrapper.kh_get_from_set(kMers, canonical));
             }
         }
+    };
+
+    bool precomputeFirst = minimize && threads > 1;
+    std::vector<std::atomic<size_t>> firstOccurrence(precomputeFirst ? kh_end(kMers) : 0);
+    if (precomputeFirst) {
+        ParallelFor(0, firstOccurrence.size(), threads, [&](size_t from, size_t to, int) {
+            for (size_t slot = from; slot < to; ++slot) firstOccurrence[slot].store(SIZE_MAX, std::memory_order_relaxed);
+        });
+        superstring.ForEachBlock(k - 1, bufferSize, [&](const char *block, size_t length, size_t offset, bool) {
+            ParallelFor(0, blockKMers(length), threads, [&](size_t from, size_t to, int thread) {
+                forEachKMer(block, from, to, thread, [&](size_t position, khint_t slot) {
+                    if (slot == kh_end(kMers)) return;
+                    size_t current = firstOccurrence[slot].load(std::memory_order_relaxed);
+                    while (offset + position < current
+                           && !firstOccurrence[slot].compare_exchange_weak(current, offset + position, std::memory_order_relaxed));
+                });
+            });
+        });
     }
-    // Print the remaining k-1 characters.
-    for (size_t i = masked_superstring->seq.l - k + 1; i < masked_superstring->seq.l; ++i) {
-        of << Masked(masked_superstring->seq.s[i], false);
-    }
+
+    ReprintSequenceHeader(superstring.record, minimize ? "min-one" : "max-one", of);
+    bool lastSet = true;
+    std::string buffer;
+    superstring.ForEachBlock(k - 1, bufferSize, [&](const char *block, size_t length, size_t offset, bool last) {
+        size_t kMerCount = blockKMers(length);
+        buffer.resize(kMerCount);
+        ParallelFor(0, kMerCount, threads, [&](size_t from, size_t to, int thread) {
+            forEachKMer(block, from, to, thread, [&](size_t position, khint_t slot) {
+                bool set = slot != kh_end(kMers);
+                if (set && precomputeFirst) set = firstOccurrence[slot].load(std::memory_order_relaxed) == offset + position;
+                // If minimizing by a single thread, erase the k-mer once set.
+                else if (set && minimize) wrapper.kh_del_from_set(kMers, slot);
+                buffer[position] = Masked(block[position], set);
+                if (position == kMerCount - 1) lastSet = set;
+            });
+        });
+        of.write(buffer.data(), buffer.size());
+        if (!last) return;
+        // Print a warning if the mask convention is violated.
+        if (!lastSet) {
+            PrintMaskConventionWarning();
+        }
+        // Print the remaining k-1 characters.
+        for (size_t i = kMerCount; i < length; ++i) {
+            ms_validation[0] |= nucleotideToInt[(uint8_t) block[i]];
+            of << Masked(block[i], false);
+        }
+    });
     of << std::endl;
     // Check that characters were only ACGTacgt.
-    if (ms_validation >= 4) {
-        throw std::invalid_argument("Masked superstring contains invalid characters.");
+    for (uint8_t validation : ms_validation) {
+        if (validation >= 4) {
+            throw std::invalid_argument("Masked superstring contains invalid characters.");
+        }
     }
 }
 
+/// For the given masked superstring output the same superstring with mask with minimal/maximal number of ones.
+template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+void OptimizeOnes(kseq_t* masked_superstring, std::ostream &of, kh_S_t *kMers, kh_wrapper_t wrapper,
+                  kmer_t _, int k,
+                  bool complements, bool minimize, int threads = 1, size_t bufferSize = MASK_BUFFER_SIZE) {
+    SuperstringRecord superstring{masked_superstring};
+    OptimizeOnes(superstring, of, kMers, wrapper, _, k, complements, minimize, threads, bufferSize);
+}
+
 /// Read or set the intervals.
 /// If [setIntervals] is provided reprint the given files with the corresponding intervals set to 1.
 /// Otherwise, read the intervals in which each k-mer occurs.
-template <typename kmer_t, typename kh_P_t, typename kh_S_t, typename kh_wrapper_t>
+/// The masked superstring is read by blocks from SuperstringRecord or SuperstringStream.
+template <typename superstring_t, typename kmer_t, typename kh_P_t, typename kh_S_t, typename kh_wrapper_t>
 std::pair<size_t, size_t> ReadWriteIntervals(kh_P_t *intervals, kh_S_t *kMers, kh_wrapper_t wrapper,
                              [[maybe_unused]] kmer_t _, std::vector<std::list<size_t>> &intervalsForKmer,
-                             kseq_t* masked_superstring, int k, bool complements, std::ostream &of,
+                             superstring_t &superstring, int k, bool complements, std::ostream &of,
                              const bool* setIntervals = nullptr) {
     bool reading = setIntervals == nullptr;
     kmer_t currentKMer = 0, reverseComplement = 0;
@@ -93,40 +157,43 @@ std::pair<size_t, size_t> ReadWriteIntervals(kh_P_t *intervals, kh_S_t *kMers, k
     size_t occurrences = 0;
     bool interval_used = false;
     uint8_t ms_validation = 0;
-    for (size_t i = 0; i < masked_superstring->seq.l; ++i) {
-        auto data = nucleotideToInt[(uint8_t) masked_superstring->seq.s[i]];
-        ms_validation |= data;
-        currentKMer = ((currentKMer << 2) | data) & mask;
-        reverseComplement = (reverseComplement >> 2) | ((kmer_t(3 ^ data)) << shift);
-        if (i >= (size_t)k - 1) {
-            kmer_t canonical = ((!complements) || currentKMer < reverseComplement) ? currentKMer : reverseComplement;
-            auto kmer_pointer = wrapper.kh_get_from_set(kMers, canonical);
-            bool contained = kmer_pointer != kh_end(kMers);
-            bool set = false;
-            if (contained) {
-                interval_used = true;
-                if (reading) occurrences += appendInterval(intervals, wrapper, intervalsForKmer, currentKMer, currentInterval, k, complements);
-                else set = setIntervals[currentInterval];
-            } else {
-                currentInterval += interval_used;
-                interval_used = false;
-            }
-            if (!reading) {
-                char toPrint = masked_superstring->seq.s[i - k + 1];
-                of << Masked(toPrint, set);
-                // Print a warning if the mask convention is violated.
-                if (i == masked_superstring->seq.l - 1 && !contained) {
-                    PrintMaskConventionWarning();
+    superstring.ForEachBlock(k - 1, MASK_BUFFER_SIZE, [&](const char *block, size_t length, size_t offset, bool last) {
+        // The first k-1 characters of the block but the first one were already read with the previous block.
+        for (size_t j = offset ? k - 1 : 0; j < length; ++j) {
+            auto data = nucleotideToInt[(uint8_t) block[j]];
+            ms_validation |= data;
+            currentKMer = ((currentKMer << 2) | data) & mask;
+            reverseComplement = (reverseComplement >> 2) | ((kmer_t(3 ^ data)) << shift);
+            if (offset + j >= (size_t)k - 1) {
+                kmer_t canonical = ((!complements) || currentKMer < reverseComplement) ? currentKMer : reverseComplement;
+                auto kmer_pointer = wrapper.kh_get_from_set(kMers, canonical);
+                bool contained = kmer_pointer != kh_end(kMers);
+                bool set = false;
+                if (contained) {
+                    interval_used = true;
+                    if (reading) occurrences += appendInterval(intervals, wrapper, intervalsForKmer, currentKMer, currentInterval, k, complements);
+                    else set = setIntervals[currentInterval];
+                } else {
+                    currentInterval += interval_used;
+                    interval_used = false;
+                }
+                if (!reading) {
+                    char toPrint = block[j - k + 1];
+                    of << Masked(toPrint, set);
+                    // Print a warning if the mask convention is violated.
+                    if (last && j == length - 1 && !contained) {
+                        PrintMaskConventionWarning();
+                    }
                 }
             }
         }
-    }
-    // Print the remaining k-1 characters.
-    if (!reading) {
-        for (size_t i = masked_superstring->seq.l - k + 1; i < masked_superstring->seq.l; ++i) {
-            of << Masked(masked_superstring->seq.s[i], false);
+        // Print the remaining k-1 characters.
+        if (!reading && last) {
+            for (size_t j = length >= (size_t)k - 1 ? length - k + 1 : 0; j < length; ++j) {
+                of << Masked(block[j], false);
+            }
         }
-    }
+    });
     if (ms_validation >= 4) {
         throw std::invalid_argument("Masked superstring contains invalid characters.");
     }
@@ -177,50 +244,165 @@ std::pair<std::vector<int>, std::vector<int>> HeuristicPreSolve(std::vector<std:
 }
 
 
+/// Maximum number of intervals of a component which is solved by enumerating the sets of its intervals instead of GLPK.
+constexpr size_t EXHAUSTIVE_COMPONENT_INTERVALS = 16;
+
+/// Return the smallest set of the intervals, as a bit mask, which covers all the k-mers given by the masks of their intervals.
+/// The sets of each size are enumerated in the increasing order (Gosper's hack), so the first cover found is the smallest one.
+inline uint32_t SmallestIntervalCover(std::vector<uint32_t> kMerMasks, size_t intervalCount) {
+    std::sort(kMerMasks.begin(), kMerMasks.end());
+    kMerMasks.erase(std::unique(kMerMasks.begin(), kMerMasks.end()), kMerMasks.end());
+    uint32_t limit = uint32_t(1) << intervalCount;
+    for (size_t size = 0; size <= intervalCount; ++size) {
+        for (uint32_t set = (uint32_t(1) << size) - 1; set < limit;) {
+            bool covers = true;
+            for (uint32_t kMerMask : kMerMasks) covers &= (kMerMask & set) != 0;
+            if (covers) return set;
+            if (!set) break;
+            uint32_t lowest = set & -set, ripple = set + lowest;
+            set = (((ripple ^ set) >> 2) / lowest) | ripple;
+        }
+    }
+    return limit - 1;
+}
+
+/// Choose the intervals of one component of the undecided intervals to be set to 1 by the relaxation of the ILP solved by GLPK,
+/// so that each k-mer, given by the local indices of its intervals, is in a set interval.
+std::vector<bool> SolveIntervalCover(const std::vector<std::vector<int>> &kMerIntervals, size_t intervalCount) {
+    glp_prob *lp = glp_create_prob();
+    glp_set_obj_dir(lp, GLP_MIN);
+    // Add a row per each k-mer.
+    glp_add_rows(lp, (int)kMerIntervals.size());
+    for (size_t i = 0; i < kMerIntervals.size(); ++i) {
+        glp_set_row_bnds(lp, int(i) + 1, GLP_LO, 1.0, 0.0);
+    }
+    // Add a column per each undecided interval.
+    glp_add_cols(lp, (int)intervalCount);
+    for (size_t j = 0; j < intervalCount; ++j) {
+        glp_set_col_bnds(lp, int(j) + 1, GLP_LO, 0.0, 1.0);
+        glp_set_col_kind(lp, int(j) + 1, GLP_IV);
+        glp_set_obj_coef(lp, int(j) + 1, 1.0);
+    }
+    std::vector<int> ia(1), ja(1);
+    std::vector<double> ar(1);
+    for (size_t i = 0; i < kMerIntervals.size(); ++i) {
+        for (int j : kMerIntervals[i]) {
+            ia.push_back(int(i) + 1);
+            ja.push_back(j + 1);
+            ar.push_back(1.0);
+        }
+    }
+    // Supress glpk output.
+    glp_term_out(GLP_OFF);
+
+    glp_load_matrix(lp, int(ia.size()) - 1, ia.data(), ja.data(), ar.data());
+    glp_simplex(lp, nullptr);
+    std::vector<bool> result(intervalCount);
+    for (size_t j = 0; j < intervalCount; ++j) result[j] = glp_get_col_prim(lp, int(j) + 1) > 0.5;
+    glp_delete_prob(lp);
+    // Rounding the relaxation may leave a k-mer with no set interval, so set its first one.
+    for (auto &kMer : kMerIntervals) {
+        if (std::none_of(kMer.begin(), kMer.end(), [&](int j) { return result[j]; })) result[kMer.front()] = true;
+    }
+    return result;
+}
+
+/// Decide which of the undecided intervals are set to 1, so that each undecided k-mer is in a set interval.
+/// The intervals are split into the connected components of the graph in which the intervals of each k-mer are connected (by union-find),
+/// which are solved independently by the given number of threads. The components of at most EXHAUSTIVE_COMPONENT_INTERVALS intervals
+/// are solved exactly by enumeration and the larger ones by GLPK, each in its own problem. GLPK is run by multiple threads
+/// only if it is built with thread-local storage, otherwise its components are solved one by one after the enumerated ones.
+std::vector<bool> SolveUndecidedIntervals(const std::vector<std::list<size_t>> &intervalsForKMer, const std::vector<int> &mapping,
+                                          const std::vector<int> &intervalMapping, int newIntervals, int threads) {
+    std::vector<int> parent(newIntervals);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](int x) {
+        while (parent[x] != x) x = parent[x] = parent[parent[x]];
+        return x;
+    };
+    for (size_t i = 0; i < intervalsForKMer.size(); ++i) {
+        if (mapping[i] == -1) continue;
+        int first = find(intervalMapping[intervalsForKMer[i].front()]);
+        for (size_t j : intervalsForKMer[i]) {
+            int root = find(intervalMapping[j]);
+            if (root != first) parent[std::max(root, first)] = std::min(root, first);
+        }
+    }
+
+    // The intervals of the components and their local indices.
+    std::vector<int> component(newIntervals, -1), localIndex(newIntervals);
+    std::vector<std::vector<int>> componentIntervals;
+    for (int j = 0; j < newIntervals; ++j) {
+        int root = find(j);
+        if (component[root] == -1) {
+            component[root] = int(componentIntervals.size());
+            componentIntervals.emplace_back();
+        }
+        component[j] = component[root];
+        localIndex[j] = int(componentIntervals[component[j]].size());
+        componentIntervals[component[j]].push_back(j);
+    }
+    // The k-mers of the components given by the local indices of their intervals.
+    std::vector<std::vector<std::vector<int>>> componentKMers(componentIntervals.size());
+    for (size_t i = 0; i < intervalsForKMer.size(); ++i) {
+        if (mapping[i] == -1) continue;
+        auto &kMer = componentKMers[component[intervalMapping[intervalsForKMer[i].front()]]].emplace_back();
+        for (size_t j : intervalsForKMer[i]) kMer.push_back(localIndex[intervalMapping[j]]);
+    }
+
+    std::vector<char> set(newIntervals, false);
+    std::vector<size_t> enumerated, relaxed;
+    for (size_t c = 0; c < componentIntervals.size(); ++c) {
+        if (componentKMers[c].empty()) continue;
+        if (componentIntervals[c].size() <= EXHAUSTIVE_COMPONENT_INTERVALS) enumerated.push_back(c);
+        else relaxed.push_back(c);
+    }
+    // The threads take the next unsolved component of the given list until there are none.
+    auto solveComponents = [&](const std::vector<size_t> &components, int solvers) {
+        std::atomic<size_t> next(0);
+        ParallelForEachThread(solvers, [&](int) {
+            for (size_t position = next++; position < components.size(); position = next++) {
+                size_t c = components[position];
+                auto &intervals = componentIntervals[c];
+                if (intervals.size() <= EXHAUSTIVE_COMPONENT_INTERVALS) {
+                    std::vector<uint32_t> kMerMasks;
+                    for (auto &kMer : componentKMers[c]) {
+                        uint32_t kMerMask = 0;
+                        for (int j : kMer) kMerMask |= uint32_t(1) << j;
+                        kMerMasks.push_back(kMerMask);
+                    }
+                    uint32_t cover = SmallestIntervalCover(std::move(kMerMasks), intervals.size());
+                    for (size_t j = 0; j < intervals.size(); ++j) set[intervals[j]] = (cover >> j) & 1;
+                } else {
+                    auto solution = SolveIntervalCover(componentKMers[c], intervals.size());
+                    for (size_t j = 0; j < intervals.size(); ++j) set[intervals[j]] = solution[j];
+                }
+                std::vector<std::vector<int>>().swap(componentKMers[c]);
+            }
+        });
+    };
+    solveComponents(enumerated, threads);
+    // Without thread-local storage, GLPK keeps its environment in a global variable.
+    solveComponents(relaxed, glp_config("TLS") != nullptr ? threads : 1);
+    WriteLog("Solved " + std::to_string(enumerated.size() + relaxed.size()) + " components of undecided intervals, "
+             + std::to_string(enumerated.size()) + " exactly by enumeration and " + std::to_string(relaxed.size()) + " by GLPK.");
+    return std::vector<bool>(set.begin(), set.end());
+}
+
 /// For the given masked superstring output the same superstring with mask with minimal number of runs of ones.
-template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
-void OptimizeRuns(kh_wrapper_t wrapper, kmer_t _, kseq_t* masked_superstring, kh_S_t *kMers, std::ostream &of, int k, bool complements, bool approximate) {
+/// The masked superstring is read by blocks from SuperstringRecord or SuperstringStream.
+/// Unless approximating, the undecided intervals are chosen by SolveUndecidedIntervals with the given number of threads.
+template <typename superstring_t, typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+void OptimizeRuns(kh_wrapper_t wrapper, kmer_t _, superstring_t &superstring, kh_S_t *kMers, std::ostream &of, int k, bool complements, bool approximate,
+                  int threads = 1) {
     auto *intervals = wrapper.kh_init_map();
     std::vector<std::list<size_t>> intervalsForKMer;
-    auto [size, rows] = ReadWriteIntervals(intervals, kMers, wrapper, _, intervalsForKMer, masked_superstring, k, complements, of, nullptr);
+    auto [size, rows] = ReadWriteIntervals(intervals, kMers, wrapper, _, intervalsForKMer, superstring, k, complements, of, nullptr);
     int mappedSize, newIntervals; size_t totalIntervals;
     auto [mapping, intervalMapping] = HeuristicPreSolve(intervalsForKMer, rows, mappedSize, totalIntervals, newIntervals);
-    glp_prob *lp;
-    lp = glp_create_prob();
+    std::vector<bool> undecidedSet;
     if (mappedSize != 0 && !approximate) {
-        auto *ia = new int[totalIntervals + 1];
-        auto *ja = new int[totalIntervals + 1];
-        auto *ar = new double[totalIntervals + 1];
-        glp_set_obj_dir(lp, GLP_MIN);
-        // Add a row per each k-mer.
-        glp_add_rows(lp, mappedSize);
-        for (int i = 0; i < mappedSize; ++i) {
-            glp_set_row_bnds(lp, i + 1, GLP_LO, 1.0, 0.0);
-        }
-        // Add a column per each undecided interval.
-        glp_add_cols(lp, newIntervals);
-        for (int i = 0; i < newIntervals; ++i) {
-            glp_set_col_bnds(lp, i + 1, GLP_LO, 0.0, 1.0);
-            glp_set_col_kind(lp, i + 1, GLP_IV);
-            glp_set_obj_coef(lp, i + 1, 1.0);
-        }
-        int index = 0;
-        for (auto key = kh_begin(intervals); key != kh_end(intervals); ++key) {
-            if (!kh_exist(intervals, key)) continue;
-            size_t i = kh_value(intervals, key);
-            if (mapping[i] == -1) continue;
-            for (auto j: intervalsForKMer[i]) {
-                ja[index + 1] = intervalMapping[j] + 1;
-                ia[index + 1] = mapping[i] + 1;
-                ar[index + 1] = 1.0;
-                ++index;
-            }
-        }
-        // Supress glpk output.
-        glp_term_out(GLP_OFF);
-
-        glp_load_matrix(lp, index, ia, ja, ar);
-        glp_simplex(lp, nullptr);
+        undecidedSet = SolveUndecidedIntervals(intervalsForKMer, mapping, intervalMapping, newIntervals, threads);
     }
 
     bool *intervalsSet = new bool[rows];
@@ -228,34 +410,61 @@ void OptimizeRuns(kh_wrapper_t wrapper, kmer_t _, kseq_t* masked_superstring, kh
     for (size_t i = 0; i < rows; ++i) {
         if (intervalMapping[i] == -1) intervalsSet[i] = true;
         else if (approximate) intervalsSet[i] = mappedSize != 0;
-        else intervalsSet[i] = mappedSize == 0 ? false : (glp_get_col_prim(lp, intervalMapping[i] + 1) > 0.5);
+        else intervalsSet[i] = mappedSize == 0 ? false : undecidedSet[intervalMapping[i]];
     }
 
-    ReprintSequenceHeader(masked_superstring, approximate ? "approx-min-run" : "min-run", of);
-    ReadWriteIntervals(intervals, kMers, wrapper, _, intervalsForKMer, masked_superstring, k, complements, of, intervalsSet);
+    ReprintSequenceHeader(superstring.record, approximate ? "approx-min-run" : "min-run", of);
+    ReadWriteIntervals(intervals, kMers, wrapper, _, intervalsForKMer, superstring, k, complements, of, intervalsSet);
     of << std::endl;
+    delete[] intervalsSet;
+    wrapper.kh_destroy_map(intervals);
 }
 
-template <typename kmer_t, typename kh_wrapper_t>
-int Optimize(kh_wrapper_t wrapper, kmer_t _, std::string &algorithm, std::string path, std::ostream &of,  int k, bool complements) {
-    kseq_t* masked_superstring = ReadMaskedSuperstring(path);
+/// For the given masked superstring output the same superstring with mask with minimal number of runs of ones.
+template <typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
+void OptimizeRuns(kh_wrapper_t wrapper, kmer_t _, kseq_t* masked_superstring, kh_S_t *kMers, std::ostream &of, int k, bool complements, bool approximate,
+                  int threads = 1) {
+    SuperstringRecord superstring{masked_superstring};
+    OptimizeRuns(wrapper, _, superstring, kMers, of, k, complements, approximate, threads);
+}
+
+/// Optimize the mask of the given masked superstring, which is read from SuperstringRecord or SuperstringStream.
+template <typename superstring_t, typename kmer_t, typename kh_wrapper_t>
+int OptimizeSuperstring(superstring_t &superstring, kh_wrapper_t wrapper, kmer_t _, std::string &algorithm, std::ostream &of, int k, bool complements, int threads) {
     auto *kMers = wrapper.kh_init_set();
-    AddKMers(kMers, wrapper, _, masked_superstring->seq.l, masked_superstring->seq.s, k, complements, true);
+    superstring.ForEachBlock(k - 1, MASK_BUFFER_SIZE, [&](const char *block, size_t length, size_t, bool) {
+        AddKMers(kMers, wrapper, _, length, block, k, complements, true);
+    });
 
     if (algorithm == "max-one") {
-        OptimizeOnes(masked_superstring, of, kMers, wrapper, _, k, complements, false);
+        OptimizeOnes(superstring, of, kMers, wrapper, _, k, complements, false, threads);
     } else if (algorithm == "min-one") {
-        OptimizeOnes(masked_superstring, of, kMers,  wrapper, _,k, complements, true);
+        OptimizeOnes(superstring, of, kMers,  wrapper, _,k, complements, true, threads);
     } else if (algorithm == "min-run") {
-        OptimizeRuns(wrapper, _, masked_superstring, kMers, of, k, complements, false);
+        OptimizeRuns(wrapper, _, superstring, kMers, of, k, complements, false, threads);
     } else if (algorithm == "approx-min-run") {
-        OptimizeRuns(wrapper, _,masked_superstring, kMers, of, k, complements, true);
+        OptimizeRuns(wrapper, _, superstring, kMers, of, k, complements, true);
     } else {
         std::cerr << "Algorithm '" + algorithm + "' not recognized." << std::endl;
-        kseq_destroy(masked_superstring);
+        wrapper.kh_destroy_set(kMers);
         return 1;
     }
-    AssertEOF(masked_superstring, "Expecting only a single FASTA record -- the masked superstring.");
-    kseq_destroy(masked_superstring);
+    wrapper.kh_destroy_set(kMers);
+    AssertEOF(superstring.record, "Expecting only a single FASTA record -- the masked superstring.");
     return 0;
 }
+
+/// Optimize the mask of the masked superstring in the given file.
+/// If stream is set, the file is read by blocks once for each pass, so that only the k-mer set is kept in memory instead of the whole superstring.
+template <typename kmer_t, typename kh_wrapper_t>
+int Optimize(kh_wrapper_t wrapper, kmer_t _, std::string &algorithm, std::string path, std::ostream &of,  int k, bool complements,
+             int threads = 1, bool stream = false) {
+    if (stream) {
+        SuperstringStream superstring(path);
+        return OptimizeSuperstring(superstring, wrapper, _, algorithm, of, k, complements, threads);
+    }
+    SuperstringRecord superstring{ReadMaskedSuperstring(path)};
+    int ret = OptimizeSuperstring(superstring, wrapper, _, algorithm, of, k, complements, threads);
+    kseq_destroy(superstring.record);
+    return ret;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "khash.h"
+#include "parser.h"
+#include "simplitigs.h"
+
+/// The largest number of batches into which the prefixes of one overlap length are split.
+constexpr size_t MAX_BATCH_COUNT = 1 << 10;
+
+/// Parse the memory size given as a number of bytes with an optional K, M, G or T suffix (e.g., "16G").
+size_t ParseMemorySize(const std::string &value) {
+    size_t processed = 0;
+    double size = std::stod(value, &processed);
+    std::string unit = value.substr(processed);
+    if (!unit.empty() && (unit.back() == 'B' || unit.back() == 'b')) unit.pop_back();
+    int exponent = 0;
+    if (unit == "K" || unit == "k") exponent = 1;
+    else if (unit == "M" || unit == "m") exponent = 2;
+    else if (unit == "G" || unit == "g") exponent = 3;
+    else if (unit == "T" || unit == "t") exponent = 4;
+    else if (!unit.empty()) throw std::invalid_argument("unknown memory unit '" + unit + "'");
+    for (int i = 0; i < exponent; ++i) size *= 1024;
+    if (size < 1) throw std::invalid_argument("memory size must be positive");
+    return size_t(size);
+}
+
+/// Format the given number of bytes in MB for logging.
+std::string FormatMemorySize(size_t bytes) {
+    return std::to_string((bytes + (1 << 19)) >> 20) + " MB";
+}
+
+/// Estimate the memory of a khash table with the given number of entries and bytes per bucket.
+inline size_t HashTableBytes(size_t entries, size_t bucketBytes) {
+    khint_t buckets = khint_t(entries / __ac_HASH_UPPER) + 1;
+    kroundup64(buckets);
+    buckets = std::max(buckets, khint_t(4));
+    // Flags take 2 bits per bucket.
+    return buckets * bucketBytes + buckets / 4;
+}
+
+/// Estimate the memory of a k-mer set with the given number of k-mers.
+template <typename kmer_t>
+size_t KMerSetBytes([[maybe_unused]] kmer_t _, size_t count) {
+    return HashTableBytes(count, sizeof(kmer_t));
+}
+
+/// Estimate the memory of a prefix map with the given number of prefixes.
+template <typename kmer_t>
+size_t PrefixMapBytes([[maybe_unused]] kmer_t _, size_t count) {
+    return HashTableBytes(count, sizeof(kmer_t) + sizeof(size_t));
+}
+
+/// Estimate the memory of the simplitigs including the vector overhead.
+size_t SimplitigsBytes(const std::vector<simplitig_t> &simplitigs) {
+    size_t bytes = simplitigs.capacity() * sizeof(simplitig_t);
+    for (auto &simplitig : simplitigs) bytes += simplitig.capacity() / 8;
+    return bytes;
+}
+
+/// Estimate of the memory of the overlap phase of the global greedy which decides on the number of prefix batches.
+struct MemoryPlan {
+    // Memory budget in bytes; 0 if unlimited, in which case the default number of batches is used.
+    size_t budget = 0;
+    // Memory which does not depend on the batching, i.e., the nodes and the per-node arrays.
+    size_t fixedBytes = 0;
+    // Memory per index in a batch for the prefix lists, precomputed prefixes and their grouping by the threads.
+    size_t bytesPerBatchIndex = 0;
+    // Memory of the k-mer set, which is needed before the overlap phase and for the max-one mask.
+    size_t kMerSetBytes = 0;
+};
+
+/// Compute the memory plan for the overlap phase with n nodes, kMersCount including reverse complements.
+/// nodeBytes is the memory of the simplitigs or k-mers which are kept in memory during the overlap phase,
+/// kMerCount is the number of represented k-mers and indexBytes is the size of a stored node index.
+/// If checkpoint is set, the state of the nodes is also copied for the checkpoints of the overlap phase.
+template <typename kmer_t>
+MemoryPlan PlanOverlapMemory(kmer_t _, size_t budget, size_t nodeBytes, size_t kMerCount, size_t kMersCount,
+                             size_t n, size_t queryBlockSize, size_t indexBytes = sizeof(size_t), bool checkpoint = false) {
+    MemoryPlan plan;
+    plan.budget = budget;
+    plan.kMerSetBytes = KMerSetBytes(_, kMerCount);
+    // edgeFrom and the overlap packed with the forbidden flag.
+    plan.fixedBytes = nodeBytes + kMersCount * (indexBytes + sizeof(overlap_t<kmer_t>));
+    // first, last and the candidates of one query block.
+    plan.fixedBytes += 2 * n * indexBytes + std::min(kMersCount, queryBlockSize) * indexBytes;
+    // Lists of the nodes with an available prefix and suffix.
+    plan.fixedBytes += 2 * kMersCount * indexBytes;
+    // The copy of edgeFrom, the overlaps, first and last which is being written.
+    if (checkpoint) plan.fixedBytes += kMersCount * (indexBytes + sizeof(overlap_t<kmer_t>)) + 2 * n * indexBytes;
+    // next, the precomputed prefixes and their positions grouped by the owning thread.
+    plan.bytesPerBatchIndex = 2 * indexBytes + sizeof(kmer_t);
+    return plan;
+}
+
+/// Return the estimated memory of the overlap phase with the given number of batches.
+template <typename kmer_t>
+size_t OverlapMemoryWithBatches(kmer_t _, const MemoryPlan &plan, size_t kMersCount, size_t activePrefixes,
+                                size_t batches) {
+    size_t batchSize = kMersCount / batches + 1;
+    // Account for the active prefixes not being distributed uniformly among the batches.
+    size_t prefixesInBatch = std::min(batchSize, activePrefixes / batches + activePrefixes / (8 * batches) + 1);
+    return plan.fixedBytes + batchSize * plan.bytesPerBatchIndex + PrefixMapBytes(_, prefixesInBatch);
+}
+
+/// Choose the smallest number of batches such that the overlap phase with the given number of prefixes fits into the budget.
+/// If even the largest number of batches does not fit, return it anyway.
+template <typename kmer_t>
+size_t PlanBatchCount(kmer_t _, const MemoryPlan &plan, size_t kMersCount, size_t activePrefixes) {
+    size_t batches = 1;
+    while (batches < MAX_BATCH_COUNT && batches < kMersCount
+            && OverlapMemoryWithBatches(_, plan, kMersCount, activePrefixes, batches) > plan.budget) {
+        // Grow gradually so that the chosen number of batches is at most ~12% above the optimum.
+        batches = std::min(MAX_BATCH_COUNT, batches + std::max(size_t(1), batches / 8));
+    }
+    return batches;
+}
+
+/// Decide whether the precomputed endpoint k-mers of the given size fit into the budget, and if so, account for them in the plan.
+/// They are used only if the overlap phase still fits with at most maxBatches batches.
+template <typename kmer_t>
+bool PlanEndpointCache(kmer_t _, MemoryPlan &plan, size_t cacheBytes, size_t kMersCount, size_t maxBatches) {
+    if (!plan.budget) return true;
+    MemoryPlan withCache = plan;
+    withCache.fixedBytes += cacheBytes;
+    if (OverlapMemoryWithBatches(_, withCache, kMersCount, kMersCount, maxBatches) > plan.budget) {
+        WriteLog("The endpoint k-mers are not precomputed in order to fit the memory budget.");
+        return false;
+    }
+    plan = withCache;
+    return true;
+}
+
+/// Log the memory plan of the overlap phase.
+void WriteMemoryPlan(const MemoryPlan &plan) {
+    WriteLog("Memory plan: budget " + FormatMemorySize(plan.budget) + ", nodes and edges "
+             + FormatMemorySize(plan.fixedBytes) + ", k-mer set " + FormatMemorySize(plan.kMerSetBytes) + ".");
+    if (plan.fixedBytes > plan.budget) {
+        WriteLog("Warning: the memory budget is lower than the memory needed regardless of batching.");
+    }
+}
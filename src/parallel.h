@@ -0,0 +1,125 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+/// Pool of worker threads which are started on the first use and then reused by all parallel loops,
+/// so that the loops which run many times (e.g., for every batch of every overlap length) do not spawn threads each time.
+/// The pool runs one job at a time; a job started from within a job runs serially on the calling thread.
+class ThreadPool {
+public:
+    static ThreadPool &Instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    /// Run job(t) for each t in [0, count) in parallel, job(0) on the calling thread, and wait until all of them finish.
+    void Run(int count, const std::function<void(int)> &job) {
+        if (count <= 1 || insideJob) {
+            for (int t = 0; t < count; ++t) job(t);
+            return;
+        }
+        std::lock_guard<std::mutex> running(runMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (int(workers.size()) < count - 1) {
+                workers.emplace_back(&ThreadPool::Work, this, int(workers.size()) + 1, generation);
+            }
+            currentJob = &job;
+            jobCount = count;
+            pending = count - 1;
+            ++generation;
+        }
+        wake.notify_all();
+        insideJob = true;
+        try {
+            job(0);
+        } catch (...) {
+            // The other threads still use the job, so wait for them before unwinding.
+            Wait();
+            throw;
+        }
+        Wait();
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) worker.join();
+    }
+
+private:
+    ThreadPool() = default;
+
+    void Wait() {
+        insideJob = false;
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+    void Work(int id, size_t seen) {
+        insideJob = true;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            if (id >= jobCount) continue;
+            auto *job = currentJob;
+            lock.unlock();
+            (*job)(id);
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    // Whether the current thread runs a job of the pool.
+    static inline thread_local bool insideJob = false;
+    // Serializes the jobs started from different threads.
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::vector<std::thread> workers;
+    const std::function<void(int)> *currentJob = nullptr;
+    int jobCount = 0;
+    // Number of workers which have not finished the current job yet.
+    int pending = 0;
+    // Incremented with each job so that the workers recognize a new one.
+    size_t generation = 0;
+    bool stopping = false;
+};
+
+/// Split [from, to) into at most *threads* contiguous chunks and run f(chunkFrom, chunkTo, thread) on each of them in parallel.
+/// With a single thread, f is called directly on the calling thread; otherwise, the threads of the ThreadPool are used.
+template <typename F>
+void ParallelFor(size_t from, size_t to, int threads, F f) {
+    size_t count = to > from ? to - from : 0;
+    size_t used = std::min(size_t(std::max(threads, 1)), std::max(count, size_t(1)));
+    if (used == 1) {
+        f(from, std::max(from, to), 0);
+        return;
+    }
+    size_t chunk = (count + used - 1) / used;
+    ThreadPool::Instance().Run(int(used), [&](int t) {
+        size_t chunkFrom = from + t * chunk;
+        if (chunkFrom < to) f(chunkFrom, std::min(to, chunkFrom + chunk), t);
+    });
+}
+
+/// Run f(thread) for each of the given number of threads in parallel.
+template <typename F>
+void ParallelForEachThread(int threads, F f) {
+    if (threads <= 1) {
+        f(0);
+        return;
+    }
+    ThreadPool::Instance().Run(threads, [&](int t) { f(t); });
+}
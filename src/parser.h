@@ -3,6 +3,7 @@
 #include <unordered_set>
 #include <fstream>
 #include <algorithm>
+#include <vector>
 
 #include <zlib.h>
 #include <stdio.h>
@@ -156,6 +157,127 @@ void AssertEOF(kseq_t *seq, std::string message) {
     }
 }
 
+/// The masked superstring read whole into a kseq_t record by ReadMaskedSuperstring.
+struct SuperstringRecord {
+    kseq_t *record;
+
+    /// Call f(block, length, offset, last) for the consecutive blocks of the sequence, where the block starting at the given offset
+    /// has size characters followed by the first overlap characters of the next block, unless it is the last one.
+    template <typename F>
+    void ForEachBlock(size_t overlap, size_t size, F f) {
+        size_t length = record->seq.l;
+        for (size_t offset = 0;; offset += size) {
+            bool last = offset + size + overlap >= length;
+            f(record->seq.s + offset, last ? length - offset : size + overlap, offset, last);
+            if (last) break;
+        }
+    }
+};
+
+/// The masked superstring streamed from a file, so that only a block of its sequence is in memory at a time.
+/// The file is read again for each pass over the blocks; the header of the record is kept in a kseq_t record,
+/// so that the file can be checked to contain no other record by AssertEOF after the last pass.
+struct SuperstringStream {
+    std::string path;
+    gzFile fp = nullptr;
+    kseq_t *record = nullptr;
+    // Whether the end of the sequence has been reached.
+    bool finished = false;
+    bool read = false;
+
+    explicit SuperstringStream(std::string path) : path(std::move(path)) {
+        Open();
+    }
+
+    SuperstringStream(const SuperstringStream&) = delete;
+    SuperstringStream& operator=(const SuperstringStream&) = delete;
+
+    ~SuperstringStream() {
+        Close();
+    }
+
+    /// Open the file and read the header of the first record.
+    void Open() {
+        fp = OpenFile(path);
+        record = kseq_init(fp);
+        finished = false;
+        int c;
+        while ((c = ks_getc(record->f)) >= 0 && c != '>' && c != '@');
+        if (c < 0) {
+            finished = true;
+            return;
+        }
+        ks_getuntil(record->f, KS_SEP_SPACE, &record->name, &c);
+        if (c != '\n') ks_getuntil(record->f, KS_SEP_LINE, &record->comment, 0);
+    }
+
+    void Close() {
+        kseq_destroy(record);
+        if (fp != nullptr) gzclose(fp);
+        record = nullptr;
+        fp = nullptr;
+    }
+
+    /// Skip the line breaks and return whether the sequence ends here, i.e., at the end of the file or at the next record.
+    bool AtEnd() {
+        kstream_t *ks = record->f;
+        while (!finished) {
+            if (ks->begin >= ks->end) {
+                // Refill the buffer of the stream and return the read character to it.
+                if (ks_getc(ks) < 0) finished = true;
+                else --ks->begin;
+                continue;
+            }
+            char c = ks->buf[ks->begin];
+            if (c == '>' || c == '@') {
+                // Leave the header of the next record to kseq_read as it does itself.
+                record->last_char = c;
+                ++ks->begin;
+                finished = true;
+            } else if (c == '\n' || c == '\r') {
+                ++ks->begin;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Read at most size characters of the sequence into the buffer and return their number.
+    size_t Read(char *buffer, size_t size) {
+        kstream_t *ks = record->f;
+        size_t count = 0;
+        while (count < size && !AtEnd()) {
+            for (; ks->begin < ks->end && count < size; ++ks->begin) {
+                char c = ks->buf[ks->begin];
+                if (c == '\n' || c == '\r' || c == '>' || c == '@') break;
+                buffer[count++] = c;
+            }
+        }
+        return count;
+    }
+
+    /// Call f(block, length, offset, last) for the consecutive blocks of the sequence as SuperstringRecord::ForEachBlock does.
+    /// The last overlap characters of a block are carried over to the beginning of the next one.
+    template <typename F>
+    void ForEachBlock(size_t overlap, size_t size, F f) {
+        if (read) {
+            Close();
+            Open();
+        }
+        read = true;
+        std::vector<char> buffer(size + overlap);
+        size_t length = Read(buffer.data(), buffer.size());
+        for (size_t offset = 0;; offset += size) {
+            bool last = AtEnd();
+            f(buffer.data(), length, offset, last);
+            if (last) break;
+            std::copy(buffer.begin() + size, buffer.end(), buffer.begin());
+            length = overlap + Read(buffer.data() + overlap, size);
+        }
+    }
+};
+
 void WriteLog(const std::string message) {
     auto snapshot = std::chrono::system_clock::now();
     std::time_t time = std::chrono::system_clock::to_time_t(snapshot);
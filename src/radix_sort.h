@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+
+#include "parallel.h"
+
+/// Number of bits sorted in one pass of the radix sort.
+constexpr int RADIX_BITS = 8;
+constexpr size_t RADIX = size_t(1) << RADIX_BITS;
+
+/// Stably sort the (key, value) pairs by the lowest *bits* bits of their keys with LSD radix sort.
+/// Each pass counts the digits in per-thread chunks and then scatters the chunks in parallel.
+template <typename kmer_t, typename value_t>
+void RadixSortPairs(std::vector<std::pair<kmer_t, value_t>> &pairs, int bits, int threads) {
+    if (pairs.size() < 2 || bits <= 0) return;
+    threads = (int)std::max(size_t(1), std::min(size_t(threads), pairs.size()));
+    std::vector<std::pair<kmer_t, value_t>> buffer(pairs.size());
+    std::vector<std::array<size_t, RADIX>> offsets(threads);
+    for (int shift = 0; shift < bits; shift += RADIX_BITS) {
+        kmer_t mask = kmer_t((size_t(1) << std::min(RADIX_BITS, bits - shift)) - 1);
+        auto digit = [shift, mask](const std::pair<kmer_t, value_t> &pair) {
+            return size_t(uint64_t((pair.first >> shift) & mask));
+        };
+        for (auto &threadOffsets : offsets) threadOffsets.fill(0);
+        ParallelFor(0, pairs.size(), threads, [&](size_t from, size_t to, int thread) {
+            for (size_t i = from; i < to; ++i) offsets[thread][digit(pairs[i])]++;
+        });
+        // Turn the counts into the starting positions so that the chunks are placed in order within each digit.
+        size_t position = 0;
+        for (size_t value = 0; value < RADIX; ++value) {
+            for (int thread = 0; thread < threads; ++thread) {
+                size_t count = offsets[thread][value];
+                offsets[thread][value] = position;
+                position += count;
+            }
+        }
+        ParallelFor(0, pairs.size(), threads, [&](size_t from, size_t to, int thread) {
+            for (size_t i = from; i < to; ++i) buffer[offsets[thread][digit(pairs[i])]++] = pairs[i];
+        });
+        pairs.swap(buffer);
+    }
+}
+
+/// Below this size, the ranges are sorted by comparison instead of further radix passes.
+constexpr size_t RADIX_SORT_CUTOFF = 64;
+
+/// Sort [begin, end) in place by the digits of the keys at the given shift and below with the American flag sort.
+template <typename kmer_t>
+void AmericanFlagSort(kmer_t *begin, kmer_t *end, int shift) {
+    if (size_t(end - begin) < RADIX_SORT_CUTOFF) {
+        std::sort(begin, end);
+        return;
+    }
+    auto digit = [shift](kmer_t key) { return size_t(uint64_t((key >> shift) & kmer_t(RADIX - 1))); };
+    std::array<size_t, RADIX> heads{}, tails{};
+    for (kmer_t *it = begin; it != end; ++it) tails[digit(*it)]++;
+    size_t position = 0;
+    for (size_t value = 0; value < RADIX; ++value) {
+        heads[value] = position;
+        position += tails[value];
+        tails[value] = position;
+    }
+    std::array<size_t, RADIX> bucketBegins = heads;
+    // Move each key to the head of its bucket, which moves the replaced key further until a key of the current bucket is found.
+    for (size_t value = 0; value < RADIX; ++value) {
+        while (heads[value] < tails[value]) {
+            kmer_t key = begin[heads[value]];
+            size_t keyDigit = digit(key);
+            while (keyDigit != value) {
+                std::swap(key, begin[heads[keyDigit]++]);
+                keyDigit = digit(key);
+            }
+            begin[heads[value]++] = key;
+        }
+    }
+    if (shift == 0) return;
+    for (size_t value = 0; value < RADIX; ++value) {
+        AmericanFlagSort(begin + bucketBegins[value], begin + tails[value], shift - RADIX_BITS);
+    }
+}
+
+/// Sort the k-mers in place with an MSD radix sort over all their 2k bits.
+/// With more threads, the first digit is distributed in parallel through one extra buffer
+/// and the resulting buckets are then sorted by the threads in place with the American flag sort.
+template <typename kmer_t>
+void RadixSortKMers(std::vector<kmer_t> &kMers, int k, int threads) {
+    if (kMers.size() < 2) return;
+    int shift = std::max(0, (2 * k - 1) / RADIX_BITS * RADIX_BITS);
+    threads = (int)std::max(size_t(1), std::min(size_t(threads), kMers.size() / RADIX_SORT_CUTOFF));
+    if (threads == 1 || shift == 0) {
+        AmericanFlagSort(kMers.data(), kMers.data() + kMers.size(), shift);
+        return;
+    }
+    auto digit = [shift](kmer_t key) { return size_t(uint64_t((key >> shift) & kmer_t(RADIX - 1))); };
+    std::vector<std::array<size_t, RADIX>> offsets(threads);
+    for (auto &threadOffsets : offsets) threadOffsets.fill(0);
+    ParallelFor(0, kMers.size(), threads, [&](size_t from, size_t to, int thread) {
+        for (size_t i = from; i < to; ++i) offsets[thread][digit(kMers[i])]++;
+    });
+    std::array<size_t, RADIX + 1> bucketBegins{};
+    size_t position = 0;
+    for (size_t value = 0; value < RADIX; ++value) {
+        bucketBegins[value] = position;
+        for (int thread = 0; thread < threads; ++thread) {
+            size_t count = offsets[thread][value];
+            offsets[thread][value] = position;
+            position += count;
+        }
+    }
+    bucketBegins[RADIX] = position;
+    {
+        std::vector<kmer_t> buffer(kMers.size());
+        ParallelFor(0, kMers.size(), threads, [&](size_t from, size_t to, int thread) {
+            for (size_t i = from; i < to; ++i) buffer[offsets[thread][digit(kMers[i])]++] = kMers[i];
+        });
+        kMers.swap(buffer);
+    }
+    // The threads take the buckets one by one, so that a large bucket does not hold up the others.
+    std::atomic<size_t> nextBucket(0);
+    ParallelForEachThread(threads, [&](int) {
+        for (size_t value = nextBucket++; value < RADIX; value = nextBucket++) {
+            AmericanFlagSort(kMers.data() + bucketBegins[value], kMers.data() + bucketBegins[value + 1], shift - RADIX_BITS);
+        }
+    });
+}
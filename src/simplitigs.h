@@ -9,6 +9,14 @@
 #include "khash_utils.h"
 
 typedef std::vector<bool> simplitig_t;
+/// Type of the length of an overlap of two nodes of the given k-mers, which holds k - 1 next to the flag packed into its highest bit
+/// by OverlapNodes. As k < 128 for the k-mers of up to 256 bits, a byte suffices for them and only the multi-word k-mers need 16 bits.
+template <typename kmer_t>
+struct overlap_type { typedef uint8_t type; };
+template <int W>
+struct overlap_type<kmer_words_t<W>> { typedef uint16_t type; };
+template <typename kmer_t>
+using overlap_t = typename overlap_type<kmer_t>::type;
 
 
 simplitig_t simplitig_reverse_complement(simplitig_t forward) {
@@ -20,16 +28,16 @@ simplitig_t simplitig_reverse_complement(simplitig_t forward) {
     return reverse;
 }
 
-char simplitig_at_index(simplitig_t &simplitig, size_t index) {
+char simplitig_at_index(const simplitig_t &simplitig, size_t index) {
     return letters[simplitig[2 * index] * 2 + simplitig[2 * index + 1]];
 }
 
-inline size_t kmers_in_simplitig(simplitig_t &simplitig, int k) {
+inline size_t kmers_in_simplitig(const simplitig_t &simplitig, int k) {
     return simplitig.size() / 2 - k + 1;
 }
 
 template <typename kmer_t>
-kmer_t kmer_at_simplitig_index(kmer_t kmer_type, simplitig_t &simplitig, int k, size_t index) {
+kmer_t kmer_at_simplitig_index(kmer_t kmer_type, const simplitig_t &simplitig, int k, size_t index) {
     kmer_t ret = 0;
     for (size_t i = 2 * index; i < 2 * (index + k); ++i) {
         ret <<= 1;
@@ -66,12 +74,12 @@ std::vector<kmer_t> simplitigs_to_kmer_vec(kmer_t kmer_type, std::vector<simplit
 
 
 template <typename kmer_t>
-kmer_t simplitig_first(kmer_t kmer_type, simplitig_t &simplitig, int k) {
+kmer_t simplitig_first(kmer_t kmer_type, const simplitig_t &simplitig, int k) {
     return kmer_at_simplitig_index(kmer_type, simplitig, k, 0);
 }
 
 template <typename kmer_t>
-kmer_t simplitig_last(kmer_t kmer_type, simplitig_t &simplitig, int k) {
+kmer_t simplitig_last(kmer_t kmer_type, const simplitig_t &simplitig, int k) {
     return kmer_at_simplitig_index(kmer_type, simplitig, k, kmers_in_simplitig(simplitig, k) - 1); 
 }
 
@@ -102,6 +110,8 @@ std::vector<simplitig_t> simplitigs_from_fasta(std::string &path) {
     return simplitigs;
 }
 
+/// Extend forward to the right (backward to the left) by a k-mer from kMers and return the added nucleotide, or -1 if there is none.
+/// The found k-mer is removed from kMers.
 template <bool complements, typename kmer_t, typename kh_S_t, typename kh_wrapper_t>
 inline uint8_t simplitig_right_rev_extension(kmer_t &forward, kmer_t &backward, kh_S_t *kMers, kh_wrapper_t &wrapper, int k) {
     bool forward_direction = true;
@@ -130,7 +140,7 @@ inline uint8_t simplitig_right_rev_extension(kmer_t &forward, kmer_t &backward,
                 else backward = next_backward;
             }
             wrapper.kh_del_from_set(kMers, key);
-            return ext;
+            return uint8_t(ext);
         }
     }
     return -1;
@@ -155,7 +165,7 @@ simplitig_t next_simplitig(kh_S_t *kMers, kh_wrapper_t wrapper, kmer_t begin, in
     simplitig_front.reserve(size_estimate);
     simplitig_back.reserve(2 * k + size_estimate);
     for (int i = 0; i < 2 * k; ++i) {
-        simplitig_back[2 * k - i - 1] = last & (kmer_t(1) << i);
+        simplitig_back[2 * k - i - 1] = bool(last & (kmer_t(1) << i));
     }
     eraseKMer(kMers, wrapper, last, k, complements);
     while (true) {
@@ -0,0 +1 @@
+#define VERSION "e63e-dirty"
\ No newline at end of file
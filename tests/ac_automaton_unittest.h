@@ -1,59 +1,167 @@
 #pragma once
 #include "../src/ac/ac_automaton.h"
 
+#include <map>
+#include <random>
+
 #include "gtest/gtest.h"
 
 
 TEST(ACAutomaton, ConstructTrie) {
-    ACAutomaton a;
-    std::vector<ACState> wantStates = {
-            ACState{std::list<size_t>{0, 1}, 1, 0, 0, 0, 0, 0, 0},
-            ACState{std::list<size_t>{0, 1}, -1, 2, -1, -1, 0, 1, 1},
-            ACState{std::list<size_t>{0, 1}, -1, -1, 4, 3, 0, 2, 2},
-            ACState{std::list<size_t>{0}, -1, -1, -1, -1, 0, 3, 3},
-            ACState{std::list<size_t>{1}, -1, -1, -1, -1, 0, 3, 4},
+    CompactACAutomaton a;
+    // The missing forward edges of the root lead to itself.
+    std::vector<int32_t> wantForwardEdges = {
+            1, 0, 0, 0,
+            INVALID_STATE, 2, INVALID_STATE, INVALID_STATE,
+            INVALID_STATE, INVALID_STATE, 4, 3,
+            INVALID_STATE, INVALID_STATE, INVALID_STATE, INVALID_STATE,
+            INVALID_STATE, INVALID_STATE, INVALID_STATE, INVALID_STATE,
     };
+    std::vector<int32_t> wantDepths = {0, 1, 2, 3, 3};
+    std::vector<std::vector<uint32_t>> wantSupporters = {{0, 1}, {0, 1}, {0, 1}, {0}, {1}};
     std::vector<int> wantEndStateIndices = {3, 4};
 
-    a.ConstructTrie(std::vector<KMer>{KMer{"ACT"}, KMer{"ACG"}});
+    a.ConstructTrie(PackKMers(std::vector<KMer>{KMer{"ACT"}, KMer{"ACG"}}, 3));
 
-    ASSERT_EQ(wantStates.size(), a.states.size());
-    for (size_t i = 0; i < wantStates.size(); ++i) {
-        EXPECT_EQ(wantStates[i].backwardEdge, a.states[i].backwardEdge);
-    for (int j = 0; j < 4; ++j) {
-        EXPECT_EQ(wantStates[i].forwardEdges[j], a.states[i].forwardEdges[j]);
+    ASSERT_EQ(wantDepths.size(), a.Size());
+    EXPECT_EQ(wantForwardEdges, a.forwardEdges);
+    EXPECT_EQ(wantDepths, a.depths);
+    for (size_t i = 0; i < wantSupporters.size(); ++i) {
+        EXPECT_EQ(wantSupporters[i], std::vector<uint32_t>(a.SupportersBegin(int(i)), a.SupportersEnd(int(i))));
     }
-    EXPECT_EQ(wantStates[i].depth, a.states[i].depth);
-    EXPECT_EQ(wantStates[i].id, a.states[i].id);
-    EXPECT_EQ(wantStates[i].supporters, a.states[i].supporters);
-}
-
-ASSERT_EQ(wantEndStateIndices, a.endStateIndices);
+    EXPECT_EQ(wantEndStateIndices, a.endStateIndices);
 }
 
 TEST(ACAutomaton, ConstructBackwardEdges) {
-    ACAutomaton a;
+    CompactACAutomaton a;
     // Trie representing ["ACT", "ACA"].
-    a.states = {
-            ACState{std::list<size_t>{0, 1}, 1, 0, 0, 0, 0, 0, 0},
-            ACState{std::list<size_t>{0, 1}, -1, 2, -1, -1, 0, 1, 1},
-            ACState{std::list<size_t>{0, 1}, 4, -1, -1, 3, 0, 2, 2},
-            ACState{std::list<size_t>{0}, -1, -1, -1, -1, 0, 3, 3},
-            ACState{std::list<size_t>{1}, -1, -1, -1, -1, 0, 3, 4},
-    };
-    std::vector<ACState> wantStates = {
-            ACState{std::list<size_t>{0, 1}, 1, 0, 0, 0, 0, 0, 0},
-            ACState{std::list<size_t>{0, 1}, -1, 2, -1, -1, 0, 1, 1},
-            ACState{std::list<size_t>{0, 1}, 4, -1, -1, 3, 0, 2, 2},
-            ACState{std::list<size_t>{0}, -1, -1, -1, -1, 0, 3, 3},
-            ACState{std::list<size_t>{1}, -1, -1, -1, -1, 1, 3, 4},
-    };
-    std::vector<int> wantReversedOrdering = {3,4,2,1,0};
+    a.ConstructTrie(PackKMers(std::vector<KMer>{KMer{"ACT"}, KMer{"ACA"}}, 3));
+    std::vector<int32_t> wantBackwardEdges = {0, 0, 0, 0, 1};
+    std::vector<int> wantReversedOrdering = {3, 4, 2, 1, 0};
 
     a.ConstructBackwardEdges();
 
-    for (size_t i = 0; i < wantStates.size(); ++i) {
-        EXPECT_EQ(wantStates[i].backwardEdge, a.states[i].backwardEdge);
-    }
+    EXPECT_EQ(wantBackwardEdges, a.backwardEdges);
     EXPECT_EQ(wantReversedOrdering, a.reversedOrdering);
 }
+
+TEST(ACAutomaton, PackedKMers) {
+    std::vector<KMer> kMers = {KMer{"ACGTTGCAACGTTGCAACGTTGCAACGTTGCAG"}, KMer{std::string(33, 'T')}, KMer{std::string(33, 'A')}};
+    PackedKMers packed = PackKMers(kMers, 33);
+
+    ASSERT_EQ(3, packed.Size());
+    EXPECT_EQ(2, packed.wordsPerKMer);
+    for (size_t i = 0; i < kMers.size(); ++i) EXPECT_EQ(kMers[i].value, packed.Get(i).value);
+    EXPECT_EQ(2, packed.Nucleotide(0, 2));
+    EXPECT_EQ(2, packed.Nucleotide(0, 32));
+    EXPECT_EQ(0x1BE41BE41BE41BE4ULL, packed.words[0]);
+    EXPECT_EQ(0x8000000000000000ULL, packed.words[1]);
+}
+
+TEST(ACAutomaton, CompactACAutomaton) {
+    std::mt19937 generator(7);
+    for (int k : {1, 3, 8, 40}) {
+        std::vector<KMer> kMers(k == 1 ? 4 : 200);
+        for (auto &kMer : kMers) {
+            kMer.value.resize(k);
+            for (auto &c : kMer.value) c = letters[generator() % 4];
+        }
+        if (k == 1) kMers = {KMer{"G"}, KMer{"A"}, KMer{"T"}, KMer{"C"}};
+        // The states are the distinct prefixes of the k-mers numbered in the order in which they are first reached.
+        std::map<std::string, int> wantStates = {{"", 0}};
+        std::vector<std::string> labels = {""};
+        for (auto &kMer : kMers) {
+            for (int d = 1; d <= k; ++d) {
+                std::string prefix = kMer.value.substr(0, d);
+                if (wantStates.emplace(prefix, int(labels.size())).second) labels.push_back(prefix);
+            }
+        }
+        CompactACAutomaton got;
+
+        got.Construct(PackKMers(kMers, k));
+
+        ASSERT_EQ(labels.size(), got.Size());
+        for (size_t s = 0; s < got.Size(); ++s) {
+            const std::string &label = labels[s];
+            for (int j = 0; j < 4; ++j) {
+                auto next = wantStates.find(label + letters[j]);
+                int want = next != wantStates.end() ? next->second : (s == 0 ? 0 : INVALID_STATE);
+                EXPECT_EQ(want, got.forwardEdges[4 * s + j]);
+            }
+            // The fail edge leads to the longest proper suffix which is a state.
+            int wantBackwardEdge = 0;
+            for (size_t i = 1; i < label.size(); ++i) {
+                auto suffix = wantStates.find(label.substr(i));
+                if (suffix != wantStates.end()) {
+                    wantBackwardEdge = suffix->second;
+                    break;
+                }
+            }
+            EXPECT_EQ(wantBackwardEdge, got.backwardEdges[s]);
+            EXPECT_EQ(int(label.size()), got.depths[s]);
+            std::vector<uint32_t> wantSupporters;
+            for (size_t i = 0; i < kMers.size(); ++i) if (kMers[i].value.compare(0, label.size(), label) == 0) wantSupporters.push_back(uint32_t(i));
+            EXPECT_EQ(wantSupporters, std::vector<uint32_t>(got.SupportersBegin(int(s)), got.SupportersEnd(int(s))));
+        }
+        for (size_t i = 0; i < kMers.size(); ++i) EXPECT_EQ(wantStates[kMers[i].value], got.endStateIndices[i]);
+        // The BFS visits the states of each depth in the lexicographic order of their strings.
+        std::vector<int> wantReversedOrdering;
+        for (auto &[label, state] : wantStates) wantReversedOrdering.push_back(state);
+        std::stable_sort(wantReversedOrdering.begin(), wantReversedOrdering.end(), [&](int a, int b) {
+            return labels[a].size() > labels[b].size() || (labels[a].size() == labels[b].size() && labels[a] > labels[b]);
+        });
+        EXPECT_EQ(wantReversedOrdering, got.reversedOrdering);
+    }
+}
+
+TEST(ACAutomaton, CompactACAutomatonParallel) {
+    // Return the string of each state, so that the automata can be compared regardless of the numbering of the states.
+    auto labels = [](const CompactACAutomaton &a) {
+        std::vector<std::string> labels(a.Size());
+        for (auto s = a.reversedOrdering.rbegin(); s != a.reversedOrdering.rend(); ++s) {
+            for (int c = 0; c < 4; ++c) {
+                int next = a.forwardEdges[4 * *s + c];
+                if (next != INVALID_STATE && next != 0) labels[next] = labels[*s] + letters[c];
+            }
+        }
+        return labels;
+    };
+    std::mt19937 generator(7);
+    for (int k : {1, 3, 8, 33, 70}) {
+        std::vector<KMer> kMers(k == 1 ? 4 : 300);
+        for (auto &kMer : kMers) {
+            kMer.value.resize(k);
+            for (auto &c : kMer.value) c = letters[generator() % 4];
+        }
+        // Equal k-mers, such as a palindrome and its reverse complement, end in the same state.
+        kMers.push_back(kMers[0]);
+        PackedKMers packed = PackKMers(kMers, k);
+        CompactACAutomaton want;
+        want.Construct(packed);
+        std::vector<std::string> wantLabels = labels(want);
+        for (int threads : {2, 3, 8}) {
+            CompactACAutomaton got;
+
+            got.Construct(packed, threads);
+
+            std::vector<std::string> gotLabels = labels(got);
+            ASSERT_EQ(want.Size(), got.Size());
+            for (size_t i = 0; i < got.Size(); ++i) {
+                int wantState = want.reversedOrdering[i], gotState = got.reversedOrdering[i];
+                EXPECT_EQ(wantLabels[wantState], gotLabels[gotState]);
+                EXPECT_EQ(want.depths[wantState], got.depths[gotState]);
+                EXPECT_EQ(wantLabels[want.backwardEdges[wantState]], gotLabels[got.backwardEdges[gotState]]);
+                EXPECT_EQ(std::vector<uint32_t>(want.SupportersBegin(wantState), want.SupportersEnd(wantState)),
+                          std::vector<uint32_t>(got.SupportersBegin(gotState), got.SupportersEnd(gotState)));
+            }
+            for (size_t i = 0; i < kMers.size(); ++i) {
+                EXPECT_EQ(wantLabels[want.endStateIndices[i]], gotLabels[got.endStateIndices[i]]);
+            }
+        }
+    }
+}
+
+TEST(ACAutomaton, CheckACStateCount) {
+    EXPECT_NO_THROW(CheckACStateCount(size_t(INT32_MAX)));
+    EXPECT_THROW(CheckACStateCount(size_t(INT32_MAX) + 1), std::length_error);
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "../src/checkpoint.h"
+#include "../src/global.h"
+
+#include <filesystem>
+#include <numeric>
+
+#include "kmer_types.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+#ifdef __unix__
+    std::string CheckpointTestDirectory() {
+        auto directory = std::filesystem::temp_directory_path() / "kmercamel_checkpoint_unittest";
+        std::filesystem::remove_all(directory);
+        return directory;
+    }
+
+    TEST(Checkpoint, KMersAndNodes) {
+        std::string directory = CheckpointTestDirectory();
+        std::vector<kmer_t> kMers = {kmer_t(3), kmer_t(1) << 40, kmer_t(7)};
+        std::vector<simplitig_t> simplitigs = {simplitig_from_string("ACGTTA"), simplitig_from_string("T"),
+                                               simplitig_from_string(std::string(40, 'G') + "CA")};
+        {
+            Checkpoint checkpoint(directory, 42, false);
+            EXPECT_EQ(CHECKPOINT_NONE, checkpoint.ResumeStage());
+            checkpoint.SaveKMers(std::vector<kmer_t>(kMers));
+            checkpoint.Wait();
+        }
+        {
+            Checkpoint checkpoint(directory, 42, true);
+            EXPECT_EQ(CHECKPOINT_KMERS, checkpoint.ResumeStage());
+            EXPECT_EQ(kMers, checkpoint.LoadKMers(kmer_t(0)));
+            checkpoint.SaveSimplitigs(simplitigs);
+            checkpoint.Wait();
+        }
+        {
+            Checkpoint checkpoint(directory, 42, true);
+            EXPECT_EQ(CHECKPOINT_SIMPLITIGS, checkpoint.ResumeStage());
+            EXPECT_FALSE(checkpoint.NodesAreKMers());
+            EXPECT_EQ(simplitigs, checkpoint.LoadSimplitigs());
+            checkpoint.SaveKMerVector(kMers);
+            checkpoint.Wait();
+        }
+        {
+            Checkpoint checkpoint(directory, 42, true);
+            EXPECT_EQ(CHECKPOINT_KMER_VECTOR, checkpoint.ResumeStage());
+            EXPECT_TRUE(checkpoint.NodesAreKMers());
+            EXPECT_EQ(kMers, checkpoint.LoadKMers(kmer_t(0)));
+        }
+
+        // The checkpoints of a different computation are not used.
+        EXPECT_THROW(Checkpoint(directory, 43, true), std::runtime_error);
+        {
+            Checkpoint checkpoint(directory, 42, false);
+            EXPECT_EQ(CHECKPOINT_NONE, checkpoint.ResumeStage());
+        }
+        {
+            Checkpoint checkpoint(directory, 42, true);
+            EXPECT_EQ(CHECKPOINT_NONE, checkpoint.ResumeStage());
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    TEST(Checkpoint, OverlapHamiltonianPath) {
+        std::string directory = CheckpointTestDirectory();
+        int k = 4;
+        std::vector<simplitig_t> simplitigs = {simplitig_from_string({"ACAA"}), simplitig_from_string({"ATTT"}),
+                                               simplitig_from_string({"AACA"}), simplitig_from_string({"CATT"}),
+                                               simplitig_from_string({"TTAC"}), simplitig_from_string({"GGAC"})};
+        for (bool complements : {false, true}) {
+            overlapPath<kmer_t> want = OverlapHamiltonianPath(wrapper, kmer_t(0), simplitigs, k, complements);
+            size_t n = simplitigs.size(), kMersCount = n * (1 + complements);
+            {
+                // The initial state saved at the largest overlap length is resumed as if nothing was computed.
+                Checkpoint checkpoint(directory, 42, false);
+                checkpoint.SaveSimplitigs(simplitigs);
+                std::vector<uint32_t> first(n), last(n);
+                std::iota(first.begin(), first.end(), 0);
+                std::iota(last.begin(), last.end(), 0);
+                OverlapNodes<uint32_t, overlap_t<kmer_t>> nodes(kMersCount);
+                EXPECT_TRUE(checkpoint.SaveOverlap(k - 1, nodes.edgeFrom, nodes.state, first, last));
+                // Another state is skipped while the first one is written, unless waiting for it.
+                checkpoint.SaveOverlap(k - 2, nodes.edgeFrom, nodes.state, first, last);
+                EXPECT_TRUE(checkpoint.SaveOverlap(k - 1, nodes.edgeFrom, nodes.state, first, last, true));
+            }
+            for (int run = 0; run < 2; ++run) {
+                // The second run is resumed from the finished overlap phase saved by the first one.
+                Checkpoint checkpoint(directory, 42, true);
+                EXPECT_EQ(CHECKPOINT_OVERLAP, checkpoint.ResumeStage());
+                OverlapOptions options;
+                options.checkpoint = &checkpoint;
+
+                overlapPath<kmer_t> got = OverlapHamiltonianPath(wrapper, kmer_t(0), simplitigs, k, complements, false, options);
+
+                EXPECT_EQ(want.first, got.first);
+                EXPECT_EQ(want.second, got.second);
+            }
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    TEST(Checkpoint, SavePathFile) {
+        std::string directory = CheckpointTestDirectory();
+        std::filesystem::create_directory(directory);
+        std::string path = directory + "/path.kmcp";
+        overlapPath<kmer_t> hamiltonianPath = {{2, 0, (size_t)-1}, {1, 2, (overlap_t<kmer_t>)-1}};
+        std::vector<simplitig_t> simplitigs = {simplitig_from_string("ACG"), simplitig_from_string("TAC"),
+                                               simplitig_from_string("GGCA")};
+        std::vector<kmer_t> kMers = {kmer_t(5), kmer_t(1) << 33, kmer_t(0)};
+        for (bool kMerNodes : {false, true}) {
+            if (kMerNodes) EXPECT_TRUE(SavePathFile(path, "data.fa", 3, false, true, hamiltonianPath.first, hamiltonianPath.second, kMers));
+            else EXPECT_TRUE(SavePathFile(path, "data.fa", 3, false, false, hamiltonianPath.first, hamiltonianPath.second, simplitigs));
+
+            MappedCheckpoint file;
+            ASSERT_TRUE(file.Map(path, 0));
+            EXPECT_EQ(CHECKPOINT_PATH, file.Header().stage);
+            EXPECT_EQ(3, file.Header().k);
+            EXPECT_FALSE(file.Header().complements);
+            EXPECT_EQ(kMerNodes, file.Header().kMerNodes);
+            EXPECT_EQ(kMerNodes, file.Header().cycleCover);
+            EXPECT_EQ(sizeof(overlap_t<kmer_t>), file.Header().overlapBytes);
+            EXPECT_EQ(hamiltonianPath.first, file.LoadSection<size_t>(PATH_EDGES));
+            EXPECT_EQ(hamiltonianPath.second, file.LoadSection<overlap_t<kmer_t>>(PATH_OVERLAPS));
+            EXPECT_EQ("data.fa", std::string(file.Section<char>(PATH_DATASET), file.SectionSize<char>(PATH_DATASET)));
+            if (kMerNodes) EXPECT_EQ(kMers, file.LoadSection<kmer_t>(PATH_NODES));
+            else EXPECT_EQ(simplitigs, LoadSimplitigsSections(file, PATH_NODES));
+        }
+        std::filesystem::remove_all(directory);
+    }
+#endif
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "../src/cost_model.h"
+#include "../src/global_sparse.h"
+
+#include <random>
+#include <chrono>
+
+#include "kmer_types.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+    std::string RandomSequence(size_t length, unsigned seed) {
+        std::mt19937 generator(seed);
+        std::string sequence(length, 'A');
+        for (auto &c : sequence) c = letters[generator() % 4];
+        return sequence;
+    }
+
+    TEST(CostModel, ParseEngine) {
+        EXPECT_EQ(ENGINE_AUTO, ParseEngine("auto"));
+        EXPECT_EQ(ENGINE_SIMPLITIG, ParseEngine("simplitig"));
+        EXPECT_EQ(ENGINE_SPARSE, ParseEngine("sparse"));
+        EXPECT_THROW(ParseEngine("streaming"), std::invalid_argument);
+    }
+
+    TEST(CostModel, EstimateSimplitigCount) {
+        int k = 21;
+        for (bool complements : {false, true}) {
+            // The k-mers of a single long sequence form few simplitigs.
+            auto path = wrapper.kh_init_set();
+            std::string sequence = RandomSequence(2000, 1);
+            AddKMers(path, wrapper, kmer_t(0), sequence.size(), sequence.c_str(), k, complements);
+            double simplitigs = EstimateSimplitigCount(path, wrapper, kmer_t(0), k, complements, 100);
+            EXPECT_LE(1.0, simplitigs);
+            EXPECT_GE(double(kh_size(path)) / 50, simplitigs);
+            wrapper.kh_destroy_set(path);
+
+            // Unrelated k-mers are simplitigs on their own.
+            auto isolated = wrapper.kh_init_set();
+            for (unsigned i = 0; i < 200; ++i) {
+                sequence = RandomSequence(k, i + 2);
+                AddKMers(isolated, wrapper, kmer_t(0), sequence.size(), sequence.c_str(), k, complements);
+            }
+            EXPECT_DOUBLE_EQ(double(kh_size(isolated)), EstimateSimplitigCount(isolated, wrapper, kmer_t(0), k, complements));
+            wrapper.kh_destroy_set(isolated);
+        }
+    }
+
+    TEST(CostModel, EstimateSimplitigCountLongSimplitigs) {
+        int k = 15;
+        for (bool complements : {false, true}) {
+            // Long sequences with mutated copies, so that the simplitigs are long and branching.
+            auto kMers = wrapper.kh_init_set();
+            std::mt19937 generator(7);
+            for (unsigned i = 0; i < 4; ++i) {
+                std::string sequence = RandomSequence(20000, i + 10);
+                AddKMers(kMers, wrapper, kmer_t(0), sequence.size(), sequence.c_str(), k, complements);
+                for (size_t j = 0; j < 100; ++j) sequence[generator() % sequence.size()] = letters[generator() % 4];
+                AddKMers(kMers, wrapper, kmer_t(0), sequence.size(), sequence.c_str(), k, complements);
+            }
+            auto copy = wrapper.kh_init_set();
+            for (size_t i = kh_begin(kMers); i < kh_end(kMers); ++i) {
+                int ret;
+                if (kh_exist(kMers, i)) wrapper.kh_put_to_set(copy, kh_key(kMers, i), &ret);
+            }
+            double want = get_simplitigs(copy, wrapper, kmer_t(0), k, complements).size();
+            wrapper.kh_destroy_set(copy);
+
+            // With all the k-mers sampled, the estimate is not limited by the length of the simplitigs.
+            double got = EstimateSimplitigCount(kMers, wrapper, kmer_t(0), k, complements, kh_size(kMers));
+            EXPECT_LE(want * 0.8, got);
+            EXPECT_GE(want * 1.2, got);
+            wrapper.kh_destroy_set(kMers);
+        }
+    }
+
+    // Return the seconds taken by the overlap phase of the simplitig and of the sparse engine on the given k-mers.
+    template <typename kh_S_t>
+    std::pair<double, double> MeasureEngines(kh_S_t *kMers, int k, bool complements) {
+        auto copy = wrapper.kh_init_set();
+        for (size_t i = kh_begin(kMers); i < kh_end(kMers); ++i) {
+            int ret;
+            if (kh_exist(kMers, i)) wrapper.kh_put_to_set(copy, kh_key(kMers, i), &ret);
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto simplitigs = get_simplitigs(copy, wrapper, kmer_t(0), k, complements);
+        OverlapHamiltonianPath(wrapper, kmer_t(0), simplitigs, k, complements);
+        auto middle = std::chrono::steady_clock::now();
+        auto kMerVec = kMersToVec(kMers, kmer_t(0));
+        RadixSortKMers(kMerVec, k, 1);
+        OverlapHamiltonianPathSparse(wrapper, kMerVec, k, complements);
+        auto end = std::chrono::steady_clock::now();
+        wrapper.kh_destroy_set(copy);
+        return {std::chrono::duration<double>(middle - start).count(), std::chrono::duration<double>(end - middle).count()};
+    }
+
+    TEST(CostModel, PredictEnginesMeasured) {
+        int k = 21;
+        bool complements = true;
+        // Long simplitigs favour the simplitig engine, isolated k-mers the sparse one.
+        auto few = wrapper.kh_init_set();
+        std::string sequence = RandomSequence(200000, 3);
+        AddKMers(few, wrapper, kmer_t(0), sequence.size(), sequence.c_str(), k, complements);
+        auto many = wrapper.kh_init_set();
+        for (unsigned i = 0; i < 20000; ++i) {
+            sequence = RandomSequence(k, i + 1000);
+            AddKMers(many, wrapper, kmer_t(0), sequence.size(), sequence.c_str(), k, complements);
+        }
+        for (auto *kMers : {few, many}) {
+            auto [simplitigSeconds, sparseSeconds] = MeasureEngines(kMers, k, complements);
+            auto prediction = PredictEngines(kmer_t(0), kh_size(kMers), EstimateSimplitigCount(kMers, wrapper, kmer_t(0), k, complements), k, complements);
+            // The fitted costs are within an order of magnitude of the measured times and, if the engines differ clearly, choose the faster one.
+            EXPECT_LT(simplitigSeconds, prediction.simplitigSeconds * 10);
+            EXPECT_LT(prediction.simplitigSeconds, simplitigSeconds * 10);
+            EXPECT_LT(sparseSeconds, prediction.sparseSeconds * 10);
+            EXPECT_LT(prediction.sparseSeconds, sparseSeconds * 10);
+            if (simplitigSeconds > 2 * sparseSeconds || sparseSeconds > 2 * simplitigSeconds) {
+                EXPECT_EQ(sparseSeconds < simplitigSeconds ? ENGINE_SPARSE : ENGINE_SIMPLITIG, DecideEngine(prediction, 0, false));
+            }
+            wrapper.kh_destroy_set(kMers);
+        }
+    }
+
+    TEST(CostModel, DecideEngine) {
+        size_t n = 1 << 20;
+        // Few simplitigs favour the simplitigs, many of them the k-mers.
+        auto few = PredictEngines(kmer_t(0), n, n / 100, 31, true);
+        auto many = PredictEngines(kmer_t(0), n, n / 2, 31, true);
+        EXPECT_EQ(ENGINE_SIMPLITIG, DecideEngine(few, 0, true));
+        EXPECT_EQ(ENGINE_SPARSE, DecideEngine(many, 0, true));
+
+        // The memory budget overrides the predicted time.
+        Engine smaller = many.simplitigBytes < many.sparseBytes ? ENGINE_SIMPLITIG : ENGINE_SPARSE;
+        size_t smallerBytes = std::min(many.simplitigBytes, many.sparseBytes);
+        EXPECT_EQ(smaller, DecideEngine(many, smallerBytes, true));
+        EXPECT_EQ(ENGINE_SIMPLITIG, DecideEngine(few, few.simplitigBytes, true));
+        // If neither fits, streaming is used if allowed.
+        EXPECT_LT(many.streamingBytes, smallerBytes);
+        EXPECT_EQ(ENGINE_STREAMING, DecideEngine(many, many.streamingBytes, true));
+        EXPECT_EQ(smaller, DecideEngine(many, many.streamingBytes, false));
+    }
+}
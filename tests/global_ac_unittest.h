@@ -1,6 +1,8 @@
 #pragma once
 #include "../src/ac/global_ac.h"
 
+#include <random>
+
 #include "gtest/gtest.h"
 
 namespace {
@@ -96,4 +98,96 @@ namespace {
             EXPECT_EQ(t.wantResult, of.str());
         }
     }
-}
\ No newline at end of file
+
+    TEST(GlobalAC, GlobalACThreads) {
+        std::mt19937 generator(3);
+        for (bool complements : {false, true}) {
+            std::vector<KMer> kMers(500);
+            for (auto &kMer : kMers) {
+                kMer.value.resize(11);
+                for (auto &c : kMer.value) c = letters[generator() % 4];
+            }
+            PackedKMers packed = PackKMers(kMers, 11);
+            packed.SortAndDeduplicate();
+            std::stringstream want;
+            GlobalAC(packed, want, complements);
+
+            for (int threads : {2, 4}) {
+                std::stringstream got;
+
+                GlobalAC(packed, got, complements, threads);
+
+                EXPECT_EQ(want.str(), got.str());
+            }
+        }
+    }
+
+    TEST(GlobalAC, OverlapHamiltonianPathSA) {
+        struct TestCase {
+            std::vector<KMer> kMers;
+            std::vector<OverlapEdge> wantResult;
+            bool complements;
+        };
+        std::vector<TestCase> tests = {
+                {
+                        std::vector<KMer>{KMer{"ACG"}, KMer{"TAC"}, KMer{"GGC"}},
+                        std::vector<OverlapEdge>{OverlapEdge{1, 0, 2},OverlapEdge{0, 2, 1}},
+                        false,
+                },
+                {
+                        {KMer{"TAA"}, KMer{"TTT"}, KMer{"TTA"}, KMer{"AAA"}},
+                        {{1, 2, 2}, {0, 3, 2}},
+                        true,
+                },
+        };
+
+        for (auto t : tests) {
+            std::vector<OverlapEdge> got = OverlapHamiltonianPathSA(t.kMers, t.complements);
+            EXPECT_EQ(t.wantResult.size(), got.size());
+            for (size_t i = 0; i < t.wantResult.size() && i < got.size(); ++i) {
+                EXPECT_EQ(t.wantResult[i].firstIndex, got[i].firstIndex);
+                EXPECT_EQ(t.wantResult[i].secondIndex, got[i].secondIndex);
+                EXPECT_EQ(t.wantResult[i].overlapLength, got[i].overlapLength);
+            }
+        }
+    }
+
+    TEST(GlobalAC, GlobalACSuffixArray) {
+        std::mt19937 generator(4);
+        for (bool complements : {false, true}) {
+            for (int k : {3, 5, 11, 40}) {
+                std::vector<KMer> kMers(300);
+                for (auto &kMer : kMers) {
+                    kMer.value.resize(k);
+                    for (auto &c : kMer.value) c = letters[generator() % 4];
+                }
+                PackedKMers packed = PackKMers(kMers, k);
+                packed.SortAndDeduplicate();
+                std::stringstream automaton;
+                GlobalAC(packed, automaton, complements);
+
+                for (int threads : {1, 3}) {
+                    std::stringstream of;
+
+                    GlobalAC(packed, of, complements, threads, true);
+
+                    std::string superstring = of.str();
+                    std::vector<std::string> represented;
+                    for (size_t i = 0; i + k <= superstring.size(); ++i) {
+                        if (!std::isupper(superstring[i])) continue;
+                        std::string kMer = superstring.substr(i, k);
+                        for (auto &c : kMer) c = (char)std::toupper(c);
+                        represented.push_back(kMer);
+                        if (complements) represented.push_back(ReverseComplement(KMer{kMer}).value);
+                    }
+                    std::sort(represented.begin(), represented.end());
+                    for (size_t i = 0; i < packed.Size(); ++i) {
+                        EXPECT_TRUE(std::binary_search(represented.begin(), represented.end(), packed.Get(i).value));
+                    }
+                    // The ties are broken in the same way as in the automaton.
+                    EXPECT_EQ(automaton.str(), superstring);
+                }
+            }
+        }
+    }
+}
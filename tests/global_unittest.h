@@ -2,15 +2,15 @@
 #include "../src/global.h"
 
 #include <algorithm>
+#include <random>
 
 #include "kmer_types.h"
 
 #include "gtest/gtest.h"
-typedef unsigned char byte;
 namespace {
     TEST(Global, SuperstringFromPath) {
         struct TestCase {
-            overlapPath path;
+            overlapPath<kmer_t> path;
             std::vector<simplitig_t> kMers;
             int k;
             std::string wantResult;
@@ -18,21 +18,21 @@ namespace {
         };
         std::vector<TestCase> tests = {
                 {
-                        {{2, 0, (size_t)-1}, {1, 2, (byte)-1}},
+                        {{2, 0, (size_t)-1}, {1, 2, (overlap_t<kmer_t>)-1}},
                         std::vector<simplitig_t>{simplitig_from_string({"ACG"}), simplitig_from_string({"TAC"}), simplitig_from_string({"GGC"})},
                         3,
                         "TAcGgc",
                         false,
                 },
                 {
-                        {{4, 3, 1, (size_t)-1, 5, (size_t)-1}, {1 ,2, 1, (byte)-1, 2, (byte)-1}},
+                        {{4, 3, 1, (size_t)-1, 5, (size_t)-1}, {1 ,2, 1, (overlap_t<kmer_t>)-1, 2, (overlap_t<kmer_t>)-1}},
                         std::vector<simplitig_t>{simplitig_from_string({"GCC"}), simplitig_from_string({"ACG"}), simplitig_from_string({"TAC"})},
                         3,
                         "GcCGta",
                         true,
                 },
                 {
-                        {{3, 1, (size_t)-1, (size_t)-1}, {1, 1, (byte)-1, (byte)-1}},
+                        {{3, 1, (size_t)-1, (size_t)-1}, {1, 1, (overlap_t<kmer_t>)-1, (overlap_t<kmer_t>)-1}},
                         std::vector<simplitig_t>{simplitig_from_string({"GCC"}), simplitig_from_string({"TACG"})},
                         3,
                         "GcCGta",
@@ -53,7 +53,7 @@ namespace {
     TEST(Global, OverlapHamiltonianPath) {
         struct TestCase {
             std::vector<simplitig_t> kMers;
-            overlapPath wantResult;
+            overlapPath<kmer_t> wantResult;
             int k;
             bool complements;
             bool lower_bound;
@@ -61,21 +61,21 @@ namespace {
         std::vector<TestCase> tests = {
                 {
                         {simplitig_from_string({"AT"})},
-                        {{(size_t)-1, (size_t)-1}, {(byte)-1, (byte)-1}},
+                        {{(size_t)-1, (size_t)-1}, {(overlap_t<kmer_t>)-1, (overlap_t<kmer_t>)-1}},
                         2,
                         true,
                         false,
                 },
                 {
                         {simplitig_from_string({"ACG"}), simplitig_from_string({"TAC"}), simplitig_from_string({"GGC"})},
-                        {{2, 0, (size_t)-1}, {1, 2, (byte)-1}},
+                        {{2, 0, (size_t)-1}, {1, 2, (overlap_t<kmer_t>)-1}},
                         3,
                         false,
                         false,
                 },
                 {
                         {simplitig_from_string({"ACAA"}), simplitig_from_string({"ATTT"}), simplitig_from_string({"AACA"})},
-                        {{4, 3, 0, 5, (size_t)-1, (size_t)-1}, {2, 2, 3, 3, (byte)-1, (byte)-1}},
+                        {{4, 3, 0, 5, (size_t)-1, (size_t)-1}, {2, 2, 3, 3, (overlap_t<kmer_t>)-1, (overlap_t<kmer_t>)-1}},
                         4,
                         true,
                         false,
@@ -104,9 +104,181 @@ namespace {
         };
 
         for (auto t : tests) {
-            overlapPath got = OverlapHamiltonianPath(wrapper, kmer_t(0), t.kMers, t.k, t.complements, t.lower_bound);
+            overlapPath<kmer_t> got = OverlapHamiltonianPath(wrapper, kmer_t(0), t.kMers, t.k, t.complements, t.lower_bound);
             EXPECT_EQ(t.wantResult.first, got.first);
             EXPECT_EQ(t.wantResult.second, got.second);
+
+            OverlapOptions uncached;
+            uncached.endpointCache = false;
+            got = OverlapHamiltonianPath(wrapper, kmer_t(0), t.kMers, t.k, t.complements, t.lower_bound, uncached);
+            EXPECT_EQ(t.wantResult.first, got.first);
+            EXPECT_EQ(t.wantResult.second, got.second);
+        }
+    }
+
+    TEST(Global, OverlapHamiltonianPathParallel) {
+        std::vector<simplitig_t> simplitigs = {simplitig_from_string({"ACAA"}), simplitig_from_string({"ATTT"}),
+                                               simplitig_from_string({"AACA"}), simplitig_from_string({"CATT"}),
+                                               simplitig_from_string({"TTAC"}), simplitig_from_string({"GGAC"})};
+        for (bool complements : {false, true}) for (bool lower_bound : {false, true}) {
+            overlapPath<kmer_t> want = OverlapHamiltonianPath(wrapper, kmer_t(0), simplitigs, 4, complements, lower_bound);
+            for (int threads : {2, 3, 8}) {
+                OverlapOptions options;
+                options.threads = threads;
+                overlapPath<kmer_t> got = OverlapHamiltonianPath(wrapper, kmer_t(0), simplitigs, 4, complements, lower_bound, options);
+                EXPECT_EQ(want.first, got.first);
+                EXPECT_EQ(want.second, got.second);
+            }
+        }
+    }
+
+    TEST(Global, OverlapHamiltonianPathSortMerge) {
+        // Many short random simplitigs, so that the overlaps are often tied and the batches contain several of them.
+        std::mt19937 generator(5);
+        std::vector<simplitig_t> simplitigs;
+        for (int i = 0; i < 300; ++i) {
+            std::string simplitig(4 + generator() % 4, 'A');
+            for (auto &c : simplitig) c = letters[generator() % 4];
+            simplitigs.push_back(simplitig_from_string(simplitig));
+        }
+        for (bool complements : {false, true}) for (bool lower_bound : {false, true}) {
+            // The default batching, a single batch and a budget which changes the batching between the overlap lengths.
+            for (size_t maxMemory : {size_t(0), size_t(1) << 30, size_t(40000)}) {
+                OverlapOptions hashOptions;
+                hashOptions.maxMemory = maxMemory;
+                overlapPath<kmer_t> want = OverlapHamiltonianPath(wrapper, kmer_t(0), simplitigs, 4, complements, lower_bound, hashOptions);
+                for (int threads : {1, 3}) {
+                    OverlapOptions options = hashOptions;
+                    options.threads = threads;
+                    options.sortMerge = true;
+                    overlapPath<kmer_t> got = OverlapHamiltonianPath(wrapper, kmer_t(0), simplitigs, 4, complements, lower_bound, options);
+                    EXPECT_EQ(want.first, got.first);
+                    EXPECT_EQ(want.second, got.second);
+                }
+            }
+        }
+    }
+
+    TEST(Global, OverlapHamiltonianPathTimeLimit) {
+        std::vector<simplitig_t> simplitigs = {simplitig_from_string({"ACAA"}), simplitig_from_string({"ATTT"}),
+                                               simplitig_from_string({"AACA"}), simplitig_from_string({"CATT"})};
+        for (bool complements : {false, true}) for (bool sortMerge : {false, true}) {
+            OverlapOptions options;
+            options.sortMerge = sortMerge;
+            options.deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+
+            overlapPath<kmer_t> got = OverlapHamiltonianPath(wrapper, kmer_t(0), simplitigs, 4, complements, false, options);
+
+            // All the simplitigs are joined without any overlaps into one path (and its reverse complement).
+            size_t ends = 0;
+            for (size_t i = 0; i < got.first.size(); ++i) {
+                if (got.first[i] == size_t(-1)) ends++;
+                else EXPECT_EQ(0, got.second[i]);
+            }
+            EXPECT_EQ(size_t(1 + complements), ends);
+        }
+    }
+
+    TEST(Global, CompactActiveNodes) {
+        std::vector<bool> forbidden = {true, false, true, true, false, true};
+        auto isForbidden = [&](uint32_t i) { return bool(forbidden[i]); };
+        std::vector<uint32_t> active = {0, 1, 2, 3, 4, 5};
+        // Less than half of the nodes are available, so the list is compacted.
+        EXPECT_EQ(size_t(2), CompactActiveNodes(active, isForbidden));
+        EXPECT_EQ(std::vector<uint32_t>({1, 4}), active);
+
+        forbidden[4] = true;
+        // Half of the nodes are still available, so the list is kept.
+        EXPECT_EQ(size_t(1), CompactActiveNodes(active, isForbidden));
+        EXPECT_EQ(std::vector<uint32_t>({1, 4}), active);
+    }
+
+    TEST(Global, OverlapNodes) {
+        OverlapNodes<uint32_t, uint8_t> nodes(4);
+        nodes.AddEdge(2, 0, 126);
+        nodes.AddEdge(0, 2, 0);
+        EXPECT_TRUE(nodes.PrefixForbidden(0));
+        EXPECT_FALSE(nodes.PrefixForbidden(1));
+        EXPECT_TRUE(nodes.SuffixForbidden(0));
+        EXPECT_FALSE(nodes.SuffixForbidden(1));
+        EXPECT_TRUE(nodes.SuffixForbidden(2));
+        std::pair<std::vector<size_t>, std::vector<uint8_t>> want = {{2, (size_t)-1, 0, (size_t)-1}, {0, uint8_t(-1), 126, uint8_t(-1)}};
+
+        auto got = nodes.ToOverlapPath();
+
+        EXPECT_EQ(want.first, got.first);
+        EXPECT_EQ(want.second, got.second);
+
+        // The overlaps of the multi-word k-mers take 16 bits.
+        OverlapNodes<uint32_t, uint16_t> wideNodes(2);
+        wideNodes.AddEdge(1, 0, 510);
+        EXPECT_TRUE(wideNodes.PrefixForbidden(0));
+        EXPECT_EQ(std::vector<uint16_t>({uint16_t(-1), 510}), wideNodes.ToOverlapPath().second);
+    }
+
+    TEST(Global, OverlapType) {
+        EXPECT_EQ(1, sizeof(overlap_t<kmer64_t>));
+        EXPECT_EQ(1, sizeof(overlap_t<kmer128_t>));
+        EXPECT_EQ(1, sizeof(overlap_t<kmer256_t>));
+        EXPECT_EQ(2, sizeof(overlap_t<kmer512_t>));
+        EXPECT_EQ(2, sizeof(overlap_t<kmer1024_t>));
+    }
+
+    TEST(Global, OverlapHamiltonianPathIndexed) {
+        int k = 4;
+        std::vector<simplitig_t> simplitigs = {simplitig_from_string({"ACAA"}), simplitig_from_string({"ATTT"}),
+                                               simplitig_from_string({"AACA"}), simplitig_from_string({"CATT"})};
+        auto getPrefix = [&](size_t i) { return accessPrefix(simplitigs, i); };
+        auto getSuffix = [&](size_t i) { return accessSuffix(simplitigs, i); };
+        for (bool complements : {false, true}) {
+            overlapPath<kmer_t> want = OverlapHamiltonianPathIndexed<size_t>(wrapper, kmer_t(0), simplitigs.size(), getPrefix, getSuffix,
+                                                                      k, complements, false, OverlapOptions(), MemoryPlan());
+
+            overlapPath<kmer_t> got = OverlapHamiltonianPathIndexed<uint32_t>(wrapper, kmer_t(0), simplitigs.size(), getPrefix, getSuffix,
+                                                                       k, complements, false, OverlapOptions(), MemoryPlan());
+
+            EXPECT_EQ(want.first, got.first);
+            EXPECT_EQ(want.second, got.second);
+        }
+    }
+
+    TEST(Global, BuildMaskMembership) {
+        std::vector<kmer_t> represented = {KMerToNumber({"ACG"}), KMerToNumber({"TTA"})};
+        std::vector<kmer_t> junctions = {KMerToNumber({"CGT"}), KMerToNumber({"TAA"}), KMerToNumber({"ACG"}), KMerToNumber({"GGG"})};
+        auto forEachJunction = [&](auto add) { for (auto kMer : junctions) add(kMer); };
+        auto forEachKMer = [&](auto add) { for (auto kMer : represented) add(kMer); };
+        for (size_t junctionCount : {size_t(0), junctions.size()}) {
+            auto membership = BuildMaskMembership<kmer_t>(junctionCount, represented.size(), forEachJunction, forEachKMer, 3, true);
+            // CGT is the reverse complement of ACG and TAA of TTA.
+            EXPECT_TRUE(membership.Contains(KMerToNumber({"CGT"})));
+            EXPECT_TRUE(membership.Contains(KMerToNumber({"TAA"})));
+            EXPECT_TRUE(membership.Contains(KMerToNumber({"ACG"})));
+            EXPECT_FALSE(membership.Contains(KMerToNumber({"GGG"})));
+
+            membership = BuildMaskMembership<kmer_t>(junctionCount, represented.size(), forEachJunction, forEachKMer, 3, false);
+            EXPECT_FALSE(membership.Contains(KMerToNumber({"CGT"})));
+            EXPECT_TRUE(membership.Contains(KMerToNumber({"ACG"})));
+            EXPECT_FALSE(membership.Contains(KMerToNumber({"GGG"})));
+        }
+    }
+
+    TEST(Global, RenderPath) {
+        std::vector<std::string> nodes = {"AC", "g", "TTT", "", "a", "CGTA", "c"};
+        auto nodeLength = [&](size_t p) { return nodes[p].size(); };
+        auto renderNode = [&](size_t p, char *superstring, char *mask) {
+            for (size_t i = 0; i < nodes[p].size(); ++i) {
+                superstring[i] = nodes[p][i];
+                if (mask != nullptr) mask[i] = toupper(nodes[p][i]);
+            }
+        };
+        for (int threads : {1, 3}) for (size_t bufferSize : {size_t(1), size_t(4), RENDER_BUFFER_SIZE}) {
+            std::stringstream of, maskf;
+
+            size_t length = RenderPath(nodes.size(), nodeLength, renderNode, of, &maskf, threads, bufferSize);
+
+            EXPECT_EQ(size_t(12), length);
+            EXPECT_EQ("ACgTTTaCGTAc", of.str());
+            EXPECT_EQ("ACGTTTACGTAC", maskf.str());
         }
     }
 
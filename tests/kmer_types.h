@@ -2,10 +2,9 @@
 
 #include <cstdint>
 #include "../src/khash_utils.h"
-#include "../src/uint256_t/uint256_t.h"
 
 #ifdef EXTRA_LARGE_KMERS
-    typedef uint256_t kmer_t;
+    typedef kmer256_t kmer_t;
     typedef kmer_dict256_t kh_wrapper;
     typedef kh_S256_t kh_S_t;
     typedef kh_P256_t kh_P_t;
@@ -1,9 +1,12 @@
 #pragma once
 #include "../src/ac/kmers_ac.h"
 #include "../src/kmers.h"
+#include "../src/uint256_t/uint256_t.h"
 
 #include "kmer_types.h"
 
+#include <random>
+
 #include "gtest/gtest.h"
 
 namespace {
@@ -133,4 +136,66 @@ namespace {
             EXPECT_EQ(t.wantResult.value, gotResult.value);
         }
     }
+
+    TEST(KMers, WideTypesMatchUint256) {
+        std::mt19937_64 generator(0);
+        auto random = [&]() { return uint256_t(((__uint128_t)generator() << 64) | generator(), ((__uint128_t)generator() << 64) | generator()); };
+        auto limbs = [](uint256_t x) { return kmer256_t(x.upper(), x.lower()); };
+        auto limbsToWords = [](kmer256_t x) {
+            kmer_words_t<4> result;
+            result.words[0] = uint64_t(x.lower);
+            result.words[1] = uint64_t(x.lower >> 64);
+            result.words[2] = uint64_t(x.upper);
+            result.words[3] = uint64_t(x.upper >> 64);
+            return result;
+        };
+        auto words = [&](uint256_t x) { return limbsToWords(limbs(x)); };
+        for (int i = 0; i < 1000; ++i) {
+            uint256_t a = random(), b = random();
+            int shift = i % 257, k = 1 + i % 127;
+            uint256_t kMer = a & ((uint256_t(1) << (2 * k)) - 1);
+
+            EXPECT_EQ(words(a + b), words(a) + words(b));
+            EXPECT_EQ(words(a - b), words(a) - words(b));
+            EXPECT_EQ(words(a << shift), words(a) << shift);
+            EXPECT_EQ(words(a >> shift), words(a) >> shift);
+            EXPECT_EQ(a < b, words(a) < words(b));
+            EXPECT_EQ(words(kMer), BitSuffix(words(a), k));
+            EXPECT_EQ(words(kMer >> (k / 2 * 2)), BitPrefix(words(kMer), k, k - k / 2));
+
+            EXPECT_EQ(limbs(a + b), limbs(a) + limbs(b));
+            EXPECT_EQ(limbs(a - b), limbs(a) - limbs(b));
+            EXPECT_EQ(limbs(a << shift), limbs(a) << shift);
+            EXPECT_EQ(limbs(a >> shift), limbs(a) >> shift);
+            EXPECT_EQ(limbs(a << shift), limbs(a) << kmer256_t(shift));
+            EXPECT_EQ(a < b, limbs(a) < limbs(b));
+            EXPECT_EQ(a == a + 1, limbs(a) == limbs(a) + 1);
+            EXPECT_EQ(limbs(kMer), BitSuffix(limbs(a), k));
+            EXPECT_EQ(limbs(kMer >> (k / 2 * 2)), BitPrefix(limbs(kMer), k, k - k / 2));
+            EXPECT_EQ(ReverseComplement(words(kMer), k), limbsToWords(ReverseComplement(limbs(kMer), k)));
+        }
+    }
+
+    TEST(KMers, WordsReverseComplement) {
+        std::mt19937_64 generator(0);
+        for (int k : {64, 100, 127, 128, 255, 300, 511}) {
+            std::string kMer;
+            for (int i = 0; i < k; ++i) kMer += letters[generator() % 4];
+            kmer1024_t encoded(0);
+            kmer256_t encoded256(0);
+            for (char c : kMer) {
+                encoded = (encoded << 2) | kmer1024_t(nucleotideToInt[(uint8_t)c]);
+                encoded256 = (encoded256 << 2) | kmer256_t(nucleotideToInt[(uint8_t)c]);
+            }
+
+            EXPECT_EQ(kMer, NumberToKMer(encoded, k));
+            EXPECT_EQ(ReverseComplement(KMer{kMer}).value, NumberToKMer(ReverseComplement(encoded, k), k));
+            EXPECT_EQ(kMer[0], NucleotideAtIndex(encoded, k, 0));
+            EXPECT_EQ(kMer[k / 2], NucleotideAtIndex(encoded, k, k / 2));
+            if (k < 128) {
+                EXPECT_EQ(kMer, NumberToKMer(encoded256, k));
+                EXPECT_EQ(ReverseComplement(KMer{kMer}).value, NumberToKMer(ReverseComplement(encoded256, k), k));
+            }
+        }
+    }
 }
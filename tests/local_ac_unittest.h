@@ -1,6 +1,8 @@
 #pragma once
 #include "../src/ac/local_ac.h"
 
+#include <random>
+
 #include "gtest/gtest.h"
 
 namespace {
@@ -30,6 +32,25 @@ namespace {
         }
     }
 
+    TEST(LocalAC, ExtensionACSupporters) {
+        std::vector<uint32_t> supporters = {5, 3, 0, 1, 2};
+        std::vector<bool> forbidden = {0, 0, 0, 1};
+        uint64_t front = 1;
+
+        EXPECT_EQ(0, ExtensionAC(forbidden, supporters, front, 4, false));
+        EXPECT_EQ(3, front);
+        EXPECT_EQ(std::vector<bool>({1, 0, 0, 1}), forbidden);
+
+        // The complementary k-mer of 1 is 3.
+        forbidden = {0, 0, 0, 0};
+        front = 3;
+        EXPECT_EQ(1, ExtensionAC(forbidden, supporters, front, 4, true));
+        EXPECT_EQ(4, front);
+        EXPECT_EQ(std::vector<bool>({0, 1, 0, 1}), forbidden);
+        EXPECT_EQ(size_t(-1), ExtensionAC(forbidden, supporters, front, 4, true));
+        EXPECT_EQ(4, front);
+    }
+
     TEST(LocalAC, LocalAC) {
         struct TestCase {
             std::vector<KMer> kMers;
@@ -49,6 +70,8 @@ namespace {
                         "GcTAaa"},
                 { {KMer{"TAA"}, KMer{"AAA"}, KMer{"GCT"}}, 3, 2, false,
                         "GcTAaa"},
+                { {KMer{"TAA"}, KMer{"AAA"}, KMer{"GCT"}}, 3, 5, false,
+                        "GcTAaa"},
                 {{KMer{"TTTCTTTTTTTTTTTTTTTTTTTTTTTTTTG"}, KMer{"TTCTTTTTTTTTTTTTTTTTTTTTTTTTTGA"}}, 31, 5, false,
                         "TTtcttttttttttttttttttttttttttga"},
                 { {KMer{"TAA"}, KMer{"TTT"}}, 3, 2, true,
@@ -64,5 +87,28 @@ namespace {
         }
     }
 
+    TEST(LocalAC, LocalACThreads) {
+        std::mt19937 generator(3);
+        for (bool complements : {false, true}) {
+            std::vector<KMer> kMers(500);
+            for (auto &kMer : kMers) {
+                kMer.value.resize(11);
+                for (auto &c : kMer.value) c = letters[generator() % 4];
+            }
+            PackedKMers packed = PackKMers(kMers, 11);
+            packed.SortAndDeduplicate();
+            std::stringstream want;
+            LocalAC(packed, want, 11, 5, complements);
+
+            for (int threads : {2, 4}) {
+                std::stringstream got;
+
+                LocalAC(packed, got, 11, 5, complements, threads);
+
+                EXPECT_EQ(want.str(), got.str());
+            }
+        }
+    }
+
 
 }
@@ -1,5 +1,9 @@
 #pragma once
 #include "../src/local.h"
+#include "../src/parser.h"
+
+#include <random>
+#include <set>
 
 #include "kmer_types.h"
 
@@ -36,6 +40,9 @@ namespace {
 
             EXPECT_EQ(t.wantNext, gotNext);
             EXPECT_EQ(t.wantExt, gotExt);
+
+            ExtensionIndex<kmer_t> index(std::vector<kmer_t>(t.kMers), t.k, t.complements);
+            EXPECT_EQ(got, index.RightExtension(t.last, t.d));
         }
     }
 
@@ -66,6 +73,9 @@ namespace {
             auto gotNext = got.second;
             EXPECT_EQ(t.wantNext, gotNext);
             EXPECT_EQ(t.wantExt, gotExt);
+
+            ExtensionIndex<kmer_t> index(std::vector<kmer_t>(t.kMers), t.k, t.complements);
+            EXPECT_EQ(got, index.LeftExtension(t.first, t.d));
         }
     }
 
@@ -136,4 +146,115 @@ namespace {
             EXPECT_EQ(t.wantSuperstring, of.str());
         }
     }
+
+    TEST(Local, ExtensionIndex) {
+        int k = 5;
+        // ACGTA, CGTAC, CGTAG and GGACG.
+        std::vector<kmer_t> kMers = {0b0001101100, 0b0110110001, 0b0110110010, 0b1010000110};
+        for (bool complements : {false, true}) {
+            ExtensionIndex<kmer_t> index(std::vector<kmer_t>(kMers), k, complements);
+            EXPECT_EQ(size_t(4), index.Unused());
+            EXPECT_EQ(kmer_t(0b0001101100), index.NextUnused());
+            index.Erase(0b0001101100);
+            // CGTA is followed by CGTAC (the smallest) and CGTAG.
+            EXPECT_EQ(std::make_pair(kmer_t(0b01), kmer_t(0b0110110001)), index.RightExtension(kmer_t(0b0001101100), 1));
+            index.Erase(0b0110110001);
+            EXPECT_EQ(std::make_pair(kmer_t(0b10), kmer_t(0b0110110010)), index.RightExtension(kmer_t(0b0001101100), 1));
+            index.Erase(0b0110110010);
+            EXPECT_EQ(std::make_pair(kmer_t(-1), kmer_t(-1)), index.RightExtension(kmer_t(0b0001101100), 1));
+            // ACG is preceded by GGACG with overlap 3.
+            EXPECT_EQ(std::make_pair(kmer_t(-1), kmer_t(-1)), index.LeftExtension(kmer_t(0b0001101100), 1));
+            EXPECT_EQ(std::make_pair(kmer_t(0b1010), kmer_t(0b1010000110)), index.LeftExtension(kmer_t(0b0001101100), 2));
+            EXPECT_EQ(size_t(1), index.Unused());
+            // With complements, the smaller orientation CGTCC is returned.
+            EXPECT_EQ(complements ? kmer_t(0b0110110101) : kmer_t(0b1010000110), index.NextUnused());
+        }
+        // With complements, ACGTA is extended by its own reverse complement TACGT.
+        ExtensionIndex<kmer_t> index(std::vector<kmer_t>{0b0001101100}, k, true);
+        EXPECT_EQ(std::make_pair(kmer_t(0b011011), kmer_t(0b1100011011)), index.RightExtension(kmer_t(0b0001101100), 3));
+        EXPECT_EQ(std::make_pair(kmer_t(0b11), kmer_t(0b1100011011)), index.LeftExtension(kmer_t(0b0001101100), 1));
+        index.Erase(0b1100011011);
+        EXPECT_EQ(kmer_t(-1), index.NextUnused());
+    }
+
+    /// Check that the masked superstring represents each of the k-mers exactly once and nothing else.
+    template <typename kh_S_t>
+    void ExpectRepresentsExactly(const std::string &superstring, kh_S_t *kMers, int k, bool complements) {
+        size_t represented = 0;
+        std::set<kmer_t> distinct;
+        for (size_t i = 0; i + k <= superstring.size(); ++i) {
+            if (!std::isupper(superstring[i])) continue;
+            std::string kMer = superstring.substr(i, k);
+            for (auto &c : kMer) c = std::toupper(c);
+            kmer_t encoded = KMerToNumber(KMer{kMer});
+            EXPECT_TRUE(containsKMer(kMers, wrapper, encoded, k, complements));
+            distinct.insert(complements ? std::min(encoded, ReverseComplement(encoded, k)) : encoded);
+            ++represented;
+        }
+        EXPECT_EQ(kh_size(kMers), represented);
+        EXPECT_EQ(kh_size(kMers), distinct.size());
+    }
+
+    TEST(Local, LargeDMax) {
+        int k = 21;
+        std::mt19937 generator(11);
+        // Overlapping reads of a random sequence with a few of its k-mers.
+        std::string genome(500, 'A');
+        for (auto &c : genome) c = letters[generator() % 4];
+        std::vector<std::string> sequences;
+        for (size_t i = 0; i + 60 <= genome.size(); i += 37) sequences.push_back(genome.substr(i, 60));
+        for (int i = 0; i < 20; ++i) sequences.push_back(genome.substr(generator() % 400, k));
+        for (bool complements : {false, true}) {
+            auto kMers = wrapper.kh_init_set();
+            for (auto &sequence : sequences) AddKMers(kMers, wrapper, kmer_t(0), sequence.size(), sequence.c_str(), k, complements);
+            for (int d_max : {1, MAX_PROBING_D, MAX_PROBING_D + 1, k - 1}) {
+                auto copy = wrapper.kh_init_set();
+                auto kMerVec = kMersToVec(kMers, kmer_t(0));
+                kMersFromVec(copy, wrapper, kMerVec);
+                std::stringstream of;
+                Local(copy, wrapper, kmer_t(0), of, k, d_max, complements);
+                ExpectRepresentsExactly(of.str(), kMers, k, complements);
+            }
+            wrapper.kh_destroy_set(kMers);
+        }
+    }
+
+    TEST(Local, LocalParallel) {
+        int k = 15;
+        std::mt19937 generator(13);
+        // Reads of a random sequence, so that the partitions have to be joined, with some of them reverse complemented.
+        std::string genome(3000, 'A');
+        for (auto &c : genome) c = letters[generator() % 4];
+        std::vector<std::string> sequences;
+        for (size_t i = 0; i + 80 <= genome.size(); i += 53) {
+            std::string read = genome.substr(i, 80);
+            if (generator() % 2) read = NumberToKMer(ReverseComplement(KMerToNumber(KMer{read.substr(0, k)}), k), k) + read;
+            sequences.push_back(read);
+        }
+        for (bool complements : {false, true}) {
+            auto kMers = wrapper.kh_init_set();
+            for (auto &sequence : sequences) AddKMers(kMers, wrapper, kmer_t(0), sequence.size(), sequence.c_str(), k, complements);
+            auto kMerVec = kMersToVec(kMers, kmer_t(0));
+            for (int d_max : {1, MAX_PROBING_D, MAX_PROBING_D + 1, k - 1}) {
+                std::string superstrings[2];
+                for (int threads : {2, 4}) {
+                    auto copy = wrapper.kh_init_set();
+                    kMersFromVec(copy, wrapper, kMerVec);
+                    std::stringstream of;
+                    LocalParallel(copy, wrapper, kmer_t(0), of, k, d_max, complements, threads);
+                    superstrings[threads / 4] = of.str();
+                    ExpectRepresentsExactly(of.str(), kMers, k, complements);
+                }
+                // The result does not depend on the number of threads.
+                EXPECT_EQ(superstrings[0], superstrings[1]);
+                // The partitions are joined well enough that the result is not much longer than with a single thread.
+                auto copy = wrapper.kh_init_set();
+                kMersFromVec(copy, wrapper, kMerVec);
+                std::stringstream serial;
+                Local(copy, wrapper, kmer_t(0), serial, k, d_max, complements);
+                EXPECT_LE(superstrings[1].size(), serial.str().size() * 21 / 20) << "d_max = " << d_max;
+            }
+            wrapper.kh_destroy_set(kMers);
+        }
+    }
 }
@@ -7,6 +7,9 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <random>
+#include <list>
 
 #include "gtest/gtest.h"
 
@@ -64,6 +67,110 @@ namespace {
         }
     }
 
+    TEST(Masks, OptimizeOnesThreads) {
+        std::mt19937 generator(0);
+        std::string path = std::filesystem::temp_directory_path() / "kmercamel_masks_unittest.fa";
+        std::string superstring;
+        for (int i = 0; i < 3000; ++i) superstring += "ACGTacgt"[generator() % 8];
+        std::ofstream(path) << ">superstring\n" << superstring << "\n";
+
+        for (bool complements : {false, true}) {
+            for (bool minimize : {false, true}) {
+                auto masked_superstring = ReadMaskedSuperstring(path);
+                // The single thread erases the k-mers when minimizing.
+                auto collectKMers = [&]() {
+                    auto kMersDict = wrapper.kh_init_set();
+                    AddKMers(kMersDict, wrapper, kmer_t(0), masked_superstring->seq.l, masked_superstring->seq.s, 5, complements, true);
+                    return kMersDict;
+                };
+                std::stringstream want;
+                OptimizeOnes(masked_superstring, want, collectKMers(), wrapper, kmer_t(0), 5, complements, minimize);
+
+                for (int threads : {2, 3, 8}) {
+                    std::stringstream of;
+
+                    OptimizeOnes(masked_superstring, of, collectKMers(), wrapper, kmer_t(0), 5, complements, minimize, threads, 1000);
+
+                    EXPECT_EQ(want.str(), of.str());
+                }
+                kseq_destroy(masked_superstring);
+            }
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST(Masks, OptimizeStream) {
+        std::mt19937 generator(1);
+        std::string path = std::filesystem::temp_directory_path() / "kmercamel_masks_stream_unittest.fa";
+        std::string superstring;
+        for (int i = 0; i < 3000; ++i) superstring += "ACGTacgt"[generator() % 8];
+        std::ofstream(path) << ">superstring\n" << superstring.substr(0, 1000) << "\n" << superstring.substr(1000) << "\n";
+
+        for (bool complements : {false, true}) {
+            for (std::string algorithm : {"max-one", "min-one", "approx-min-run"}) {
+                std::stringstream want, got;
+                Optimize(wrapper, kmer_t(0), algorithm, path, want, 5, complements);
+
+                Optimize(wrapper, kmer_t(0), algorithm, path, got, 5, complements, 1, true);
+
+                EXPECT_EQ(want.str(), got.str());
+            }
+            for (int threads : {1, 3}) {
+                std::stringstream want, got;
+                std::string algorithm = "min-one";
+                Optimize(wrapper, kmer_t(0), algorithm, path, want, 5, complements);
+                SuperstringStream stream(path);
+                auto kMersDict = wrapper.kh_init_set();
+                AddKMers(kMersDict, wrapper, kmer_t(0), superstring.size(), superstring.data(), 5, complements, true);
+
+                // The blocks of 700 k-mers are not aligned with the lines.
+                OptimizeOnes(stream, got, kMersDict, wrapper, kmer_t(0), 5, complements, true, threads, 700);
+
+                EXPECT_EQ(want.str(), got.str());
+            }
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST(Masks, OptimizeOnesShortBlocks) {
+        std::string path = std::filesystem::temp_directory_path() / "kmercamel_masks_short_unittest.fa";
+        // A record shorter than k and records whose last block of 2 k-mers is shorter than k.
+        for (std::string superstring : {"ACg", "ACGTAcg", "ACGTACgt", "AcGTAcgta"}) {
+            std::ofstream(path) << ">superstring\n" << superstring << "\n";
+            for (bool minimize : {false, true}) {
+                auto masked_superstring = ReadMaskedSuperstring(path);
+                // The single thread erases the k-mers when minimizing.
+                auto collectKMers = [&]() {
+                    auto kMersDict = wrapper.kh_init_set();
+                    AddKMers(kMersDict, wrapper, kmer_t(0), masked_superstring->seq.l, masked_superstring->seq.s, 5, true, true);
+                    return kMersDict;
+                };
+                std::stringstream want;
+                if (superstring.size() < 5) {
+                    // Without any k-mer, the whole superstring is masked out.
+                    want << ">superstring reoptimized=" << (minimize ? "min-one" : "max-one") << "\n";
+                    for (char c : superstring) want << (char)std::tolower(c);
+                    want << "\n";
+                } else {
+                    OptimizeOnes(masked_superstring, want, collectKMers(), wrapper, kmer_t(0), 5, true, minimize);
+                }
+
+                for (int threads : {1, 3}) {
+                    std::stringstream of, streamed;
+                    SuperstringStream stream(path);
+
+                    OptimizeOnes(masked_superstring, of, collectKMers(), wrapper, kmer_t(0), 5, true, minimize, threads, 2);
+                    OptimizeOnes(stream, streamed, collectKMers(), wrapper, kmer_t(0), 5, true, minimize, threads, 2);
+
+                    EXPECT_EQ(want.str(), of.str());
+                    EXPECT_EQ(want.str(), streamed.str());
+                }
+                kseq_destroy(masked_superstring);
+            }
+        }
+        std::filesystem::remove(path);
+    }
+
     TEST(Mask, OptimizeRuns) {
         std::string path = std::filesystem::current_path();
 
@@ -125,5 +232,76 @@ namespace {
             EXPECT_EQ(t.wantResult, of.str());
         }
     }
+
+    TEST(Mask, SmallestIntervalCover) {
+        struct TestCase {
+            std::vector<uint32_t> kMerMasks;
+            size_t intervalCount;
+            uint32_t wantResult;
+        };
+        std::vector<TestCase> tests = {
+                {{}, 3, 0b000},
+                {{0b011, 0b110}, 3, 0b010},
+                {{0b001, 0b110, 0b100}, 3, 0b101},
+                {{0b0011, 0b1100, 0b0011}, 4, 0b0101},
+                {{0b00001, 0b00010, 0b00100, 0b01000, 0b10000}, 5, 0b11111},
+        };
+
+        for (auto &t : tests) {
+            EXPECT_EQ(t.wantResult, SmallestIntervalCover(t.kMerMasks, t.intervalCount));
+        }
+    }
+
+    TEST(Mask, SolveUndecidedIntervals) {
+        // The k-mers given by the original indices of their intervals; the last k-mer was decided by the pre-solve.
+        std::vector<std::list<size_t>> intervalsForKMer = {
+                {0, 1}, {1, 2}, {3}, {4}, {5, 3}, {6}, {0, 7},
+        };
+        std::vector<int> mapping = {0, 1, 2, 3, 4, 5, -1};
+        std::vector<int> intervalMapping = {0, 1, 2, 3, 4, 5, 6, -1};
+        // A chain of more intervals than are enumerated, in which the consecutive intervals share a k-mer.
+        int newIntervals = 7;
+        for (size_t j = 0; j <= EXHAUSTIVE_COMPONENT_INTERVALS; ++j, ++newIntervals) {
+            intervalsForKMer.push_back({size_t(newIntervals) + 1, size_t(newIntervals) + 2});
+            mapping.push_back(int(mapping.size()));
+            intervalMapping.push_back(newIntervals);
+        }
+        intervalMapping.push_back(newIntervals++);
+
+        for (int threads : {1, 2, 4}) {
+            auto set = SolveUndecidedIntervals(intervalsForKMer, mapping, intervalMapping, newIntervals, threads);
+
+            ASSERT_EQ(size_t(newIntervals), set.size());
+            for (size_t i = 0; i < intervalsForKMer.size(); ++i) {
+                if (mapping[i] == -1) continue;
+                EXPECT_TRUE(std::any_of(intervalsForKMer[i].begin(), intervalsForKMer[i].end(),
+                                        [&](size_t j) { return set[intervalMapping[j]]; })) << "k-mer " << i;
+            }
+            // The small components are solved exactly.
+            EXPECT_EQ(std::vector<bool>({false, true, false, true, true, false, true}), std::vector<bool>(set.begin(), set.begin() + 7));
+        }
+    }
+
+    TEST(Mask, OptimizeRunsThreads) {
+        std::string path = std::filesystem::current_path().string() + "/tests/testdata/runstest.fa";
+        std::vector<kmer_t> kMers = {
+                KMerToNumber({"AC"}), KMerToNumber({"CG"}), KMerToNumber({"GT"}), KMerToNumber({"TT"}), KMerToNumber({"AT"})
+        };
+        for (bool approximate : {false, true}) {
+            std::string want;
+            for (int threads : {1, 2, 4}) {
+                std::stringstream of;
+                auto masked_superstring = ReadMaskedSuperstring(path);
+                auto kMersDict = wrapper.kh_init_set();
+                int ret;
+                for (auto &kMer : kMers) wrapper.kh_put_to_set(kMersDict, kMer, &ret);
+
+                OptimizeRuns(wrapper, kmer_t (0), masked_superstring, kMersDict, of, 2, false, approximate, threads);
+
+                if (threads == 1) want = of.str();
+                EXPECT_EQ(want, of.str());
+            }
+        }
+    }
 #endif
 }
@@ -0,0 +1,42 @@
+#pragma once
+#include "../src/memory_plan.h"
+
+#include "kmer_types.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+    TEST(MemoryPlan, ParseMemorySize) {
+        EXPECT_EQ(size_t(1000), ParseMemorySize("1000"));
+        EXPECT_EQ(size_t(2048), ParseMemorySize("2K"));
+        EXPECT_EQ(size_t(3) << 20, ParseMemorySize("3M"));
+        EXPECT_EQ(size_t(16) << 30, ParseMemorySize("16G"));
+        EXPECT_EQ(size_t(1) << 39, ParseMemorySize("0.5T"));
+        EXPECT_EQ(size_t(16) << 30, ParseMemorySize("16GB"));
+        EXPECT_THROW(ParseMemorySize("16X"), std::invalid_argument);
+        EXPECT_THROW(ParseMemorySize("G"), std::invalid_argument);
+    }
+
+    TEST(MemoryPlan, PlanBatchCount) {
+        size_t n = 1 << 20;
+        auto plan = PlanOverlapMemory(kmer_t(0), 0, n * sizeof(kmer_t), n, 2 * n, n, 1 << 10);
+        size_t previous = 0;
+        // The tighter the budget, the more batches are needed.
+        for (size_t budget : {size_t(1) << 34, size_t(1) << 28, size_t(1) << 27, size_t(1) << 26}) {
+            plan.budget = budget;
+            size_t batches = PlanBatchCount(kmer_t(0), plan, 2 * n, 2 * n);
+            EXPECT_LE(previous, batches);
+            EXPECT_TRUE(batches == MAX_BATCH_COUNT || OverlapMemoryWithBatches(kmer_t(0), plan, 2 * n, 2 * n, batches) <= budget);
+            previous = batches;
+        }
+        plan.budget = size_t(1) << 34;
+        EXPECT_EQ(size_t(1), PlanBatchCount(kmer_t(0), plan, 2 * n, 2 * n));
+        // Fewer remaining prefixes need fewer batches.
+        plan.budget = OverlapMemoryWithBatches(kmer_t(0), plan, 2 * n, 2 * n, 4);
+        EXPECT_GE(size_t(4), PlanBatchCount(kmer_t(0), plan, 2 * n, 2 * n));
+        EXPECT_GT(PlanBatchCount(kmer_t(0), plan, 2 * n, 2 * n), PlanBatchCount(kmer_t(0), plan, 2 * n, n / 4));
+        // The copy of the state for the checkpoints needs more batches.
+        auto withCheckpoint = PlanOverlapMemory(kmer_t(0), plan.budget, n * sizeof(kmer_t), n, 2 * n, n, 1 << 10, sizeof(size_t), true);
+        EXPECT_LT(PlanBatchCount(kmer_t(0), plan, 2 * n, 2 * n), PlanBatchCount(kmer_t(0), withCheckpoint, 2 * n, 2 * n));
+    }
+}
@@ -8,6 +8,9 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <random>
+#include <fstream>
+#include <tuple>
 
 #include "gtest/gtest.h"
 
@@ -162,4 +165,96 @@ namespace {
             }
         }
     }
+
+    /// Return the sorted k-mers of the packed ones.
+    std::vector<std::string> UnpackKMers(const PackedKMers &kMers) {
+        std::vector<std::string> result;
+        for (size_t i = 0; i < kMers.Size(); ++i) result.push_back(kMers.Get(i).value);
+        return result;
+    }
+
+    /// Return the sorted distinct k-mers of ConstructKMers, canonical if complements is true.
+    std::vector<std::string> ConstructedKMers(std::vector<FastaRecord> data, int k, bool complements) {
+        std::vector<std::string> result;
+        for (auto &kMer : ConstructKMers(data, k, complements)) {
+            result.push_back(complements ? std::min(kMer.value, ReverseComplement(kMer).value) : kMer.value);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    TEST(Parser, PackedKMersCollector) {
+        std::mt19937 generator(5);
+        std::vector<FastaRecord> data(3);
+        for (auto &record : data) {
+            record.sequence.resize(300);
+            for (auto &c : record.sequence) c = generator() % 100 ? "ACGTacgt"[generator() % 8] : 'N';
+        }
+        // Repeat a part of the sequence so that some k-mers are duplicate.
+        data[2].sequence += data[0].sequence.substr(0, 100);
+        for (int k : {1, 2, 4, 31, 32, 33, 70}) {
+            for (bool complements : {false, true}) {
+                PackedKMersCollector collector(k, complements);
+                // Remove the duplicates also while the k-mers are collected.
+                collector.deduplicationSize = 16;
+                for (auto &record : data) collector.Add(record.sequence.size(), record.sequence.c_str());
+
+                PackedKMers got = collector.Finish();
+
+                EXPECT_EQ((k + 31) / 32, (int)got.wordsPerKMer);
+                EXPECT_EQ(ConstructedKMers(data, k, complements), UnpackKMers(got));
+            }
+        }
+    }
+
+#ifdef __unix__
+    TEST(Parser, ReadPackedKMers) {
+        std::string path = std::filesystem::current_path();
+        path += "/tests/testdata/test.fa";
+        for (int k : {2, 3}) {
+            for (bool complements : {false, true}) {
+                EXPECT_EQ(ConstructedKMers(ReadFasta(path), k, complements), UnpackKMers(ReadPackedKMers(path, k, complements)));
+            }
+        }
+    }
+
+    TEST(Parser, SuperstringStream) {
+        std::string path = std::filesystem::temp_directory_path() / "kmercamel_parser_unittest.fa";
+        std::mt19937 generator(0);
+        for (size_t length : {0, 1, 4, 12, 13, 100}) {
+            std::string sequence;
+            for (size_t i = 0; i < length; ++i) sequence += "ACGTacgt"[generator() % 8];
+            std::ofstream file(path);
+            file << ">superstring comment\n";
+            // Break the lines in the middle of the blocks, also with the Windows line endings.
+            for (size_t i = 0; i < length; i += 7) file << sequence.substr(i, 7) << (i % 2 ? "\r\n" : "\n");
+            file.close();
+
+            auto blocks = [](auto &superstring) {
+                std::vector<std::tuple<std::string, size_t, bool>> result;
+                superstring.ForEachBlock(3, 5, [&](const char *block, size_t length, size_t offset, bool last) {
+                    result.emplace_back(std::string(block, length), offset, last);
+                });
+                return result;
+            };
+            SuperstringRecord record{ReadMaskedSuperstring(path)};
+            auto want = blocks(record);
+            SuperstringStream stream(path);
+
+            EXPECT_EQ(want, blocks(stream));
+            // The file is read again for another pass.
+            EXPECT_EQ(want, blocks(stream));
+            EXPECT_STREQ("superstring", stream.record->name.s);
+            EXPECT_STREQ("comment", stream.record->comment.s);
+            EXPECT_NO_THROW(AssertEOF(stream.record, ""));
+            kseq_destroy(record.record);
+        }
+
+        std::ofstream(path) << ">superstring\nACGTACGT\n>another\nACGT\n";
+        SuperstringStream stream(path);
+        stream.ForEachBlock(3, 5, [](const char *, size_t, size_t, bool) {});
+        EXPECT_THROW(AssertEOF(stream.record, ""), std::invalid_argument);
+        std::filesystem::remove(path);
+    }
+#endif
 }
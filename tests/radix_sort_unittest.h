@@ -0,0 +1,85 @@
+#pragma once
+#include "../src/radix_sort.h"
+#include "../src/kmers.h"
+
+#include <random>
+
+#include "kmer_types.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+    TEST(RadixSort, RadixSortPairs) {
+        for (int threads : {1, 2, 5}) {
+            std::vector<std::pair<kmer_t, size_t>> pairs;
+            for (size_t i = 0; i < 1000; ++i) pairs.emplace_back(kmer_t((i * 7919) % 613), i);
+            auto want = pairs;
+            std::stable_sort(want.begin(), want.end(), [](auto &a, auto &b) { return a.first < b.first; });
+
+            RadixSortPairs(pairs, 10, threads);
+
+            EXPECT_EQ(want, pairs);
+        }
+    }
+
+    TEST(RadixSort, RadixSortPairsLowBitsOnly) {
+        std::vector<std::pair<kmer_t, size_t>> pairs = {{kmer_t(0b111), 0}, {kmer_t(0b010), 1}, {kmer_t(0b001), 2}, {kmer_t(0b110), 3}};
+        std::vector<std::pair<kmer_t, size_t>> want = {{kmer_t(0b010), 1}, {kmer_t(0b110), 3}, {kmer_t(0b111), 0}, {kmer_t(0b001), 2}};
+
+        RadixSortPairs(pairs, 1, 2);
+
+        EXPECT_EQ(want, pairs);
+    }
+
+    TEST(RadixSort, RadixSortKMers) {
+        struct TestCase {
+            std::vector<kmer_t> kMers;
+            int k;
+            std::vector<kmer_t> wantResult;
+        };
+        std::vector<TestCase> tests = {
+                {
+                        {KMerToNumber({"GTA"}), KMerToNumber({"TAC"}), KMerToNumber({"GGC"})},
+                        3,
+                        {KMerToNumber({"GGC"}), KMerToNumber({"GTA"}), KMerToNumber({"TAC"})},
+                },
+                {
+                        {KMerToNumber({"TTTTTTTTTTTTT"}),KMerToNumber({"AAAAAAAAAAAAA"}),  KMerToNumber({"GCGCGCGCGCGCG"})},
+                        13,
+                        {KMerToNumber({"AAAAAAAAAAAAA"}), KMerToNumber({"GCGCGCGCGCGCG"}), KMerToNumber({"TTTTTTTTTTTTT"})},
+                },
+                {
+                        // All the characters are sorted, not only the first ones.
+                        {KMerToNumber({"AAAAAAAAAAAAT"}),KMerToNumber({"AAAAAAAAAAAAA"})},
+                        13,
+                        {KMerToNumber({"AAAAAAAAAAAAA"}),KMerToNumber({"AAAAAAAAAAAAT"})},
+                },
+        };
+
+        for (auto t : tests) {
+            RadixSortKMers(t.kMers, t.k, 1);
+
+            EXPECT_EQ(t.wantResult, t.kMers);
+        }
+    }
+
+    TEST(RadixSort, RadixSortKMersRandom) {
+        std::mt19937 generator(7);
+        int maxK = sizeof(kmer_t) * 4 - 1;
+        for (int k : {1, 4, 5, 13, 31, maxK}) for (int threads : {1, 2, 5}) {
+            std::vector<kmer_t> kMers(5000);
+            for (auto &kMer : kMers) {
+                kMer = 0;
+                for (int i = 0; i < k; ++i) kMer = (kMer << 2) | kmer_t(generator() & 3);
+            }
+            // Many equal prefixes to exercise the deeper levels.
+            for (size_t i = 0; i < kMers.size(); i += 3) kMers[i] = BitSuffix(kMers[i], std::max(1, k / 3));
+            auto want = kMers;
+            std::sort(want.begin(), want.end());
+
+            RadixSortKMers(kMers, k, threads);
+
+            EXPECT_EQ(want, kMers);
+        }
+    }
+}
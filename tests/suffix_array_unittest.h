@@ -0,0 +1,47 @@
+#pragma once
+#include "../src/ac/suffix_array.h"
+
+#include <random>
+#include <numeric>
+
+#include "gtest/gtest.h"
+
+namespace {
+    TEST(SuffixArray, SuffixArray) {
+        std::mt19937 generator(0);
+        for (size_t alphabet : {2, 3, 6}) {
+            for (size_t length : {1, 2, 10, 100, 1000}) {
+                // The text ends by the unique smallest character 0.
+                std::vector<uint8_t> text(length, 0);
+                for (size_t i = 0; i + 1 < length; ++i) text[i] = uint8_t(1 + generator() % (alphabet - 1));
+                std::vector<uint32_t> want(length);
+                std::iota(want.begin(), want.end(), 0);
+                std::sort(want.begin(), want.end(), [&](uint32_t x, uint32_t y) {
+                    return std::lexicographical_compare(text.begin() + x, text.end(), text.begin() + y, text.end());
+                });
+
+                EXPECT_EQ(want, SuffixArray<uint32_t>(text, alphabet));
+                EXPECT_EQ(std::vector<uint64_t>(want.begin(), want.end()), SuffixArray<uint64_t>(text, alphabet));
+            }
+        }
+    }
+
+    TEST(SuffixArray, PermutedCommonPrefixArray) {
+        std::mt19937 generator(1);
+        // The k-mers of length 5 followed by separators 1.
+        std::vector<uint8_t> text(6 * 200 + 1, 1);
+        for (size_t i = 0; i + 1 < text.size(); ++i) if (i % 6 != 5) text[i] = uint8_t(2 + generator() % 4);
+        text.back() = 0;
+        auto sa = SuffixArray<uint32_t>(text, 6);
+        std::vector<uint32_t> want(text.size(), 0);
+        for (size_t r = 1; r < sa.size(); ++r) {
+            size_t h = 0;
+            while (text[sa[r] + h] > 1 && text[sa[r] + h] == text[sa[r - 1] + h]) ++h;
+            want[sa[r]] = uint32_t(h);
+        }
+
+        for (int threads : {1, 3}) {
+            EXPECT_EQ(want, PermutedCommonPrefixArray(text, sa, threads));
+        }
+    }
+}
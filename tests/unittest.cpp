@@ -7,10 +7,15 @@
 #include "local_ac_unittest.h"
 #include "streaming_unittest.h"
 #include "ac_automaton_unittest.h"
+#include "suffix_array_unittest.h"
 #include "lower_bound_unittest.h"
 #include "masks_unittest.h"
 #include "conversions_unittest.h"
 #include "simplitigs_unittest.h"
+#include "memory_plan_unittest.h"
+#include "radix_sort_unittest.h"
+#include "checkpoint_unittest.h"
+#include "cost_model_unittest.h"
 
 #include "gtest/gtest.h"
 